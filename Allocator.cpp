@@ -0,0 +1,465 @@
+#include "Allocator.h"
+#include "Vulkan.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+static VkDeviceSize AlignUp(VkDeviceSize Value, VkDeviceSize Alignment)
+{
+  return (Value + Alignment - 1) / Alignment * Alignment;
+}
+
+// true if the last byte of one resource and the first byte of the next share a bufferImageGranularity page
+static bool SamePage(VkDeviceSize LastByte, VkDeviceSize FirstByte, VkDeviceSize Granularity)
+{
+  return LastByte / Granularity == FirstByte / Granularity;
+}
+
+MemoryAllocator::MemoryAllocator(VkDeviceSize Size) : BlockSize(Size)
+{
+  vkGetPhysicalDeviceMemoryProperties(Context->PhysicalDevice, &MemProps);
+
+  VkPhysicalDeviceProperties DevProps;
+  vkGetPhysicalDeviceProperties(Context->PhysicalDevice, &DevProps);
+
+  Granularity = DevProps.limits.bufferImageGranularity;
+  AtomSize = DevProps.limits.nonCoherentAtomSize;
+  MaxDeviceAllocations = DevProps.limits.maxMemoryAllocationCount;
+
+  Blocks.resize(MemProps.memoryTypeCount);
+  DedicatedBytes.resize(MemProps.memoryTypeCount, 0);
+  DedicatedCount.resize(MemProps.memoryTypeCount, 0);
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+  for(std::vector<Block*>& TypeBlocks : Blocks)
+  {
+    for(Block* Owned : TypeBlocks)
+    {
+      if(Owned)
+      {
+        vkFreeMemory(Context->Device, Owned->Memory, nullptr);
+        delete Owned;
+      }
+    }
+  }
+}
+
+VkDeviceMemory MemoryAllocator::AllocateDeviceMemory(VkDeviceSize Size, uint32_t MemoryType, uint8_t** OutMapped)
+{
+  if(DeviceAllocations >= MaxDeviceAllocations)
+  {
+    throw std::runtime_error("Reached maxMemoryAllocationCount");
+  }
+
+  VkMemoryAllocateInfo AllocInfo{};
+  AllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  AllocInfo.allocationSize = Size;
+  AllocInfo.memoryTypeIndex = MemoryType;
+
+  VkDeviceMemory Memory;
+
+  if(vkAllocateMemory(Context->Device, &AllocInfo, nullptr, &Memory) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to allocate device memory block");
+  }
+
+  DeviceAllocations++;
+
+  *OutMapped = nullptr;
+
+  if(MemProps.memoryTypes[MemoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+  {
+    if(vkMapMemory(Context->Device, Memory, 0, VK_WHOLE_SIZE, 0, (void**)OutMapped) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to map device memory block");
+    }
+  }
+
+  return Memory;
+}
+
+bool MemoryAllocator::TryAllocate(Block& Target, const VkMemoryRequirements& Reqs, bool Linear, VkDeviceSize& OutOffset)
+{
+  std::map<VkDeviceSize, Region>::iterator Best = Target.Regions.end();
+  VkDeviceSize BestOffset = 0;
+
+  for(std::map<VkDeviceSize, Region>::iterator It = Target.Regions.begin(); It != Target.Regions.end(); ++It)
+  {
+    if(!It->second.Free || It->second.Size < Reqs.size)
+    {
+      continue;
+    }
+
+    VkDeviceSize RegionStart = It->first;
+    VkDeviceSize RegionEnd = RegionStart + It->second.Size;
+    VkDeviceSize Offset = AlignUp(RegionStart, Reqs.alignment);
+
+    // free regions are always merged, so the neighbours on either side are in use
+    if(It != Target.Regions.begin())
+    {
+      std::map<VkDeviceSize, Region>::iterator Prev = std::prev(It);
+      if(Prev->second.Linear != Linear && SamePage(RegionStart - 1, Offset, Granularity))
+      {
+        Offset = AlignUp(Offset, Granularity);
+      }
+    }
+
+    VkDeviceSize End = Offset + Reqs.size;
+
+    if(End > RegionEnd)
+    {
+      continue;
+    }
+
+    std::map<VkDeviceSize, Region>::iterator Next = std::next(It);
+    if(Next != Target.Regions.end() && Next->second.Linear != Linear && SamePage(End - 1, RegionEnd, Granularity))
+    {
+      continue;
+    }
+
+    if(Best == Target.Regions.end() || It->second.Size < Best->second.Size)
+    {
+      Best = It;
+      BestOffset = Offset;
+    }
+  }
+
+  if(Best == Target.Regions.end())
+  {
+    return false;
+  }
+
+  VkDeviceSize RegionStart = Best->first;
+  VkDeviceSize RegionEnd = RegionStart + Best->second.Size;
+  VkDeviceSize End = BestOffset + Reqs.size;
+
+  // split into [padding][allocation][remainder], the padding and remainder stay free
+  if(BestOffset > RegionStart)
+  {
+    Best->second.Size = BestOffset - RegionStart;
+  }
+  else
+  {
+    Target.Regions.erase(Best);
+  }
+
+  Target.Regions[BestOffset] = Region{Reqs.size, false, Linear};
+
+  if(End < RegionEnd)
+  {
+    Target.Regions[End] = Region{RegionEnd - End, true, false};
+  }
+
+  Target.Allocations++;
+  OutOffset = BestOffset;
+
+  return true;
+}
+
+Allocation MemoryAllocator::Allocate(const VkMemoryRequirements& Reqs, VkMemoryPropertyFlags Required, VkMemoryPropertyFlags Preferred, bool Linear)
+{
+  std::lock_guard<std::mutex> Guard(Lock);
+
+  Allocation Ret{};
+  Ret.MemoryType = GetMemIndex(Reqs.memoryTypeBits, Required, Preferred);
+  Ret.Size = Reqs.size;
+
+  VkDeviceSize HeapSize = MemProps.memoryHeaps[MemProps.memoryTypes[Ret.MemoryType].heapIndex].size;
+
+  // small heaps (e.g. the 256MB BAR window) get proportionally smaller blocks
+  VkDeviceSize TypeBlockSize = std::min(BlockSize, HeapSize / 8);
+
+  if(Reqs.size > TypeBlockSize / 2)
+  {
+    uint8_t* Mapped;
+    Ret.Memory = AllocateDeviceMemory(Reqs.size, Ret.MemoryType, &Mapped);
+    Ret.Offset = 0;
+    Ret.Mapped = Mapped;
+    Ret.Block = Dedicated;
+
+    DedicatedBytes[Ret.MemoryType] += Reqs.size;
+    DedicatedCount[Ret.MemoryType]++;
+
+    return Ret;
+  }
+
+  std::vector<Block*>& TypeBlocks = Blocks[Ret.MemoryType];
+
+  for(uint32_t i = 0; i < TypeBlocks.size(); i++)
+  {
+    if(TypeBlocks[i] && TryAllocate(*TypeBlocks[i], Reqs, Linear, Ret.Offset))
+    {
+      Ret.Memory = TypeBlocks[i]->Memory;
+      Ret.Mapped = TypeBlocks[i]->Mapped ? TypeBlocks[i]->Mapped + Ret.Offset : nullptr;
+      Ret.Block = i;
+
+      return Ret;
+    }
+  }
+
+  Block* NewBlock = new Block();
+  NewBlock->Size = TypeBlockSize;
+  NewBlock->Memory = AllocateDeviceMemory(TypeBlockSize, Ret.MemoryType, &NewBlock->Mapped);
+  NewBlock->Regions[0] = Region{TypeBlockSize, true, false};
+  NewBlock->Allocations = 0;
+
+  uint32_t Index = std::find(TypeBlocks.begin(), TypeBlocks.end(), nullptr) - TypeBlocks.begin();
+  if(Index == TypeBlocks.size())
+  {
+    TypeBlocks.push_back(NewBlock);
+  }
+  else
+  {
+    TypeBlocks[Index] = NewBlock;
+  }
+
+  if(!TryAllocate(*NewBlock, Reqs, Linear, Ret.Offset))
+  {
+    throw std::runtime_error("Allocation does not fit in an empty block");
+  }
+
+  Ret.Memory = NewBlock->Memory;
+  Ret.Mapped = NewBlock->Mapped ? NewBlock->Mapped + Ret.Offset : nullptr;
+  Ret.Block = Index;
+
+  return Ret;
+}
+
+void MemoryAllocator::Free(Allocation& Target)
+{
+  if(Target.Memory == VK_NULL_HANDLE)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> Guard(Lock);
+
+  if(Target.Block == Dedicated)
+  {
+    vkFreeMemory(Context->Device, Target.Memory, nullptr);
+
+    DeviceAllocations--;
+    DedicatedBytes[Target.MemoryType] -= Target.Size;
+    DedicatedCount[Target.MemoryType]--;
+
+    Target = Allocation{};
+    return;
+  }
+
+  std::vector<Block*>& TypeBlocks = Blocks[Target.MemoryType];
+  Block* Owner = TypeBlocks[Target.Block];
+
+  std::map<VkDeviceSize, Region>::iterator It = Owner->Regions.find(Target.Offset);
+  if(It == Owner->Regions.end() || It->second.Free)
+  {
+    throw std::runtime_error("Freeing an allocation that isn't live");
+  }
+
+  It->second.Free = true;
+  It->second.Linear = false;
+
+  std::map<VkDeviceSize, Region>::iterator Next = std::next(It);
+  if(Next != Owner->Regions.end() && Next->second.Free)
+  {
+    It->second.Size += Next->second.Size;
+    Owner->Regions.erase(Next);
+  }
+
+  if(It != Owner->Regions.begin())
+  {
+    std::map<VkDeviceSize, Region>::iterator Prev = std::prev(It);
+    if(Prev->second.Free)
+    {
+      Prev->second.Size += It->second.Size;
+      Owner->Regions.erase(It);
+    }
+  }
+
+  Owner->Allocations--;
+
+  // keep one empty block around per type so a free/allocate pattern doesn't hammer vkAllocateMemory
+  if(Owner->Allocations == 0)
+  {
+    uint32_t EmptyBlocks = 0;
+    for(Block* Other : TypeBlocks)
+    {
+      if(Other && Other->Allocations == 0)
+      {
+        EmptyBlocks++;
+      }
+    }
+
+    if(EmptyBlocks > 1)
+    {
+      vkFreeMemory(Context->Device, Owner->Memory, nullptr);
+      DeviceAllocations--;
+
+      delete Owner;
+      TypeBlocks[Target.Block] = nullptr;
+    }
+  }
+
+  Target = Allocation{};
+}
+
+VkMappedMemoryRange MemoryAllocator::AtomRange(const Allocation& Target, VkDeviceSize Offset, VkDeviceSize Size) const
+{
+  VkDeviceSize MemorySize = Target.Block == Dedicated ? Target.Size : Blocks[Target.MemoryType][Target.Block]->Size;
+
+  VkMappedMemoryRange Range{};
+  Range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  Range.memory = Target.Memory;
+  Range.offset = (Target.Offset + Offset) / AtomSize * AtomSize;
+  Range.size = AlignUp(Target.Offset + Offset + Size, AtomSize) - Range.offset;
+
+  if(Range.offset + Range.size > MemorySize)
+  {
+    Range.size = VK_WHOLE_SIZE;
+  }
+
+  return Range;
+}
+
+void MemoryAllocator::Flush(const Allocation& Target, VkDeviceSize Offset, VkDeviceSize Size)
+{
+  VkMappedMemoryRange Range = AtomRange(Target, Offset, Size);
+  vkFlushMappedMemoryRanges(Context->Device, 1, &Range);
+}
+
+void MemoryAllocator::Invalidate(const Allocation& Target, VkDeviceSize Offset, VkDeviceSize Size)
+{
+  VkMappedMemoryRange Range = AtomRange(Target, Offset, Size);
+  vkInvalidateMappedMemoryRanges(Context->Device, 1, &Range);
+}
+
+void MemoryAllocator::Accumulate(AllocatorStats& Out, uint32_t MemoryType) const
+{
+  Out.Reserved += DedicatedBytes[MemoryType];
+  Out.Used += DedicatedBytes[MemoryType];
+  Out.Allocations += DedicatedCount[MemoryType];
+  Out.DeviceAllocations += DedicatedCount[MemoryType];
+
+  for(const Block* Owned : Blocks[MemoryType])
+  {
+    if(!Owned)
+    {
+      continue;
+    }
+
+    Out.Reserved += Owned->Size;
+    Out.Allocations += Owned->Allocations;
+    Out.DeviceAllocations++;
+
+    for(const std::pair<const VkDeviceSize, Region>& Entry : Owned->Regions)
+    {
+      if(Entry.second.Free)
+      {
+        Out.FreeRegions++;
+        Out.LargestFreeRegion = std::max(Out.LargestFreeRegion, Entry.second.Size);
+      }
+      else
+      {
+        Out.Used += Entry.second.Size;
+      }
+    }
+  }
+}
+
+MemoryBudget MemoryAllocator::DeviceLocalBudget() const
+{
+  MemoryBudget Ret{};
+
+  if(Context->MemoryBudget)
+  {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT Budgets{};
+    Budgets.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 Props{};
+    Props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    Props.pNext = &Budgets;
+    vkGetPhysicalDeviceMemoryProperties2(Context->PhysicalDevice, &Props);
+
+    for(uint32_t h = 0; h < MemProps.memoryHeapCount; h++)
+    {
+      if(MemProps.memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+      {
+        Ret.Budget += Budgets.heapBudget[h];
+        Ret.Usage += Budgets.heapUsage[h];
+      }
+    }
+
+    return Ret;
+  }
+
+  std::lock_guard<std::mutex> Guard(Lock);
+
+  for(uint32_t h = 0; h < MemProps.memoryHeapCount; h++)
+  {
+    if(MemProps.memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+    {
+      Ret.Budget += MemProps.memoryHeaps[h].size / 10 * 8;
+    }
+  }
+
+  for(uint32_t i = 0; i < MemProps.memoryTypeCount; i++)
+  {
+    if(MemProps.memoryHeaps[MemProps.memoryTypes[i].heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+    {
+      AllocatorStats TypeStats{};
+      Accumulate(TypeStats, i);
+      Ret.Usage += TypeStats.Reserved;
+    }
+  }
+
+  return Ret;
+}
+
+AllocatorStats MemoryAllocator::Stats() const
+{
+  std::lock_guard<std::mutex> Guard(Lock);
+
+  AllocatorStats Ret{};
+
+  for(uint32_t i = 0; i < MemProps.memoryTypeCount; i++)
+  {
+    Accumulate(Ret, i);
+  }
+
+  VkDeviceSize FreeBytes = Ret.Reserved - Ret.Used;
+  Ret.Fragmentation = FreeBytes > 0 ? 1.f - (float)Ret.LargestFreeRegion / FreeBytes : 0.f;
+
+  return Ret;
+}
+
+AllocatorStats MemoryAllocator::Stats(uint32_t MemoryType) const
+{
+  std::lock_guard<std::mutex> Guard(Lock);
+
+  AllocatorStats Ret{};
+  Accumulate(Ret, MemoryType);
+
+  VkDeviceSize FreeBytes = Ret.Reserved - Ret.Used;
+  Ret.Fragmentation = FreeBytes > 0 ? 1.f - (float)Ret.LargestFreeRegion / FreeBytes : 0.f;
+
+  return Ret;
+}
+
+void MemoryAllocator::PrintStats() const
+{
+  for(uint32_t i = 0; i < MemProps.memoryTypeCount; i++)
+  {
+    AllocatorStats TypeStats = Stats(i);
+
+    if(TypeStats.DeviceAllocations == 0)
+    {
+      continue;
+    }
+
+    std::cout << "Memory type " << i << ": " << TypeStats.Used / 1024 << "KB used of " << TypeStats.Reserved / 1024 << "KB reserved, "
+              << TypeStats.Allocations << " allocations in " << TypeStats.DeviceAllocations << " device allocations, "
+              << "fragmentation " << TypeStats.Fragmentation << '\n';
+  }
+}
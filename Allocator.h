@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// A range of device memory handed out by the MemoryAllocator. Bind with (Memory, Offset).
+struct Allocation
+{
+  VkDeviceMemory Memory;
+  VkDeviceSize Offset;
+  VkDeviceSize Size;
+  void* Mapped;         // persistently mapped pointer to Offset, null unless the type is host visible
+  uint32_t MemoryType;
+  uint32_t Block;       // index into the type's block list, Dedicated for allocations that own their VkDeviceMemory
+};
+
+struct AllocatorStats
+{
+  VkDeviceSize Reserved;          // bytes held in VkDeviceMemory objects
+  VkDeviceSize Used;              // bytes handed out, alignment padding stays a free region and isn't counted
+  VkDeviceSize LargestFreeRegion;
+  uint32_t DeviceAllocations;     // live vkAllocateMemory calls
+  uint32_t Allocations;
+  uint32_t FreeRegions;
+  float Fragmentation;            // 1 - LargestFreeRegion / free bytes, 0 when the free space is one region
+};
+
+struct MemoryBudget
+{
+  VkDeviceSize Budget;            // what the process can use before the driver starts evicting or failing allocations
+  VkDeviceSize Usage;             // what the process is using now
+};
+
+// Carves resources out of large per-memory-type blocks so thousands of textures cost a handful of vkAllocateMemory calls.
+// Each block keeps an offset-ordered list of regions, allocation is best fit, and freed neighbours are merged.
+class MemoryAllocator
+{
+  public:
+  static const uint32_t Dedicated = UINT32_MAX;
+
+  MemoryAllocator(VkDeviceSize BlockSize = 64 * 1024 * 1024);
+  ~MemoryAllocator();
+
+  // Linear is true for buffers and linear-tiled images, it decides which neighbours need bufferImageGranularity padding.
+  Allocation Allocate(const VkMemoryRequirements& Reqs, VkMemoryPropertyFlags Required, VkMemoryPropertyFlags Preferred, bool Linear);
+  void Free(Allocation& Target);
+
+  // Flushes Size bytes at Offset within Target, rounded out to nonCoherentAtomSize.
+  void Flush(const Allocation& Target, VkDeviceSize Offset, VkDeviceSize Size);
+  // Same range rules, before the CPU reads what the GPU wrote.
+  void Invalidate(const Allocation& Target, VkDeviceSize Offset, VkDeviceSize Size);
+
+  // Summed over the device local heaps. From VK_EXT_memory_budget when it's enabled, otherwise what this allocator has
+  // reserved against 80% of the heaps, which can't see other processes or the driver's own allocations.
+  MemoryBudget DeviceLocalBudget() const;
+
+  AllocatorStats Stats() const;
+  AllocatorStats Stats(uint32_t MemoryType) const;
+  void PrintStats() const;
+
+  private:
+  struct Region
+  {
+    VkDeviceSize Size;
+    bool Free;
+    bool Linear;
+  };
+
+  struct Block
+  {
+    VkDeviceMemory Memory;
+    VkDeviceSize Size;
+    uint8_t* Mapped;
+    std::map<VkDeviceSize, Region> Regions;   // keyed by offset, covers the whole block
+    uint32_t Allocations;
+  };
+
+  VkMappedMemoryRange AtomRange(const Allocation& Target, VkDeviceSize Offset, VkDeviceSize Size) const;
+  bool TryAllocate(Block& Target, const VkMemoryRequirements& Reqs, bool Linear, VkDeviceSize& OutOffset);
+  VkDeviceMemory AllocateDeviceMemory(VkDeviceSize Size, uint32_t MemoryType, uint8_t** OutMapped);
+  void Accumulate(AllocatorStats& Out, uint32_t MemoryType) const;
+
+  VkPhysicalDeviceMemoryProperties MemProps;
+  VkDeviceSize BlockSize;
+  VkDeviceSize Granularity;
+  VkDeviceSize AtomSize;
+  uint32_t MaxDeviceAllocations;
+
+  std::vector<std::vector<Block*>> Blocks;    // per memory type, null where a block was released
+  std::vector<VkDeviceSize> DedicatedBytes;   // per memory type
+  std::vector<uint32_t> DedicatedCount;
+  uint32_t DeviceAllocations = 0;
+
+  mutable std::mutex Lock;
+};
@@ -0,0 +1,314 @@
+#include "Atlas.h"
+#include "TextureTable.h"
+#include "Upload.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+TextureAtlas::TextureAtlas(uint32_t PageSize, uint32_t Padding) : PageSize(PageSize), Padding(Padding)
+{
+  // pages have one level, a mip chain would bleed neighbours into each other anyway
+  Sampler = CreateSampler(1, 0.f);
+}
+
+TextureAtlas::~TextureAtlas()
+{
+  for(Page& Target : Pages)
+  {
+    if(Target.Registered)
+    {
+      Context->Textures->Release(Target.TextureIndex);
+    }
+
+    DestroyImage(Target.Texture);
+  }
+
+  vkDestroySampler(Context->Device, Sampler, nullptr);
+}
+
+uint32_t TextureAtlas::NewPage()
+{
+  Page NewPage{};
+  NewPage.Texture = CreateSampledImage(VK_FORMAT_R8G8B8A8_SRGB, PageSize, PageSize, 1, 0);
+  NewPage.Skyline.push_back(SkylineNode{0, 0, PageSize});
+
+  Pages.push_back(NewPage);
+  return Pages.size() - 1;
+}
+
+int64_t TextureAtlas::FitAt(const Page& Target, size_t Node, uint32_t Width, uint32_t Height) const
+{
+  uint32_t X = Target.Skyline[Node].X;
+  if(X + Width > PageSize)
+  {
+    return -1;
+  }
+
+  // the rect rests on the highest node it spans
+  uint32_t Y = 0;
+  int64_t WidthLeft = Width;
+
+  for(size_t i = Node; WidthLeft > 0; i++)
+  {
+    Y = std::max(Y, Target.Skyline[i].Y);
+    if(Y + Height > PageSize)
+    {
+      return -1;
+    }
+
+    WidthLeft -= Target.Skyline[i].Width;
+  }
+
+  return Y;
+}
+
+bool TextureAtlas::Place(Page& Target, uint32_t Width, uint32_t Height, uint32_t& OutX, uint32_t& OutY)
+{
+  size_t BestNode = SIZE_MAX;
+  uint32_t BestTop = UINT32_MAX;
+  uint32_t BestWidth = UINT32_MAX;
+
+  // lowest top edge wins, ties go to the narrowest node so wide gaps stay open for wide rects
+  for(size_t i = 0; i < Target.Skyline.size(); i++)
+  {
+    int64_t Y = FitAt(Target, i, Width, Height);
+    if(Y < 0)
+    {
+      continue;
+    }
+
+    uint32_t Top = Y + Height;
+    if(Top < BestTop || (Top == BestTop && Target.Skyline[i].Width < BestWidth))
+    {
+      BestNode = i;
+      BestTop = Top;
+      BestWidth = Target.Skyline[i].Width;
+      OutX = Target.Skyline[i].X;
+      OutY = Y;
+    }
+  }
+
+  if(BestNode == SIZE_MAX)
+  {
+    return false;
+  }
+
+  std::vector<SkylineNode>& Skyline = Target.Skyline;
+  Skyline.insert(Skyline.begin() + BestNode, SkylineNode{OutX, OutY + Height, Width});
+
+  // cut the nodes the new one now covers
+  for(size_t i = BestNode + 1; i < Skyline.size(); i++)
+  {
+    uint32_t PreviousEnd = Skyline[i - 1].X + Skyline[i - 1].Width;
+    if(Skyline[i].X >= PreviousEnd)
+    {
+      break;
+    }
+
+    uint32_t Shrink = PreviousEnd - Skyline[i].X;
+    if(Shrink >= Skyline[i].Width)
+    {
+      Skyline.erase(Skyline.begin() + i);
+      i--;
+      continue;
+    }
+
+    Skyline[i].X += Shrink;
+    Skyline[i].Width -= Shrink;
+    break;
+  }
+
+  // neighbours at the same height are one node
+  for(size_t i = 0; i + 1 < Skyline.size();)
+  {
+    if(Skyline[i].Y == Skyline[i + 1].Y)
+    {
+      Skyline[i].Width += Skyline[i + 1].Width;
+      Skyline.erase(Skyline.begin() + i + 1);
+    }
+    else
+    {
+      i++;
+    }
+  }
+
+  return true;
+}
+
+void TextureAtlas::Upload(Entry& Target)
+{
+  Page& Owner = Pages[Target.Page];
+
+  Context->Uploads->UploadRegion(Owner.Texture, Target.Pixels.data(), Target.X, Target.Y, Target.Width, Target.Height, 4);
+
+  // the descriptor needs the page in SHADER_READ_ONLY, which it only is after its first upload
+  if(!Owner.Registered)
+  {
+    Owner.TextureIndex = Context->Textures->Register(Owner.Texture, Sampler);
+    Owner.Registered = true;
+  }
+}
+
+uint32_t TextureAtlas::Add(const void* Pixels, uint32_t Width, uint32_t Height)
+{
+  uint32_t PaddedWidth = Width + Padding * 2;
+  uint32_t PaddedHeight = Height + Padding * 2;
+
+  if(PaddedWidth > PageSize || PaddedHeight > PageSize)
+  {
+    throw std::runtime_error("Image doesn't fit in an atlas page");
+  }
+
+  Entry NewEntry{};
+  NewEntry.Width = PaddedWidth;
+  NewEntry.Height = PaddedHeight;
+  NewEntry.Live = true;
+
+  // padding repeats the edge texels, so filtering at the border samples the image and not its neighbour
+  NewEntry.Pixels.resize((size_t)PaddedWidth * PaddedHeight * 4);
+  const uint8_t* Source = static_cast<const uint8_t*>(Pixels);
+
+  for(uint32_t y = 0; y < PaddedHeight; y++)
+  {
+    uint32_t SourceY = std::min(std::max(y, Padding) - Padding, Height - 1);
+
+    for(uint32_t x = 0; x < PaddedWidth; x++)
+    {
+      uint32_t SourceX = std::min(std::max(x, Padding) - Padding, Width - 1);
+      memcpy(&NewEntry.Pixels[((size_t)y * PaddedWidth + x) * 4], &Source[((size_t)SourceY * Width + SourceX) * 4], 4);
+    }
+  }
+
+  bool Placed = false;
+
+  for(uint32_t i = 0; i < Pages.size() && !Placed; i++)
+  {
+    Placed = Place(Pages[i], PaddedWidth, PaddedHeight, NewEntry.X, NewEntry.Y);
+    NewEntry.Page = i;
+  }
+
+  // holes from removed entries are only usable after a repack, try that before growing
+  for(uint32_t i = 0; i < Pages.size() && !Placed; i++)
+  {
+    if(Pages[i].FreedArea >= (uint64_t)PaddedWidth * PaddedHeight)
+    {
+      RepackPage(i);
+      Placed = Place(Pages[i], PaddedWidth, PaddedHeight, NewEntry.X, NewEntry.Y);
+      NewEntry.Page = i;
+    }
+  }
+
+  if(!Placed)
+  {
+    NewEntry.Page = NewPage();
+    Place(Pages[NewEntry.Page], PaddedWidth, PaddedHeight, NewEntry.X, NewEntry.Y);
+  }
+
+  uint32_t Handle;
+
+  if(!FreeEntries.empty())
+  {
+    Handle = FreeEntries.back();
+    FreeEntries.pop_back();
+    Entries[Handle] = std::move(NewEntry);
+  }
+  else
+  {
+    Handle = Entries.size();
+    Entries.push_back(std::move(NewEntry));
+  }
+
+  Upload(Entries[Handle]);
+
+  return Handle;
+}
+
+void TextureAtlas::Remove(uint32_t Handle)
+{
+  if(Handle >= Entries.size() || !Entries[Handle].Live)
+  {
+    throw std::runtime_error("Invalid atlas handle");
+  }
+
+  Entry& Target = Entries[Handle];
+
+  Pages[Target.Page].FreedArea += (uint64_t)Target.Width * Target.Height;
+
+  Target.Live = false;
+  Target.Pixels = std::vector<uint8_t>();
+  FreeEntries.push_back(Handle);
+}
+
+AtlasRect TextureAtlas::Get(uint32_t Handle) const
+{
+  if(Handle >= Entries.size() || !Entries[Handle].Live)
+  {
+    throw std::runtime_error("Invalid atlas handle");
+  }
+
+  const Entry& Target = Entries[Handle];
+  float Scale = 1.f / PageSize;
+
+  AtlasRect Ret;
+  Ret.TextureIndex = Pages[Target.Page].TextureIndex;
+  Ret.UVRect = glm::vec4(Target.X + Padding, Target.Y + Padding, Target.X + Target.Width - Padding, Target.Y + Target.Height - Padding) * Scale;
+
+  return Ret;
+}
+
+void TextureAtlas::Repack()
+{
+  for(uint32_t i = 0; i < Pages.size(); i++)
+  {
+    if(Pages[i].FreedArea > 0)
+    {
+      RepackPage(i);
+    }
+  }
+}
+
+void TextureAtlas::RepackPage(uint32_t PageIndex)
+{
+  std::vector<uint32_t> Live;
+  for(uint32_t i = 0; i < Entries.size(); i++)
+  {
+    if(Entries[i].Live && Entries[i].Page == PageIndex)
+    {
+      Live.push_back(i);
+    }
+  }
+
+  // tallest first packs a skyline tighter than arrival order
+  std::sort(Live.begin(), Live.end(), [this](uint32_t a, uint32_t b) { return Entries[a].Height > Entries[b].Height; });
+
+  Page& Target = Pages[PageIndex];
+  Target.Skyline.assign(1, SkylineNode{0, 0, PageSize});
+  Target.FreedArea = 0;
+
+  for(uint32_t Handle : Live)
+  {
+    Entry& Moved = Entries[Handle];
+
+    if(!Place(Pages[PageIndex], Moved.Width, Moved.Height, Moved.X, Moved.Y))
+    {
+      // a different order can come out worse, anything left over goes to the first page with room
+      bool Placed = false;
+
+      for(uint32_t i = 0; i < Pages.size() && !Placed; i++)
+      {
+        Placed = i != PageIndex && Place(Pages[i], Moved.Width, Moved.Height, Moved.X, Moved.Y);
+        Moved.Page = i;
+      }
+
+      if(!Placed)
+      {
+        Moved.Page = NewPage();
+        Place(Pages[Moved.Page], Moved.Width, Moved.Height, Moved.X, Moved.Y);
+      }
+    }
+
+    // overwritten in place, the upload is ordered after every frame that still samples the old layout
+    Upload(Moved);
+  }
+}
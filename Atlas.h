@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vulkan.h"
+
+// Where an atlas entry ended up, ready to go into a Quad.
+struct AtlasRect
+{
+  uint32_t TextureIndex;   // the page's texture table slot
+  glm::vec4 UVRect;        // u0, v0, u1, v1
+};
+
+// Packs many small RGBA8 images into a few large pages with a skyline packer, so icons and thumbnails share
+// one image, one allocation and one texture table slot per page.
+// Only the sub-rectangle of a new entry is uploaded. Removed entries leave holes a skyline can't reuse, so pages are
+// repacked from a CPU copy of their entries when nothing else fits. Repacking moves entries: look them up with Get()
+// every frame rather than keeping the rect.
+// Uploads are recorded into the current upload batch, frames see them once Uploads->Flush() has been called.
+class TextureAtlas
+{
+  public:
+  // Padding texels of clamped edge around every entry keep linear filtering from bleeding into neighbours.
+  TextureAtlas(uint32_t PageSize = 2048, uint32_t Padding = 1);
+  ~TextureAtlas();
+
+  // Copies Width x Height tightly packed RGBA8 texels into a page and returns a handle to them.
+  uint32_t Add(const void* Pixels, uint32_t Width, uint32_t Height);
+
+  // Frees the entry's space for the next repack.
+  void Remove(uint32_t Handle);
+
+  AtlasRect Get(uint32_t Handle) const;
+
+  // Repacks every page that has holes in it.
+  void Repack();
+
+  uint32_t PageCount() const { return Pages.size(); }
+
+  private:
+  struct SkylineNode
+  {
+    uint32_t X;
+    uint32_t Y;
+    uint32_t Width;
+  };
+
+  struct Page
+  {
+    Image Texture;
+    uint32_t TextureIndex;
+    bool Registered;
+    std::vector<SkylineNode> Skyline;
+    uint64_t FreedArea;        // texels of removed entries, only a repack gets them back
+  };
+
+  struct Entry
+  {
+    uint32_t Page;
+    uint32_t X;                // of the padded rect
+    uint32_t Y;
+    uint32_t Width;            // padded
+    uint32_t Height;
+    std::vector<uint8_t> Pixels;   // padded texels, kept for repacking
+    bool Live;
+  };
+
+  // Bottom-left skyline placement, returns false if the rect doesn't fit on the page.
+  bool Place(Page& Target, uint32_t Width, uint32_t Height, uint32_t& OutX, uint32_t& OutY);
+  int64_t FitAt(const Page& Target, size_t Node, uint32_t Width, uint32_t Height) const;
+
+  uint32_t NewPage();
+  void RepackPage(uint32_t PageIndex);
+  void Upload(Entry& Target);
+
+  uint32_t PageSize;
+  uint32_t Padding;
+  VkSampler Sampler;
+
+  std::vector<Page> Pages;
+  std::vector<Entry> Entries;
+  std::vector<uint32_t> FreeEntries;
+};
@@ -0,0 +1,574 @@
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#include <sys/resource.h>
+
+#include <stb/stb_image.h>
+
+#include "Vulkan.h"
+#include "TextureLoader.h"
+#include "Frames.h"
+#include "PipelineCache.h"
+#include "Upload.h"
+#include "TextureTable.h"
+#include "Atlas.h"
+#include "MappedFile.h"
+#include "PixelConvert.h"
+#include "Recorder.h"
+#include "Capture.h"
+
+// Times each stage of the renderer over a set of images and writes the results as JSON.
+// Runs headless, so it works on a software driver (lavapipe, SwiftShader) with no display.
+
+struct Phase
+{
+  std::string Name;
+  double Seconds;
+  uint64_t Items;             // textures, frames or recordings, whatever the phase counts
+  uint64_t Bytes;
+  long PeakRssKb;             // process high-water mark at the end of the phase
+  VkDeviceSize DeviceReserved;
+  VkDeviceSize DeviceUsed;
+};
+
+static double SecondsSince(std::chrono::steady_clock::time_point Start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+static long PeakRss()
+{
+  rusage Usage;
+  getrusage(RUSAGE_SELF, &Usage);
+  return Usage.ru_maxrss;
+}
+
+static Phase EndPhase(const char* Name, std::chrono::steady_clock::time_point Start, uint64_t Items, uint64_t Bytes)
+{
+  Phase Ret;
+  Ret.Name = Name;
+  Ret.Seconds = SecondsSince(Start);
+  Ret.Items = Items;
+  Ret.Bytes = Bytes;
+  Ret.PeakRssKb = PeakRss();
+
+  AllocatorStats Stats = Context->Allocator ? Context->Allocator->Stats() : AllocatorStats{};
+  Ret.DeviceReserved = Stats.Reserved;
+  Ret.DeviceUsed = Stats.Used;
+
+  std::cout << Name << ": " << Ret.Seconds * 1000.0 << "ms\n";
+
+  return Ret;
+}
+
+// Uncompressed 32 bit TGA, stb_image reads it without a dependency on an encoder.
+static void WriteSyntheticImage(const std::string& Path, uint32_t Size, uint32_t Seed)
+{
+  uint8_t Header[18]{};
+  Header[2] = 2;                      // uncompressed true color
+  Header[12] = Size & 0xFF;
+  Header[13] = (Size >> 8) & 0xFF;
+  Header[14] = Size & 0xFF;
+  Header[15] = (Size >> 8) & 0xFF;
+  Header[16] = 32;
+  Header[17] = 0x28;                  // top-left origin, 8 alpha bits
+
+  std::vector<uint8_t> Pixels(size_t(Size) * Size * 4);
+
+  // a gradient with some hash noise on top, so mip levels aren't all the same color
+  uint32_t State = Seed * 2654435761u + 1;
+  for(uint32_t y = 0; y < Size; y++)
+  {
+    for(uint32_t x = 0; x < Size; x++)
+    {
+      State ^= State << 13; State ^= State >> 17; State ^= State << 5;
+
+      uint8_t* Texel = &Pixels[(size_t(y) * Size + x) * 4];
+      Texel[0] = (x * 255 / Size) ^ (State & 0x1F);
+      Texel[1] = (y * 255 / Size) ^ ((State >> 8) & 0x1F);
+      Texel[2] = Seed * 37;
+      Texel[3] = 255;
+    }
+  }
+
+  std::ofstream File(Path, std::ios::binary);
+  if(!File.is_open())
+  {
+    throw std::runtime_error("Failed to write " + Path);
+  }
+
+  File.write(reinterpret_cast<const char*>(Header), sizeof(Header));
+  File.write(reinterpret_cast<const char*>(Pixels.data()), Pixels.size());
+}
+
+static void WriteReport(std::ostream& Out, const std::vector<Phase>& Phases, const char* DeviceName, uint32_t ImageCount, uint32_t ImageSize,
+                        const char* MipPath)
+{
+  Out << "{\n";
+  Out << "  \"device\": \"" << DeviceName << "\",\n";
+  Out << "  \"images\": " << ImageCount << ",\n";
+  Out << "  \"image_size\": " << ImageSize << ",\n";
+  Out << "  \"peak_rss_kb\": " << PeakRss() << ",\n";
+  Out << "  \"pixel_kernel\": \"" << PixelKernelName() << "\",\n";
+  Out << "  \"mips\": \"" << MipPath << "\",\n";
+  Out << "  \"phases\": [\n";
+
+  for(size_t i = 0; i < Phases.size(); i++)
+  {
+    const Phase& P = Phases[i];
+    double PerSecond = P.Seconds > 0.0 ? P.Items / P.Seconds : 0.0;
+    double MBPerSecond = P.Seconds > 0.0 ? P.Bytes / (1024.0 * 1024.0) / P.Seconds : 0.0;
+
+    Out << "    { \"name\": \"" << P.Name << "\""
+        << ", \"seconds\": " << P.Seconds
+        << ", \"items\": " << P.Items
+        << ", \"items_per_second\": " << PerSecond
+        << ", \"bytes\": " << P.Bytes
+        << ", \"mb_per_second\": " << MBPerSecond
+        << ", \"peak_rss_kb\": " << P.PeakRssKb
+        << ", \"device_reserved_bytes\": " << P.DeviceReserved
+        << ", \"device_used_bytes\": " << P.DeviceUsed
+        << " }" << (i + 1 < Phases.size() ? "," : "") << '\n';
+  }
+
+  Out << "  ]\n";
+  Out << "}\n";
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t ImageCount = 64;
+  uint32_t ImageSize = 512;
+  uint64_t FrameCount = 1000;
+  uint32_t Recordings = 100;
+  uint32_t FramesInFlight = 2;
+  uint64_t CaptureFrames = 100;
+  bool Validation = false;
+  bool ComputeMips = false;
+  std::string WorkDir = ".";
+  const char* PipelineCachePath = nullptr;
+  const char* OutPath = "benchmark.json";
+  std::vector<std::string> Files;
+
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+    {
+      ImageCount = std::max(1, atoi(argv[++i]));
+    }
+    else if(strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+    {
+      ImageSize = std::min(65535, std::max(1, atoi(argv[++i])));
+    }
+    else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+    {
+      FrameCount = strtoull(argv[++i], nullptr, 10);
+    }
+    else if(strcmp(argv[i], "--recordings") == 0 && i + 1 < argc)
+    {
+      Recordings = std::max(1, atoi(argv[++i]));
+    }
+    else if(strcmp(argv[i], "--capture-frames") == 0 && i + 1 < argc)
+    {
+      // 0 skips the capture phase
+      CaptureFrames = strtoull(argv[++i], nullptr, 10);
+    }
+    else if(strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+    {
+      FramesInFlight = std::max(1, atoi(argv[++i]));
+    }
+    else if(strcmp(argv[i], "--texture") == 0 && i + 1 < argc)
+    {
+      Files.push_back(argv[++i]);
+    }
+    else if(strcmp(argv[i], "--work-dir") == 0 && i + 1 < argc)
+    {
+      WorkDir = argv[++i];
+    }
+    else if(strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc)
+    {
+      PipelineCachePath = argv[++i];
+    }
+    else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+    {
+      OutPath = argv[++i];
+    }
+    else if(strcmp(argv[i], "--validation") == 0)
+    {
+      Validation = true;
+    }
+    else if(strcmp(argv[i], "--compute-mips") == 0)
+    {
+      // the kernel for formats that can't be blitted, even where they can
+      ComputeMips = true;
+    }
+  }
+
+  // --texture replaces the synthetic set, so real JPEGs/PNGs can be measured too
+  bool Synthetic = Files.empty();
+  if(Synthetic)
+  {
+    for(uint32_t i = 0; i < ImageCount; i++)
+    {
+      Files.push_back(WorkDir + "/bench_" + std::to_string(i) + ".tga");
+      WriteSyntheticImage(Files.back(), ImageSize, i);
+    }
+  }
+
+  std::vector<Phase> Phases;
+
+  Context = new Vulkan();
+  Context->Headless = true;
+  Context->Validation = Validation;
+
+  // Init
+    auto Start = std::chrono::steady_clock::now();
+
+    InitVulkan(FramesInFlight);
+    Context->Uploads->ForceComputeMips = ComputeMips;
+
+    // without a path the cache starts cold and nothing is written, so every run measures the same thing
+    std::string CachePath = PipelineCachePath ? PipelineCachePath : WorkDir + "/bench_pipeline.cache";
+    if(!PipelineCachePath)
+    {
+      std::remove(CachePath.c_str());
+    }
+    Context->Pipelines = new PipelineCache(CachePath.c_str());
+    Context->Profiler = nullptr;
+    Context->Textures = new TextureTable();
+
+    Phases.push_back(EndPhase("init", Start, 1, 0));
+  // Init
+
+  VkPhysicalDeviceProperties DevProps;
+  vkGetPhysicalDeviceProperties(Context->PhysicalDevice, &DevProps);
+
+  // ReadFile
+    Start = std::chrono::steady_clock::now();
+    uint64_t FileBytes = 0;
+
+    for(const std::string& Path : Files)
+    {
+      FileBytes += ReadFile(Path.c_str()).size();
+    }
+
+    Phases.push_back(EndPhase("read_file", Start, Files.size(), FileBytes));
+  // ReadFile
+
+  // MapFile, every page touched so it's comparable with ReadFile
+    Start = std::chrono::steady_clock::now();
+    volatile uint8_t Touched;
+
+    for(const std::string& Path : Files)
+    {
+      MappedFile Mapped = MapFile(Path);
+
+      for(uint64_t Offset = 0; Offset < Mapped.Size(); Offset += 4096)
+      {
+        Touched = Mapped.Data()[Offset];
+      }
+    }
+
+    Phases.push_back(EndPhase("map_file", Start, Files.size(), FileBytes));
+  // MapFile
+
+  // Decode, single threaded, pixels are kept for the upload phase
+    struct Decoded
+    {
+      unsigned char* Pixels;
+      uint32_t Width;
+      uint32_t Height;
+    };
+
+    std::vector<Decoded> Images;
+    uint64_t PixelBytes = 0;
+
+    Start = std::chrono::steady_clock::now();
+
+    for(const std::string& Path : Files)
+    {
+      // same as the loader's workers, decoded straight out of the mapping
+      MappedFile Encoded = MapFile(Path);
+
+      int Width, Height, Channels;
+      unsigned char* Pixels = stbi_load_from_memory(Encoded.Data(), Encoded.Size(), &Width, &Height, &Channels, STBI_rgb_alpha);
+
+      if(!Pixels)
+      {
+        throw std::runtime_error("Failed to decode " + Path + ": " + stbi_failure_reason());
+      }
+
+      Images.push_back(Decoded{Pixels, uint32_t(Width), uint32_t(Height)});
+      PixelBytes += uint64_t(Width) * Height * 4;
+    }
+
+    Phases.push_back(EndPhase("decode", Start, Images.size(), PixelBytes));
+  // Decode
+
+  // Convert, swizzle and premultiply each image into write-combined staging memory like the upload path does
+    {
+      uint64_t Largest = 0;
+      for(const Decoded& Source : Images)
+      {
+        Largest = std::max(Largest, uint64_t(Source.Width) * Source.Height * 4);
+      }
+
+      Buffer Target = CreateStagingBuffer(Largest);
+
+      PixelConversion Op;
+      Op.SwapRB = true;
+      Op.Premultiply = true;
+
+      Start = std::chrono::steady_clock::now();
+
+      for(const Decoded& Source : Images)
+      {
+        ConvertPixels(Source.Pixels, uint64_t(Source.Width) * 4, Target.Memory.Mapped, uint64_t(Source.Width) * 4, Source.Width, Source.Height, Op);
+      }
+
+      Phases.push_back(EndPhase("convert", Start, Images.size(), PixelBytes));
+
+      DestroyBuffer(Target);
+    }
+  // Convert
+
+  // Upload, staging copies plus mip generation, timed until the GPU is done with them
+    std::vector<Image> Uploaded;
+
+    Start = std::chrono::steady_clock::now();
+
+    for(const Decoded& Source : Images)
+    {
+      Uploaded.push_back(CreateTexture(Source.Pixels, Source.Width, Source.Height));
+    }
+
+    Context->Uploads->Flush();
+    Context->Uploads->WaitIdle();
+    vkQueueWaitIdle(Context->GraphicsQueue);
+
+    Phases.push_back(EndPhase("upload", Start, Uploaded.size(), PixelBytes));
+
+    for(Image& Texture : Uploaded)
+    {
+      DestroyImage(Texture);
+    }
+  // Upload
+
+  // Atlas, the same pixels packed into shared pages, then half removed and repacked
+    bool Packable = std::all_of(Images.begin(), Images.end(), [](const Decoded& Source) { return Source.Width <= 2046 && Source.Height <= 2046; });
+
+    if(Packable)
+    {
+      TextureAtlas Atlas;
+      std::vector<uint32_t> Entries;
+
+      Start = std::chrono::steady_clock::now();
+
+      for(const Decoded& Source : Images)
+      {
+        Entries.push_back(Atlas.Add(Source.Pixels, Source.Width, Source.Height));
+      }
+
+      Context->Uploads->Flush();
+      Context->Uploads->WaitIdle();
+      vkQueueWaitIdle(Context->GraphicsQueue);
+
+      Phases.push_back(EndPhase("atlas_pack", Start, Entries.size(), PixelBytes));
+
+      uint64_t Remaining = 0;
+      for(uint32_t i = 0; i < Entries.size(); i++)
+      {
+        if(i % 2)
+        {
+          Atlas.Remove(Entries[i]);
+        }
+        else
+        {
+          Remaining += uint64_t(Images[i].Width) * Images[i].Height * 4;
+        }
+      }
+
+      Start = std::chrono::steady_clock::now();
+
+      Atlas.Repack();
+      Context->Uploads->Flush();
+      Context->Uploads->WaitIdle();
+      vkQueueWaitIdle(Context->GraphicsQueue);
+
+      Phases.push_back(EndPhase("atlas_repack", Start, (Entries.size() + 1) / 2, Remaining));
+      std::cout << "Atlas pages: " << Atlas.PageCount() << '\n';
+    }
+
+    for(Decoded& Source : Images)
+    {
+      stbi_image_free(Source.Pixels);
+    }
+  // Atlas
+
+  // Loader, the threaded path the renderer actually uses, decode and upload overlapped
+    TextureLoader Loader;
+    std::vector<uint32_t> Handles;
+
+    Start = std::chrono::steady_clock::now();
+
+    for(const std::string& Path : Files)
+    {
+      Handles.push_back(Loader.Load(Path.c_str()));
+    }
+
+    Loader.WaitAll();
+    Context->Uploads->WaitIdle();
+    vkQueueWaitIdle(Context->GraphicsQueue);
+
+    Phases.push_back(EndPhase("texture_loader", Start, Handles.size(), PixelBytes));
+  // Loader
+
+  Image Texture = Loader.Get(Handles[0]);
+  VkSampler TextureSampler = CreateSampler(Texture.MipLevels, 0.f);
+
+  // every loaded texture gets a slot, the quad samples the first
+  std::vector<uint32_t> TextureIndices;
+  for(uint32_t Handle : Handles)
+  {
+    TextureIndices.push_back(Context->Textures->Register(Loader.Get(Handle), TextureSampler));
+  }
+
+  InitRendering(&Texture);
+
+  // Pipeline, shader modules from the embedded SPIR-V included
+    Start = std::chrono::steady_clock::now();
+
+    VkPipeline Pipeline = InitPipeline(&Texture, Context->Textures->Layout());
+
+    Phases.push_back(EndPhase(Context->Pipelines->Warm() ? "pipeline_warm" : "pipeline_cold", Start, 1, 0));
+  // Pipeline
+
+  VkDescriptorSet TextureSet = Context->Textures->Set();
+
+  // Recording, nothing has been submitted yet so every buffer can be re-recorded
+    Start = std::chrono::steady_clock::now();
+
+    for(uint32_t i = 0; i < Recordings; i++)
+    {
+      RecordRenderBuffers(Pipeline, TextureSet, TextureIndices[0]);
+    }
+
+    Phases.push_back(EndPhase("record", Start, uint64_t(Recordings) * Context->RenderBuffers.size(), 0));
+  // Recording
+
+  // Parallel recording, a draw per loaded texture split across every core into secondaries, one frame per recording
+    {
+      CommandRecorder Recorder(FramesInFlight);
+
+      Start = std::chrono::steady_clock::now();
+
+      for(uint32_t i = 0; i < Recordings; i++)
+      {
+        Recorder.Record(i % FramesInFlight, i % Context->RenderBuffers.size(), TextureIndices.size(), [&](VkCommandBuffer Cmd, uint32_t First, uint32_t Count)
+        {
+          for(uint32_t t = First; t < First + Count; t++)
+          {
+            RecordFullscreenQuad(Cmd, Pipeline, TextureSet, TextureIndices[t]);
+          }
+        });
+      }
+
+      Phases.push_back(EndPhase("record_parallel", Start, Recordings, 0));
+    }
+  // Parallel recording
+
+  // Frames
+    {
+      FrameScheduler Frames(FramesInFlight, []() {});
+      uint32_t ImageIndex = 0;
+
+      Start = std::chrono::steady_clock::now();
+
+      while(Frames.FrameCount() < FrameCount)
+      {
+        if(Frames.BeginFrame(ImageIndex))
+        {
+          Frames.EndFrame(Context->RenderBuffers[ImageIndex]);
+        }
+      }
+
+      vkDeviceWaitIdle(Context->Device);
+
+      uint64_t TargetBytes = uint64_t(Context->Extent.width) * Context->Extent.height * 4;
+      Phases.push_back(EndPhase("frames", Start, Frames.FrameCount(), Frames.FrameCount() * TargetBytes));
+    }
+  // Frames
+
+  // Capture, frames to PNG files on disk, timed until the last one is written
+    if(CaptureFrames > 0)
+    {
+      std::string CaptureDir = WorkDir + "/bench_capture";
+
+      FrameScheduler Frames(FramesInFlight, []() {});
+      uint32_t ImageIndex = 0;
+
+      {
+        FrameCapture Capture(CaptureDir, CaptureFormat::Png);
+
+        Start = std::chrono::steady_clock::now();
+
+        while(Frames.FrameCount() < CaptureFrames)
+        {
+          if(Frames.BeginFrame(ImageIndex))
+          {
+            Frames.EndFrame(Context->RenderBuffers[ImageIndex], &Capture);
+          }
+        }
+
+        Capture.Flush();
+
+        uint64_t TargetBytes = uint64_t(Context->Extent.width) * Context->Extent.height * 4;
+        Phases.push_back(EndPhase("capture_png", Start, Capture.CapturedCount(), Capture.CapturedCount() * TargetBytes));
+      }
+
+      vkDeviceWaitIdle(Context->Device);
+
+      for(uint64_t f = 0; f < CaptureFrames; f++)
+      {
+        char Name[32];
+        snprintf(Name, sizeof(Name), "/frame_%06llu.png", (unsigned long long)f);
+        std::remove((CaptureDir + Name).c_str());
+      }
+
+      std::remove(CaptureDir.c_str());
+    }
+  // Capture
+
+  if(PipelineCachePath)
+  {
+    Context->Pipelines->Save();
+  }
+
+  if(Synthetic)
+  {
+    for(const std::string& Path : Files)
+    {
+      std::remove(Path.c_str());
+    }
+  }
+
+  std::ofstream Out(OutPath);
+  if(!Out.is_open())
+  {
+    throw std::runtime_error(std::string("Failed to open ") + OutPath);
+  }
+
+  const char* MipPath = Context->Uploads->ComputesMips(VK_FORMAT_R8G8B8A8_SRGB) ? "compute" : "blit";
+  WriteReport(Out, Phases, DevProps.deviceName, Files.size(), Synthetic ? ImageSize : 0, MipPath);
+  WriteReport(std::cout, Phases, DevProps.deviceName, Files.size(), Synthetic ? ImageSize : 0, MipPath);
+
+  return 0;
+}
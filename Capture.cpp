@@ -0,0 +1,358 @@
+#include "Capture.h"
+#include "PixelConvert.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+FrameCapture::FrameCapture(const std::string& Directory, CaptureFormat Format, uint32_t SlotCount, uint32_t WorkerCount)
+  : Directory(Directory), Format(Format), Encoded(std::max(1u, SlotCount)), Workers(WorkerCount)
+{
+  if(mkdir(Directory.c_str(), 0755) != 0 && errno != EEXIST)
+  {
+    throw std::runtime_error("Failed to create capture directory " + Directory);
+  }
+
+  if(!Context->Headless)
+  {
+    VkSurfaceCapabilitiesKHR SurfaceCap;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Context->PhysicalDevice, Context->RenderSurface, &SurfaceCap);
+
+    if(!(SurfaceCap.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+    {
+      throw std::runtime_error("Capture needs swapchain images that can be copied from");
+    }
+  }
+
+  VkCommandPoolCreateInfo PoolCI{};
+  PoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  PoolCI.queueFamilyIndex = Context->GraphicsFamily;
+  PoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  if(vkCreateCommandPool(Context->Device, &PoolCI, nullptr, &Pool) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create a command pool");
+  }
+
+  Slots.resize(std::max(1u, SlotCount));
+
+  std::vector<VkCommandBuffer> Cmds(Slots.size());
+
+  VkCommandBufferAllocateInfo CmdAllocInfo{};
+  CmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  CmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  CmdAllocInfo.commandPool = Pool;
+  CmdAllocInfo.commandBufferCount = Cmds.size();
+
+  if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, Cmds.data()) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create command buffers");
+  }
+
+  for(uint32_t i = 0; i < Slots.size(); i++)
+  {
+    Slot& Target = Slots[i];
+    Target = Slot{};
+    Target.Cmd = Cmds[i];
+    Target.State = SlotState::Free;
+  }
+
+  Start = std::chrono::steady_clock::now();
+}
+
+FrameCapture::~FrameCapture()
+{
+  Flush();
+
+  for(Slot& Target : Slots)
+  {
+    if(Target.Size > 0)
+    {
+      DestroyBuffer(Target.Readback);
+    }
+  }
+
+  vkDestroyCommandPool(Context->Device, Pool, nullptr);
+}
+
+bool FrameCapture::ParseFormat(const char* Name, CaptureFormat& Format)
+{
+  if(strcmp(Name, "png") == 0)
+  {
+    Format = CaptureFormat::Png;
+  }
+  else if(strcmp(Name, "jpg") == 0 || strcmp(Name, "jpeg") == 0)
+  {
+    Format = CaptureFormat::Jpeg;
+  }
+  else if(strcmp(Name, "raw") == 0)
+  {
+    Format = CaptureFormat::Raw;
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+void FrameCapture::Poll()
+{
+  uint32_t Index;
+  while(Encoded.Pop(Index))
+  {
+    Slots[Index].State = SlotState::Free;
+    Written++;
+  }
+
+  // copies finish in submission order but checking each is as cheap as tracking the oldest
+  for(uint32_t i = 0; i < Slots.size(); i++)
+  {
+    if(Slots[i].State == SlotState::Copying && Context->Sync->Reached(Slots[i].Copied))
+    {
+      Encode(i);
+    }
+  }
+}
+
+uint32_t FrameCapture::Acquire()
+{
+  auto WaitStart = std::chrono::steady_clock::now();
+
+  Poll();
+
+  for(;;)
+  {
+    uint32_t Oldest = UINT32_MAX;
+
+    for(uint32_t i = 0; i < Slots.size(); i++)
+    {
+      if(Slots[i].State == SlotState::Free)
+      {
+        Blocked += std::chrono::steady_clock::now() - WaitStart;
+        return i;
+      }
+
+      if(Slots[i].State == SlotState::Copying && (Oldest == UINT32_MAX || Slots[i].Frame < Slots[Oldest].Frame))
+      {
+        Oldest = i;
+      }
+    }
+
+    // every slot is busy, the copies or the encoders are behind the render loop
+    if(Oldest != UINT32_MAX)
+    {
+      Context->Sync->Wait(Slots[Oldest].Copied);
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+
+    Poll();
+  }
+}
+
+void FrameCapture::Submit(uint32_t ImageIndex, VkSemaphore Signal)
+{
+  uint32_t Index = Acquire();
+  Slot& Target = Slots[Index];
+
+  const Image& Swap = Context->SwapImages[ImageIndex];
+
+  switch(Swap.ImageFormat)
+  {
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM: Target.SwapRB = true; break;
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_R8G8B8A8_UNORM: Target.SwapRB = false; break;
+    default: throw std::runtime_error("Capture only handles 8 bit RGBA/BGRA targets");
+  }
+
+  Target.Width = Context->Extent.width;
+  Target.Height = Context->Extent.height;
+
+  // the extent only changes with the swapchain, slots grow then and keep their buffer otherwise
+  VkDeviceSize Size = VkDeviceSize(Target.Width) * Target.Height * 4;
+
+  if(Target.Size < Size)
+  {
+    if(Target.Size > 0)
+    {
+      DestroyBuffer(Target.Readback);
+    }
+
+    Target.Readback = CreateReadbackBuffer(Size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    Target.Size = Size;
+  }
+
+  // Barriers
+    // written by the render pass, or by the post processor's copy
+    VkImageMemoryBarrier ToCopy{};
+    ToCopy.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    ToCopy.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ToCopy.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ToCopy.image = Swap.Image;
+    ToCopy.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    ToCopy.oldLayout = Context->PresentLayout;
+    ToCopy.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    ToCopy.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    ToCopy.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    // back where present or the next frame expects it. The next frame's render pass doesn't wait for anything,
+    // so the copy has to be done before any later command starts
+    VkImageMemoryBarrier ToFinal = ToCopy;
+    ToFinal.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    ToFinal.newLayout = Context->PresentLayout;
+    ToFinal.srcAccessMask = 0;
+    ToFinal.dstAccessMask = 0;
+
+    // the fence alone doesn't make the copy visible to the host
+    VkBufferMemoryBarrier ToHost{};
+    ToHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    ToHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ToHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ToHost.buffer = Target.Readback.Buffer;
+    ToHost.offset = 0;
+    ToHost.size = Size;
+    ToHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    ToHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  // Barriers
+
+  VkBufferImageCopy Region{};
+  Region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+  Region.imageExtent = VkExtent3D{Target.Width, Target.Height, 1};
+
+  VkCommandBufferBeginInfo BeginInf{};
+  BeginInf.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  BeginInf.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(Target.Cmd, &BeginInf);
+    vkCmdPipelineBarrier(Target.Cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &ToCopy);
+
+    vkCmdCopyImageToBuffer(Target.Cmd, Swap.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Target.Readback.Buffer, 1, &Region);
+
+    vkCmdPipelineBarrier(Target.Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &ToFinal);
+    vkCmdPipelineBarrier(Target.Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &ToHost, 0, nullptr);
+  vkEndCommandBuffer(Target.Cmd);
+
+  // same queue as the frame, submission order puts it after the frame and the first barrier waits for its writes
+  BinarySync Present;
+  Present.Signal = Signal;
+
+  Target.Copied = Context->Sync->Submit(QueueKind::Graphics, Target.Cmd, {}, Present);
+
+  Target.State = SlotState::Copying;
+  Target.Frame = Captured++;
+}
+
+void FrameCapture::Encode(uint32_t Index)
+{
+  Slot& Target = Slots[Index];
+  Target.State = SlotState::Encoding;
+
+  VkDeviceSize Size = VkDeviceSize(Target.Width) * Target.Height * 4;
+  Context->Allocator->Invalidate(Target.Readback.Memory, 0, Size);
+
+  char Name[32];
+  const char* Extension = Format == CaptureFormat::Png ? "png" : Format == CaptureFormat::Jpeg ? "jpg" : "rgba";
+  snprintf(Name, sizeof(Name), "/frame_%06llu.%s", (unsigned long long)Target.Frame, Extension);
+
+  // the slot isn't reused until the worker hands it back, so it reads the mapped buffer in place
+  Workers.Submit([this, Index, Path = Directory + Name, Pixels = static_cast<const uint8_t*>(Target.Readback.Memory.Mapped),
+                  Width = Target.Width, Height = Target.Height, SwapRB = Target.SwapRB]
+  {
+    std::vector<uint8_t> Converted;
+    const uint8_t* Rgba = Pixels;
+    uint32_t Pitch = Width * 4;
+
+    if(SwapRB)
+    {
+      PixelConversion Op;
+      Op.SwapRB = true;
+
+      Converted.resize(size_t(Pitch) * Height);
+      ConvertPixels(Pixels, Pitch, Converted.data(), Pitch, Width, Height, Op);
+      Rgba = Converted.data();
+    }
+
+    bool Ok = false;
+
+    if(Format == CaptureFormat::Png)
+    {
+      Ok = stbi_write_png(Path.c_str(), Width, Height, 4, Rgba, Pitch) != 0;
+    }
+    else if(Format == CaptureFormat::Jpeg)
+    {
+      Ok = stbi_write_jpg(Path.c_str(), Width, Height, 4, Rgba, 90) != 0;
+    }
+    else
+    {
+      std::ofstream File(Path, std::ios::binary);
+      File.write(reinterpret_cast<const char*>(Rgba), size_t(Pitch) * Height);
+      Ok = File.good();
+    }
+
+    if(!Ok && Failed++ == 0)
+    {
+      std::lock_guard<std::mutex> Guard(ErrorLock);
+      FirstError = "Failed to write " + Path;
+    }
+
+    // the render thread drains this every frame, and it has room for every slot
+    while(!Encoded.Push(uint32_t(Index)))
+    {
+      std::this_thread::yield();
+    }
+  });
+}
+
+void FrameCapture::Flush()
+{
+  while(Written < Captured)
+  {
+    bool Copying = false;
+
+    for(Slot& Target : Slots)
+    {
+      if(Target.State == SlotState::Copying)
+      {
+        Context->Sync->Wait(Target.Copied);
+        Copying = true;
+      }
+    }
+
+    Poll();
+
+    if(!Copying)
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void FrameCapture::PrintStats() const
+{
+  double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+  double BlockedMs = std::chrono::duration<double, std::milli>(Blocked).count();
+
+  std::cout << "Capture: " << Written << " frames written to " << Directory << " with " << Workers.WorkerCount() << " encoders, "
+            << (Seconds > 0.0 ? Written / Seconds : 0.0) << " frames/s, "
+            << (Captured > 0 ? BlockedMs / Captured : 0.0) << " ms/frame waiting for a free slot\n";
+
+  if(Failed > 0)
+  {
+    std::cout << "  " << Failed << " failed, first: " << FirstError << '\n';
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Vulkan.h"
+#include "ThreadPool.h"
+#include "Timeline.h"
+
+enum class CaptureFormat
+{
+  Png,
+  Jpeg,
+  Raw       // tightly packed RGBA8 rows, top row first
+};
+
+// Writes rendered frames to disk without the render loop waiting on either the GPU or the encoder.
+// Each captured frame is copied out of its swap image into one of a ring of host readback buffers, submitted right
+// after the frame and before it's presented. Finished copies are found by polling the graphics timeline, and the buffer is
+// handed as is to a worker that encodes it and gives the slot back. The render thread only blocks when every slot is
+// still copying or encoding, which is the encoders falling behind rather than a stall per frame.
+class FrameCapture
+{
+  public:
+  // Frames go to Directory as frame_000000.png/.jpg/.rgba, numbered in capture order. SlotCount bounds the frames between
+  // the copy and the file, WorkerCount of 0 is one encoder per hardware thread.
+  FrameCapture(const std::string& Directory, CaptureFormat Format, uint32_t SlotCount = 8, uint32_t WorkerCount = 0);
+  // Writes out everything still pending. Destroy with the device idle.
+  ~FrameCapture();
+
+  // Records and submits the copy of ImageIndex on the graphics queue, after the frame that rendered it.
+  // Signal is signaled once the copy is done, so present can wait on it instead of on the frame. Null headless.
+  void Submit(uint32_t ImageIndex, VkSemaphore Signal);
+
+  // Hands finished copies to the encoders and takes back slots they're done with. Submit() polls too.
+  void Poll();
+
+  // Blocks until every captured frame is on disk.
+  void Flush();
+
+  uint64_t CapturedCount() const { return Captured; }
+  void PrintStats() const;
+
+  static bool ParseFormat(const char* Name, CaptureFormat& Format);
+
+  private:
+  enum class SlotState
+  {
+    Free,
+    Copying,
+    Encoding
+  };
+
+  struct Slot
+  {
+    Buffer Readback;
+    VkDeviceSize Size;          // of Readback, 0 before the first use
+    VkCommandBuffer Cmd;
+    SyncPoint Copied;
+    SlotState State;
+    uint64_t Frame;
+    uint32_t Width;
+    uint32_t Height;
+    bool SwapRB;
+  };
+
+  // Waits for the oldest copy, or the encoders if nothing is copying, until a slot is free.
+  uint32_t Acquire();
+  void Encode(uint32_t Index);
+
+  std::string Directory;
+  CaptureFormat Format;
+
+  VkCommandPool Pool;
+  std::vector<Slot> Slots;
+
+  // slot indices the encoders are done with
+  CompletionQueue<uint32_t> Encoded;
+
+  uint64_t Captured = 0;
+  uint64_t Written = 0;
+  std::atomic<uint32_t> Failed{0};
+  std::mutex ErrorLock;
+  std::string FirstError;
+
+  std::chrono::steady_clock::time_point Start;
+  std::chrono::steady_clock::duration Blocked{};
+
+  // declared last so workers are joined before the queue they push into is destroyed
+  ThreadPool Workers;
+};
@@ -0,0 +1,213 @@
+#include "Frames.h"
+#include "PostProcess.h"
+#include "Capture.h"
+
+#include <iostream>
+#include <stdexcept>
+
+FrameScheduler::FrameScheduler(uint32_t FramesInFlight, std::function<void()> RecreateSwapchain) : RecreateSwapchain(RecreateSwapchain)
+{
+  if(FramesInFlight == 0)
+  {
+    throw std::runtime_error("Need at least one frame in flight");
+  }
+
+  Frames.resize(FramesInFlight);
+
+  VkSemaphoreCreateInfo SemaphoreCI{};
+  SemaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  // a slot starts out at point 0, so the first wait on each falls straight through
+  for(Frame& Slot : Frames)
+  {
+    if(vkCreateSemaphore(Context->Device, &SemaphoreCI, nullptr, &Slot.ImageAvailable) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create semaphore");
+    }
+  }
+
+  ResizeImages();
+
+  Start = std::chrono::steady_clock::now();
+}
+
+FrameScheduler::~FrameScheduler()
+{
+  vkDeviceWaitIdle(Context->Device);
+
+  for(Frame& Slot : Frames)
+  {
+    vkDestroySemaphore(Context->Device, Slot.ImageAvailable, nullptr);
+  }
+
+  for(VkSemaphore Semaphore : RenderFinished)
+  {
+    vkDestroySemaphore(Context->Device, Semaphore, nullptr);
+  }
+}
+
+void FrameScheduler::ResizeImages()
+{
+  for(VkSemaphore Semaphore : RenderFinished)
+  {
+    vkDestroySemaphore(Context->Device, Semaphore, nullptr);
+  }
+
+  RenderFinished.resize(Context->SwapImages.size());
+  ImagesInFlight.assign(Context->SwapImages.size(), SyncPoint{});
+
+  VkSemaphoreCreateInfo SemaphoreCI{};
+  SemaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  for(VkSemaphore& Semaphore : RenderFinished)
+  {
+    if(vkCreateSemaphore(Context->Device, &SemaphoreCI, nullptr, &Semaphore) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create semaphore");
+    }
+  }
+}
+
+void FrameScheduler::Recreate()
+{
+  vkDeviceWaitIdle(Context->Device);
+
+  RecreateSwapchain();
+  ResizeImages();
+}
+
+bool FrameScheduler::BeginFrame(uint32_t& ImageIndex)
+{
+  Frame& Slot = Frames[CurrentFrame];
+
+  auto WaitStart = std::chrono::steady_clock::now();
+
+  // the only place the CPU waits on the GPU, and only for the submission FramesInFlight frames ago
+  Context->Sync->Wait(Slot.Done);
+
+  if(Context->Headless)
+  {
+    // nothing to acquire, targets are handed out round robin and the wait above already covers reuse
+    ImageIndex = Submitted % Context->SwapImages.size();
+
+    Blocked += std::chrono::steady_clock::now() - WaitStart;
+
+    CurrentImage = ImageIndex;
+    return true;
+  }
+
+  VkResult Err = vkAcquireNextImageKHR(Context->Device, Context->Swapchain, UINT64_MAX, Slot.ImageAvailable, VK_NULL_HANDLE, &ImageIndex);
+
+  if(Err == VK_ERROR_OUT_OF_DATE_KHR)
+  {
+    // nothing was signaled or submitted, so the frame can just be dropped
+    Recreate();
+    return false;
+  }
+
+  // SUBOPTIMAL still signals ImageAvailable, so draw this frame and recreate after presenting it
+  if(Err != VK_SUCCESS && Err != VK_SUBOPTIMAL_KHR)
+  {
+    std::cout << "\n\n Failed to acquire next image "<< Err << "\n\n";
+    throw std::runtime_error("Failed to acquire next image");
+  }
+
+  // with more images than frame slots an image can come back while an older slot is still drawing to it
+  Context->Sync->Wait(ImagesInFlight[ImageIndex]);
+
+  Blocked += std::chrono::steady_clock::now() - WaitStart;
+
+  CurrentImage = ImageIndex;
+  return true;
+}
+
+void FrameScheduler::EndFrame(VkCommandBuffer Commands, FrameCapture* Capture)
+{
+  Frame& Slot = Frames[CurrentFrame];
+
+  BinarySync Binary;
+  if(!Context->Headless)
+  {
+    Binary.Wait = Slot.ImageAvailable;                               // Wait for the image to be acquired.
+    Binary.WaitStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;   // At this stage
+    Binary.Signal = RenderFinished[CurrentImage];
+  }
+
+  // present waits for the capture's copy instead, submitted after the frame
+  VkSemaphore PresentReady = Binary.Signal;
+
+  if(Capture)
+  {
+    Binary.Signal = VK_NULL_HANDLE;
+  }
+
+  if(Context->Post)
+  {
+    // the scene, the compute pass and the copy into the swap image, the last one waits for the acquire and signals
+    Slot.Done = Context->Post->Submit(CurrentImage, Commands, Waits, Binary);
+  }
+  else
+  {
+    Slot.Done = Context->Sync->Submit(QueueKind::Graphics, Commands, Waits, Binary);
+  }
+
+  Waits.clear();
+  ImagesInFlight[CurrentImage] = Slot.Done;
+
+  if(Capture)
+  {
+    Capture->Submit(CurrentImage, PresentReady);
+  }
+
+  if(Context->Headless)
+  {
+    CurrentFrame = (CurrentFrame + 1) % Frames.size();
+    Submitted++;
+    return;
+  }
+
+  VkPresentInfoKHR PresentInf{};
+  PresentInf.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+  PresentInf.swapchainCount = 1;
+  PresentInf.pSwapchains = &Context->Swapchain;
+  PresentInf.pImageIndices = &CurrentImage;
+  PresentInf.waitSemaphoreCount = 1;
+  PresentInf.pWaitSemaphores = &RenderFinished[CurrentImage];
+
+  VkResult Err = vkQueuePresentKHR(Context->GraphicsQueue, &PresentInf);
+
+  CurrentFrame = (CurrentFrame + 1) % Frames.size();
+  Submitted++;
+
+  if(Err == VK_ERROR_OUT_OF_DATE_KHR || Err == VK_SUBOPTIMAL_KHR)
+  {
+    Recreate();
+  }
+  else if(Err != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to present");
+  }
+}
+
+void FrameScheduler::WaitFor(SyncPoint Point, VkPipelineStageFlags Stages)
+{
+  Waits.push_back(SyncWait{Point, Stages});
+}
+
+void FrameScheduler::PrintStats() const
+{
+  double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+  double BlockedMs = std::chrono::duration<double, std::milli>(Blocked).count();
+
+  if(Submitted == 0 || Seconds <= 0.0)
+  {
+    return;
+  }
+
+  double FrameMs = Seconds * 1000.0 / Submitted;
+
+  std::cout << "Frames in flight: " << Frames.size() << '\n';
+  std::cout << "  " << Submitted << " frames in " << Seconds << "s, " << Submitted / Seconds << " fps\n";
+  std::cout << "  " << FrameMs << " ms/frame, " << FrameMs - BlockedMs / Submitted << " ms/frame CPU busy, "
+            << BlockedMs / Submitted << " ms/frame waiting on the GPU\n";
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Vulkan.h"
+#include "Timeline.h"
+
+class FrameCapture;
+
+// Paces the render loop with FramesInFlight frames queued on the GPU at once.
+// A frame slot's timeline point is only waited on when that slot comes around again, so the CPU records frame N+1 while the GPU draws frame N.
+class FrameScheduler
+{
+  public:
+  // RecreateSwapchain is called with the device idle whenever the swapchain is out of date or suboptimal.
+  FrameScheduler(uint32_t FramesInFlight, std::function<void()> RecreateSwapchain);
+  ~FrameScheduler();
+
+  // Waits for the slot to retire and acquires the next swap image, or picks the next offscreen target when headless.
+  // Returns false if the swapchain had to be recreated and the frame should be skipped.
+  bool BeginFrame(uint32_t& ImageIndex);
+
+  // Submits Commands for the image from BeginFrame and presents it once rendering has finished. Headless frames are only submitted.
+  // With Context->Post set, Commands render the scene and the post processor takes it from there.
+  // With Capture the frame is copied out for writing to disk before it's presented.
+  void EndFrame(VkCommandBuffer Commands, FrameCapture* Capture = nullptr);
+
+  // The next EndFrame doesn't start Stages before Point, for what the frame reads from other queues' submissions.
+  void WaitFor(SyncPoint Point, VkPipelineStageFlags Stages);
+
+  // Swap image count changes on recreation, the per-image semaphores follow it.
+  void ResizeImages();
+
+  uint32_t FrameSlot() const { return CurrentFrame; }
+  uint32_t FramesInFlight() const { return Frames.size(); }
+  uint64_t FrameCount() const { return Submitted; }
+
+  void PrintStats() const;
+
+  private:
+  struct Frame
+  {
+    VkSemaphore ImageAvailable;
+    SyncPoint Done;
+  };
+
+  void Recreate();
+
+  std::vector<Frame> Frames;
+
+  // indexed by swap image. RenderFinished is per image because present holds it until the image is reacquired
+  std::vector<VkSemaphore> RenderFinished;
+  std::vector<SyncPoint> ImagesInFlight;
+
+  std::vector<SyncWait> Waits;
+
+  std::function<void()> RecreateSwapchain;
+
+  uint32_t CurrentFrame = 0;
+  uint32_t CurrentImage = 0;
+
+  uint64_t Submitted = 0;
+  std::chrono::steady_clock::time_point Start;
+  std::chrono::steady_clock::duration Blocked{};
+};
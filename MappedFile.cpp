@@ -0,0 +1,128 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+MappedFile::MappedFile(MappedFile&& Other) noexcept : Mapping(Other.Mapping), Length(Other.Length), Opened(Other.Opened)
+{
+  Other.Mapping = nullptr;
+  Other.Length = 0;
+  Other.Opened = false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& Other) noexcept
+{
+  if(this != &Other)
+  {
+    Close();
+
+    Mapping = Other.Mapping;
+    Length = Other.Length;
+    Opened = Other.Opened;
+
+    Other.Mapping = nullptr;
+    Other.Length = 0;
+    Other.Opened = false;
+  }
+
+  return *this;
+}
+
+bool MappedFile::Open(const std::string& Path, FileAccess Access, std::string& Error)
+{
+  Close();
+
+  int File = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(File < 0)
+  {
+    Error = "can't open file: " + std::string(strerror(errno));
+    return false;
+  }
+
+  struct stat Info;
+  if(fstat(File, &Info) != 0)
+  {
+    Error = "can't stat file: " + std::string(strerror(errno));
+    close(File);
+    return false;
+  }
+
+  Length = Info.st_size;
+
+  // mmap refuses zero length, an empty file is just an empty span
+  if(Length > 0)
+  {
+    void* Mapped = mmap(nullptr, Length, PROT_READ, MAP_PRIVATE, File, 0);
+
+    if(Mapped == MAP_FAILED)
+    {
+      Error = "can't map file: " + std::string(strerror(errno));
+      close(File);
+      Length = 0;
+      return false;
+    }
+
+    Mapping = static_cast<const uint8_t*>(Mapped);
+
+    int Advice = Access == FileAccess::Sequential ? MADV_SEQUENTIAL : Access == FileAccess::Random ? MADV_RANDOM : MADV_WILLNEED;
+    madvise(Mapped, Length, Advice);
+  }
+
+  // the mapping keeps the file alive on its own
+  close(File);
+
+  Opened = true;
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if(Mapping)
+  {
+    munmap(const_cast<uint8_t*>(Mapping), Length);
+  }
+
+  Mapping = nullptr;
+  Length = 0;
+  Opened = false;
+}
+
+void MappedFile::Prefetch(uint64_t Offset, uint64_t Size) const
+{
+  if(!Mapping || Offset >= Length)
+  {
+    return;
+  }
+
+  // madvise wants a page aligned start
+  uint64_t PageSize = sysconf(_SC_PAGESIZE);
+  uint64_t Start = Offset / PageSize * PageSize;
+  uint64_t End = std::min(Offset + Size, Length);
+
+  madvise(const_cast<uint8_t*>(Mapping) + Start, End - Start, MADV_WILLNEED);
+}
+
+MappedFile MapFile(const std::string& Path, FileAccess Access)
+{
+  MappedFile Ret;
+  std::string Error;
+
+  if(!Ret.Open(Path, Access, Error))
+  {
+    throw std::runtime_error("Failed to map " + Path + ": " + Error);
+  }
+
+  return Ret;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// How a mapping is going to be read, passed on to the kernel with madvise.
+enum class FileAccess
+{
+  Sequential,   // front to back once, read ahead aggressively and drop pages behind
+  Random,       // scattered reads, no read ahead
+  WillNeed      // all of it soon, start reading the whole file in now
+};
+
+// Read-only mmap of a whole file. Readers use the page cache directly instead of copying into a heap buffer.
+// Move only, the mapping goes away with the last owner.
+class MappedFile
+{
+  public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& Other) noexcept;
+  MappedFile& operator=(MappedFile&& Other) noexcept;
+
+  // Returns false with Error set if the file can't be opened or mapped. An empty file opens with no mapping.
+  bool Open(const std::string& Path, FileAccess Access, std::string& Error);
+  void Close();
+
+  // Asks the kernel to start reading [Offset, Offset + Size) in, so the first touch doesn't block on the disk.
+  void Prefetch(uint64_t Offset, uint64_t Size) const;
+
+  const uint8_t* Data() const { return Mapping; }
+  uint64_t Size() const { return Length; }
+  bool IsOpen() const { return Opened; }
+
+  private:
+  const uint8_t* Mapping = nullptr;
+  uint64_t Length = 0;
+  bool Opened = false;
+};
+
+// Maps Path or throws, for files that have to be there like shaders.
+MappedFile MapFile(const std::string& Path, FileAccess Access = FileAccess::Sequential);
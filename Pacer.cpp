@@ -0,0 +1,127 @@
+#include "Pacer.h"
+
+#include <algorithm>
+#include <iostream>
+
+// how long Wait blocks at most while something is pending outside the event queue
+static const double PollSeconds = 0.01;
+
+FramePacer::FramePacer(bool OnDemand, float MaxFps) : OnDemand(OnDemand), MaxFps(MaxFps)
+{
+  if(MaxFps > 0.f)
+  {
+    Interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / MaxFps));
+  }
+
+  Start = std::chrono::steady_clock::now();
+  NextFrame = Start;
+
+  // resizes also come back as an out of date swapchain, but only once a frame is rendered to notice
+  if(!Context->Headless)
+  {
+    glfwSetWindowUserPointer(Context->Window, this);
+    glfwSetFramebufferSizeCallback(Context->Window, OnResize);
+    glfwSetWindowRefreshCallback(Context->Window, OnRefresh);
+    glfwSetWindowIconifyCallback(Context->Window, OnIconify);
+  }
+}
+
+FramePacer::~FramePacer()
+{
+  if(!Context->Headless)
+  {
+    glfwSetFramebufferSizeCallback(Context->Window, nullptr);
+    glfwSetWindowRefreshCallback(Context->Window, nullptr);
+    glfwSetWindowIconifyCallback(Context->Window, nullptr);
+    glfwSetWindowUserPointer(Context->Window, nullptr);
+  }
+}
+
+void FramePacer::Wait(bool Polling)
+{
+  std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+
+  if(Minimized || !Wanted())
+  {
+    if(Polling)
+    {
+      glfwWaitEventsTimeout(PollSeconds);
+    }
+    else
+    {
+      glfwWaitEvents();
+    }
+  }
+  else if(Now < NextFrame)
+  {
+    // held back by the cap, events still come through in the meantime
+    glfwWaitEventsTimeout(std::chrono::duration<double>(NextFrame - Now).count());
+  }
+  else
+  {
+    glfwPollEvents();
+    return;
+  }
+
+  Wakeups++;
+  Idle += std::chrono::steady_clock::now() - Now;
+}
+
+bool FramePacer::Due() const
+{
+  return !Minimized && Wanted() && std::chrono::steady_clock::now() >= NextFrame;
+}
+
+void FramePacer::Started()
+{
+  Dirty = false;
+  Rendered++;
+
+  // a frame that comes late doesn't let the next ones catch up
+  NextFrame = std::max(NextFrame + Interval, std::chrono::steady_clock::now());
+}
+
+void FramePacer::OnResize(GLFWwindow* Window, int, int)
+{
+  static_cast<FramePacer*>(glfwGetWindowUserPointer(Window))->Invalidate();
+}
+
+void FramePacer::OnRefresh(GLFWwindow* Window)
+{
+  static_cast<FramePacer*>(glfwGetWindowUserPointer(Window))->Invalidate();
+}
+
+void FramePacer::OnIconify(GLFWwindow* Window, int Iconified)
+{
+  FramePacer* Pacer = static_cast<FramePacer*>(glfwGetWindowUserPointer(Window));
+
+  Pacer->Minimized = Iconified == GLFW_TRUE;
+
+  // some platforms drop the contents while minimized
+  if(!Pacer->Minimized)
+  {
+    Pacer->Invalidate();
+  }
+}
+
+void FramePacer::PrintStats() const
+{
+  double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+  double IdleSeconds = std::chrono::duration<double>(Idle).count();
+
+  if(Seconds <= 0.0)
+  {
+    return;
+  }
+
+  std::cout << "Pacing: " << (OnDemand ? "on demand" : "continuous");
+
+  if(MaxFps > 0.f)
+  {
+    std::cout << ", capped at " << MaxFps << " fps";
+  }
+
+  std::cout << '\n';
+  std::cout << "  " << Rendered << " frames rendered in " << Seconds << "s, " << Wakeups << " waits on events\n";
+  std::cout << "  " << IdleSeconds << "s blocked waiting, " << IdleSeconds * 100.0 / Seconds << "% of the run\n";
+}
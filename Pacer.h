@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "Vulkan.h"
+
+// Decides when the window loop starts a frame and blocks in the event queue in between.
+// Continuous mode renders every time around the loop like before. On demand, a frame is only rendered after something
+// changed the image: an Invalidate() call, the window being resized, exposed or restored, or content that animates.
+// Otherwise the loop sleeps in glfwWaitEvents until the next event. MaxFps caps both modes, and keeps animated content
+// from running the GPU flat out.
+// Nothing is rendered while the window is minimized.
+class FramePacer
+{
+  public:
+  // MaxFps of 0 doesn't cap.
+  FramePacer(bool OnDemand, float MaxFps);
+  ~FramePacer();
+
+  // Handles window events, waiting for them as long as no frame is wanted or the cap holds the next one back.
+  // Polling wakes up every few milliseconds regardless, for work that finishes without posting an event, like texture loads.
+  void Wait(bool Polling);
+
+  // Whether to render a frame this time around the loop.
+  bool Due() const;
+  // Call once the frame has begun, it's what the image was invalidated for.
+  void Started();
+
+  // The next frame is rendered even if nothing else changed.
+  void Invalidate() { Dirty = true; }
+  // Animated content keeps rendering at the cap until it stops.
+  void SetAnimating(bool Animating) { this->Animating = Animating; }
+
+  void PrintStats() const;
+
+  private:
+  static void OnResize(GLFWwindow* Window, int Width, int Height);
+  static void OnRefresh(GLFWwindow* Window);
+  static void OnIconify(GLFWwindow* Window, int Iconified);
+
+  bool Wanted() const { return !OnDemand || Dirty || Animating; }
+
+  bool OnDemand;
+  float MaxFps;
+  std::chrono::steady_clock::duration Interval{};
+
+  // starts out dirty for the first frame
+  bool Dirty = true;
+  bool Animating = false;
+  bool Minimized = false;
+
+  std::chrono::steady_clock::time_point NextFrame;
+
+  uint64_t Rendered = 0;
+  uint64_t Wakeups = 0;
+  std::chrono::steady_clock::time_point Start;
+  std::chrono::steady_clock::duration Idle{};
+};
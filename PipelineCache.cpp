@@ -0,0 +1,106 @@
+#include "PipelineCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+PipelineCache::PipelineCache(const char* Path) : Path(Path)
+{
+  vkGetPhysicalDeviceProperties(Context->PhysicalDevice, &DevProps);
+
+  std::ifstream File(Path, std::ios::ate | std::ios::binary);
+  std::vector<char> Seed;   // the driver blob the file held
+
+  if(File.is_open())
+  {
+    std::vector<char> Contents(File.tellg());
+    File.seekg(0);
+    File.read(Contents.data(), Contents.size());
+
+    if(Validate(Contents))
+    {
+      Seed.assign(Contents.begin() + sizeof(FileHeader), Contents.end());
+      Loaded = true;
+    }
+    else
+    {
+      std::cout << "Pipeline cache " << Path << " is stale or from another device, starting cold\n";
+    }
+  }
+
+  VkPipelineCacheCreateInfo CacheCI{};
+  CacheCI.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  CacheCI.initialDataSize = Seed.size();
+  CacheCI.pInitialData = Seed.empty() ? nullptr : Seed.data();
+
+  if(vkCreatePipelineCache(Context->Device, &CacheCI, nullptr, &Cache) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create pipeline cache");
+  }
+}
+
+PipelineCache::~PipelineCache()
+{
+  vkDestroyPipelineCache(Context->Device, Cache, nullptr);
+}
+
+bool PipelineCache::Validate(const std::vector<char>& File) const
+{
+  if(File.size() < sizeof(FileHeader) + sizeof(VkPipelineCacheHeaderVersionOne))
+  {
+    return false;
+  }
+
+  FileHeader Header;
+  memcpy(&Header, File.data(), sizeof(Header));
+
+  if(Header.Magic != Magic || Header.DriverVersion != DevProps.driverVersion || Header.DataSize != File.size() - sizeof(FileHeader))
+  {
+    return false;
+  }
+
+  VkPipelineCacheHeaderVersionOne DriverHeader;
+  memcpy(&DriverHeader, File.data() + sizeof(FileHeader), sizeof(DriverHeader));
+
+  return DriverHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         DriverHeader.vendorID == DevProps.vendorID &&
+         DriverHeader.deviceID == DevProps.deviceID &&
+         memcmp(DriverHeader.pipelineCacheUUID, DevProps.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::Save()
+{
+  size_t DataSize = 0;
+  vkGetPipelineCacheData(Context->Device, Cache, &DataSize, nullptr);
+
+  std::vector<char> Contents(sizeof(FileHeader) + DataSize);
+  if(vkGetPipelineCacheData(Context->Device, Cache, &DataSize, Contents.data() + sizeof(FileHeader)) != VK_SUCCESS)
+  {
+    std::cout << "Failed to read back pipeline cache, not saving\n";
+    return;
+  }
+
+  FileHeader Header{Magic, DevProps.driverVersion, DataSize};
+  memcpy(Contents.data(), &Header, sizeof(Header));
+
+  std::string TempPath = Path + ".tmp";
+
+  {
+    std::ofstream File(TempPath, std::ios::binary | std::ios::trunc);
+    File.write(Contents.data(), sizeof(FileHeader) + DataSize);
+
+    if(!File.good())
+    {
+      std::cout << "Failed to write pipeline cache " << TempPath << '\n';
+      return;
+    }
+  }
+
+  if(std::rename(TempPath.c_str(), Path.c_str()) != 0)
+  {
+    std::cout << "Failed to replace pipeline cache " << Path << '\n';
+    std::remove(TempPath.c_str());
+  }
+}
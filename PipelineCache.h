@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Vulkan.h"
+
+// VkPipelineCache persisted between runs. The file is only trusted if it was written by the same driver on the same
+// device, anything else is thrown away and the cache starts cold.
+class PipelineCache
+{
+  public:
+  PipelineCache(const char* Path);
+  ~PipelineCache();
+
+  // The cache every pipeline compiles into, all of them on the render thread.
+  VkPipelineCache Get() const { return Cache; }
+
+  // Writes the cache next to Path, then renames over it so a crash never leaves a torn file.
+  void Save();
+
+  // true if the file was valid for this device and the cache started warm
+  bool Warm() const { return Loaded; }
+
+  private:
+  // written in front of the driver's blob, the driver's own header doesn't carry the driver version
+  struct FileHeader
+  {
+    uint32_t Magic;
+    uint32_t DriverVersion;
+    uint64_t DataSize;
+  };
+
+  static const uint32_t Magic = 0x43505854;   // "TXPC"
+
+  bool Validate(const std::vector<char>& File) const;
+
+  std::string Path;
+  VkPhysicalDeviceProperties DevProps;
+
+  VkPipelineCache Cache;
+  bool Loaded = false;
+};
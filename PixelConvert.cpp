@@ -0,0 +1,272 @@
+#include "PixelConvert.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXEL_CONVERT_X86
+#endif
+
+// Converts Width pixels and returns how many it did, the scalar loop finishes the rest of the row.
+typedef uint32_t (*RowKernel)(const uint8_t* Src, uint8_t* Dst, uint32_t Width, const PixelConversion& Op);
+
+static inline uint8_t MulAlpha(uint32_t Value, uint32_t Alpha)
+{
+  // round(Value * Alpha / 255) without a divide
+  uint32_t t = Value * Alpha + 128;
+  return (t + (t >> 8)) >> 8;
+}
+
+static void ConvertRowScalar(const uint8_t* Src, uint8_t* Dst, uint32_t First, uint32_t Width, const PixelConversion& Op)
+{
+  uint32_t TexelSize = Op.SourceTexelSize();
+
+  for(uint32_t x = First; x < Width; x++)
+  {
+    const uint8_t* Texel = Src + (size_t)x * TexelSize;
+    uint8_t Out[4];
+
+    for(uint32_t c = 0; c < 4; c++)
+    {
+      if(c >= Op.SourceChannels)
+      {
+        Out[c] = 255;
+      }
+      else if(Op.Source16)
+      {
+        uint16_t Wide;
+        memcpy(&Wide, Texel + c * 2, 2);
+        Out[c] = Wide >> 8;
+      }
+      else
+      {
+        Out[c] = Texel[c];
+      }
+    }
+
+    if(Op.SwapRB)
+    {
+      uint8_t Red = Out[0];
+      Out[0] = Out[2];
+      Out[2] = Red;
+    }
+
+    if(Op.Premultiply)
+    {
+      Out[0] = MulAlpha(Out[0], Out[3]);
+      Out[1] = MulAlpha(Out[1], Out[3]);
+      Out[2] = MulAlpha(Out[2], Out[3]);
+    }
+
+    // one 4 byte store per texel, Dst may be write-combined
+    memcpy(Dst + (size_t)x * 4, Out, 4);
+  }
+}
+
+static uint32_t ConvertRowNone(const uint8_t*, uint8_t*, uint32_t, const PixelConversion&)
+{
+  return 0;
+}
+
+#ifdef PIXEL_CONVERT_X86
+
+// Both kernels build four or eight RGBA8 texels in a register and store them once. pshufb works within 128 bit lanes,
+// so the AVX2 kernel loads RGB into each lane separately and every mask is the SSE one repeated.
+
+__attribute__((target("sse4.1")))
+static uint32_t ConvertRowSSE41(const uint8_t* Src, uint8_t* Dst, uint32_t Width, const PixelConversion& Op)
+{
+  // 16 bit RGB is rare enough to leave to the scalar loop
+  if(Op.Source16 && Op.SourceChannels != 4)
+  {
+    return 0;
+  }
+
+  const __m128i ExpandRGB = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i SwapRB = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  const __m128i AlphaLo = _mm_setr_epi8(3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+  const __m128i AlphaHi = _mm_setr_epi8(11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+  const __m128i AlphaMask = _mm_set1_epi32((int)0xFF000000);
+  const __m128i Round = _mm_set1_epi16(128);
+  const __m128i Zero = _mm_setzero_si128();
+
+  // RGB loads 16 bytes for 12, stop while the over-read is still inside the row
+  uint32_t Stop = Op.SourceChannels == 3 ? 6 : 4;
+  uint32_t x = 0;
+
+  for(; x + Stop <= Width; x += 4)
+  {
+    __m128i Px;
+
+    if(Op.Source16)
+    {
+      __m128i Lo = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(Src + (size_t)x * 8)), 8);
+      __m128i Hi = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(Src + (size_t)x * 8 + 16)), 8);
+      Px = _mm_packus_epi16(Lo, Hi);
+    }
+    else if(Op.SourceChannels == 3)
+    {
+      Px = _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(Src + (size_t)x * 3)), ExpandRGB), AlphaMask);
+    }
+    else
+    {
+      Px = _mm_loadu_si128((const __m128i*)(Src + (size_t)x * 4));
+    }
+
+    if(Op.SwapRB)
+    {
+      Px = _mm_shuffle_epi8(Px, SwapRB);
+    }
+
+    if(Op.Premultiply)
+    {
+      __m128i Lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(Px, Zero), _mm_shuffle_epi8(Px, AlphaLo)), Round);
+      __m128i Hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(Px, Zero), _mm_shuffle_epi8(Px, AlphaHi)), Round);
+      Lo = _mm_srli_epi16(_mm_add_epi16(Lo, _mm_srli_epi16(Lo, 8)), 8);
+      Hi = _mm_srli_epi16(_mm_add_epi16(Hi, _mm_srli_epi16(Hi, 8)), 8);
+
+      // alpha itself stays as it was
+      Px = _mm_blendv_epi8(_mm_packus_epi16(Lo, Hi), Px, AlphaMask);
+    }
+
+    _mm_storeu_si128((__m128i*)(Dst + (size_t)x * 4), Px);
+  }
+
+  return x;
+}
+
+__attribute__((target("avx2")))
+static uint32_t ConvertRowAVX2(const uint8_t* Src, uint8_t* Dst, uint32_t Width, const PixelConversion& Op)
+{
+  if(Op.Source16 && Op.SourceChannels != 4)
+  {
+    return 0;
+  }
+
+  const __m256i ExpandRGB = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                             0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m256i SwapRB = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                          2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  const __m256i AlphaLo = _mm256_setr_epi8(3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1,
+                                           3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+  const __m256i AlphaHi = _mm256_setr_epi8(11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1,
+                                           11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+  const __m256i AlphaMask = _mm256_set1_epi32((int)0xFF000000);
+  const __m256i Round = _mm256_set1_epi16(128);
+  const __m256i Zero = _mm256_setzero_si256();
+
+  // the upper lane's RGB load starts 12 bytes in and reads 16, 28 of the 24 bytes eight texels take
+  uint32_t Stop = Op.SourceChannels == 3 ? 10 : 8;
+  uint32_t x = 0;
+
+  for(; x + Stop <= Width; x += 8)
+  {
+    __m256i Px;
+
+    if(Op.Source16)
+    {
+      __m256i Lo = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(Src + (size_t)x * 8)), 8);
+      __m256i Hi = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(Src + (size_t)x * 8 + 32)), 8);
+      // packus interleaves the lanes, put the texels back in order
+      Px = _mm256_permute4x64_epi64(_mm256_packus_epi16(Lo, Hi), _MM_SHUFFLE(3, 1, 2, 0));
+    }
+    else if(Op.SourceChannels == 3)
+    {
+      const uint8_t* Texel = Src + (size_t)x * 3;
+      __m256i Packed = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)Texel)),
+                                               _mm_loadu_si128((const __m128i*)(Texel + 12)), 1);
+      Px = _mm256_or_si256(_mm256_shuffle_epi8(Packed, ExpandRGB), AlphaMask);
+    }
+    else
+    {
+      Px = _mm256_loadu_si256((const __m256i*)(Src + (size_t)x * 4));
+    }
+
+    if(Op.SwapRB)
+    {
+      Px = _mm256_shuffle_epi8(Px, SwapRB);
+    }
+
+    if(Op.Premultiply)
+    {
+      __m256i Lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(Px, Zero), _mm256_shuffle_epi8(Px, AlphaLo)), Round);
+      __m256i Hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(Px, Zero), _mm256_shuffle_epi8(Px, AlphaHi)), Round);
+      Lo = _mm256_srli_epi16(_mm256_add_epi16(Lo, _mm256_srli_epi16(Lo, 8)), 8);
+      Hi = _mm256_srli_epi16(_mm256_add_epi16(Hi, _mm256_srli_epi16(Hi, 8)), 8);
+
+      // unpack and pack both stay within lanes, so the order comes back out right
+      Px = _mm256_blendv_epi8(_mm256_packus_epi16(Lo, Hi), Px, AlphaMask);
+    }
+
+    _mm256_storeu_si256((__m256i*)(Dst + (size_t)x * 4), Px);
+  }
+
+  return x;
+}
+
+#endif
+
+struct Kernel
+{
+  RowKernel Row;
+  const char* Name;
+};
+
+static Kernel SelectKernel()
+{
+#ifdef PIXEL_CONVERT_X86
+  __builtin_cpu_init();
+
+  if(__builtin_cpu_supports("avx2"))
+  {
+    return Kernel{ConvertRowAVX2, "avx2"};
+  }
+
+  if(__builtin_cpu_supports("sse4.1"))
+  {
+    return Kernel{ConvertRowSSE41, "sse4.1"};
+  }
+#endif
+
+  return Kernel{ConvertRowNone, "scalar"};
+}
+
+static const Kernel& ActiveKernel()
+{
+  static const Kernel Selected = SelectKernel();
+  return Selected;
+}
+
+void ConvertPixels(const void* Src, uint64_t SrcPitch, void* Dst, uint64_t DstPitch, uint32_t Width, uint32_t Height, const PixelConversion& Op)
+{
+  const uint8_t* SrcRow = static_cast<const uint8_t*>(Src);
+  uint8_t* DstRow = static_cast<uint8_t*>(Dst);
+
+  if(Op.IsCopy() && SrcPitch == DstPitch && SrcPitch == (uint64_t)Width * 4)
+  {
+    memcpy(DstRow, SrcRow, DstPitch * Height);
+    return;
+  }
+
+  RowKernel Row = ActiveKernel().Row;
+
+  for(uint32_t y = 0; y < Height; y++)
+  {
+    if(Op.IsCopy())
+    {
+      memcpy(DstRow, SrcRow, (size_t)Width * 4);
+    }
+    else
+    {
+      ConvertRowScalar(SrcRow, DstRow, Row(SrcRow, DstRow, Width, Op), Width, Op);
+    }
+
+    SrcRow += SrcPitch;
+    DstRow += DstPitch;
+  }
+}
+
+const char* PixelKernelName()
+{
+  return ActiveKernel().Name;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+// What the decoded pixels look like and what to do to them on the way to RGBA8.
+struct PixelConversion
+{
+  uint32_t SourceChannels = 4;   // 3 (RGB) or 4 (RGBA), RGB gets an opaque alpha
+  bool Source16 = false;         // 16 bits per channel, narrowed to 8 by dropping the low byte like stb does
+  bool SwapRB = false;           // BGRA <-> RGBA
+  bool Premultiply = false;      // color *= alpha, rounded
+
+  uint32_t SourceTexelSize() const { return SourceChannels * (Source16 ? 2 : 1); }
+  bool IsCopy() const { return SourceChannels == 4 && !Source16 && !SwapRB && !Premultiply; }
+};
+
+// Converts Height rows of Width pixels into tightly packed RGBA8 rows DstPitch bytes apart. Each output byte is written
+// exactly once and nothing is read back, so Dst can be write-combined staging memory.
+// Runs the widest kernel the CPU has (AVX2, SSE4.1 or scalar), picked on first use.
+void ConvertPixels(const void* Src, uint64_t SrcPitch, void* Dst, uint64_t DstPitch, uint32_t Width, uint32_t Height, const PixelConversion& Op);
+
+// "avx2", "sse4.1" or "scalar"
+const char* PixelKernelName();
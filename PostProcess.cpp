@@ -0,0 +1,604 @@
+#include "PostProcess.h"
+#include "PipelineCache.h"
+#include "EmbeddedShaders.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <glm/gtc/packing.hpp>
+
+// matches local_size in post_comp.glsl
+static const uint32_t GroupSize = 8;
+
+// the swap format would clip the scene to [0, 1] and band it before exposure and the curve get to it
+static const VkFormat SceneFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+static VkSampler CreateClampSampler(VkFilter Filter)
+{
+  VkSamplerCreateInfo SamplerCI{};
+  SamplerCI.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  SamplerCI.minFilter = Filter;
+  SamplerCI.magFilter = Filter;
+  SamplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+  SamplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  SamplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  SamplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+  SamplerCI.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+  SamplerCI.compareOp = VK_COMPARE_OP_ALWAYS;
+  SamplerCI.maxLod = 0.f;
+
+  VkSampler Sampler;
+  if(vkCreateSampler(Context->Device, &SamplerCI, nullptr, &Sampler) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create post processing sampler");
+  }
+
+  return Sampler;
+}
+
+static void CreateView(Image& Target, VkImageViewType Type)
+{
+  VkImageViewCreateInfo ViewCI{};
+  ViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  ViewCI.image = Target.Image;
+  ViewCI.format = Target.ImageFormat;
+  ViewCI.viewType = Type;
+
+  ViewCI.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+  ViewCI.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+  ViewCI.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+  ViewCI.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+  ViewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  ViewCI.subresourceRange.baseMipLevel = 0;
+  ViewCI.subresourceRange.levelCount = 1;
+  ViewCI.subresourceRange.baseArrayLayer = 0;
+  ViewCI.subresourceRange.layerCount = 1;
+
+  if(vkCreateImageView(Context->Device, &ViewCI, nullptr, &Target.ImageView) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create image view");
+  }
+}
+
+bool LoadCubeLut(const std::string& Path, std::vector<float>& Entries, uint32_t& Size, std::string& Error)
+{
+  std::ifstream File(Path);
+
+  if(!File.is_open())
+  {
+    Error = "Failed to open " + Path;
+    return false;
+  }
+
+  Size = 0;
+  Entries.clear();
+
+  std::string Line;
+  while(std::getline(File, Line))
+  {
+    if(Line.empty() || Line[0] == '#')
+    {
+      continue;
+    }
+
+    std::istringstream Words(Line);
+
+    // data lines are three numbers, keywords we don't need (TITLE, DOMAIN_MIN/MAX, LUT_1D_SIZE) are skipped
+    if(!std::isalpha((unsigned char)Line[0]))
+    {
+      float R, G, B;
+      if(Words >> R >> G >> B)
+      {
+        Entries.push_back(R);
+        Entries.push_back(G);
+        Entries.push_back(B);
+      }
+      continue;
+    }
+
+    std::string Keyword;
+    Words >> Keyword;
+
+    if(Keyword == "LUT_3D_SIZE")
+    {
+      Words >> Size;
+    }
+  }
+
+  if(Size < 2 || Size > 256)
+  {
+    Error = Path + " has no usable LUT_3D_SIZE";
+    return false;
+  }
+
+  if(Entries.size() != size_t(Size) * Size * Size * 3)
+  {
+    Error = Path + " doesn't have LUT_3D_SIZE^3 entries";
+    return false;
+  }
+
+  return true;
+}
+
+PostProcessor::PostProcessor(const PostSettings& Settings)
+{
+  // the output is copied into the swap image, rendering to it directly would put the kernel back on the graphics queue
+  if(!Context->Headless)
+  {
+    VkSurfaceCapabilitiesKHR SurfaceCap;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Context->PhysicalDevice, Context->RenderSurface, &SurfaceCap);
+
+    if(!(SurfaceCap.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+    {
+      throw std::runtime_error("Post processing needs swapchain images that can be copied to");
+    }
+  }
+
+  // storage formats can't be sRGB, the kernel encodes and orders the bytes itself and the copy moves them as they are
+  switch(Context->SwapImages[0].ImageFormat)
+  {
+    case VK_FORMAT_B8G8R8A8_SRGB: Push.Flags = EncodeSrgbBit | SwapRedBlueBit; break;
+    case VK_FORMAT_B8G8R8A8_UNORM: Push.Flags = SwapRedBlueBit; break;
+    case VK_FORMAT_R8G8B8A8_SRGB: Push.Flags = EncodeSrgbBit; break;
+    case VK_FORMAT_R8G8B8A8_UNORM: Push.Flags = 0; break;
+    default: throw std::runtime_error("Post processing only handles 8 bit RGBA/BGRA swap formats");
+  }
+
+  Push.Exposure = Settings.Exposure;
+  Push.Sharpen = std::max(0.f, Settings.Sharpen);
+
+  if(Settings.ToneMap)
+  {
+    Push.Flags |= ToneMapBit;
+  }
+
+  if(!Settings.LutPath.empty())
+  {
+    Push.Flags |= LutBit;
+  }
+
+  // Command pools
+    VkCommandPoolCreateInfo PoolCI{};
+    PoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    PoolCI.queueFamilyIndex = Context->ComputeFamily;
+
+    if(vkCreateCommandPool(Context->Device, &PoolCI, nullptr, &ComputePool) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create a command pool");
+    }
+
+    PoolCI.queueFamilyIndex = Context->GraphicsFamily;
+
+    if(vkCreateCommandPool(Context->Device, &PoolCI, nullptr, &CopyPool) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create a command pool");
+    }
+  // Command pools
+
+  // texelFetch ignores the filter, the LUT is interpolated between its entries
+  SceneSampler = CreateClampSampler(VK_FILTER_NEAREST);
+  LutSampler = CreateClampSampler(VK_FILTER_LINEAR);
+
+  CreatePipeline();
+  CreateLut(Settings.LutPath);
+  CreateTargets();
+}
+
+PostProcessor::~PostProcessor()
+{
+  DestroyTargets();
+
+  DestroyImage(Lut);
+  vkDestroySampler(Context->Device, SceneSampler, nullptr);
+  vkDestroySampler(Context->Device, LutSampler, nullptr);
+
+  vkDestroyPipeline(Context->Device, Pipeline, nullptr);
+  vkDestroyPipelineLayout(Context->Device, Layout, nullptr);
+  vkDestroyDescriptorSetLayout(Context->Device, SetLayout, nullptr);
+
+  vkDestroyCommandPool(Context->Device, ComputePool, nullptr);
+  vkDestroyCommandPool(Context->Device, CopyPool, nullptr);
+}
+
+void PostProcessor::CreatePipeline()
+{
+  // Descriptors
+    VkDescriptorSetLayoutBinding Bindings[3]{};
+    Bindings[0] = { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    Bindings[1] = { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    Bindings[2] = { 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+    VkDescriptorSetLayoutCreateInfo SetLayoutCI{};
+    SetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    SetLayoutCI.bindingCount = 3;
+    SetLayoutCI.pBindings = Bindings;
+
+    if(vkCreateDescriptorSetLayout(Context->Device, &SetLayoutCI, nullptr, &SetLayout) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create post processing set layout");
+    }
+  // Descriptors
+
+  // Layout
+    VkPushConstantRange PushRange{};
+    PushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    PushRange.offset = 0;
+    PushRange.size = sizeof(Constants);
+
+    VkPipelineLayoutCreateInfo PipeLayoutInfo{};
+    PipeLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    PipeLayoutInfo.setLayoutCount = 1;
+    PipeLayoutInfo.pSetLayouts = &SetLayout;
+    PipeLayoutInfo.pushConstantRangeCount = 1;
+    PipeLayoutInfo.pPushConstantRanges = &PushRange;
+
+    if(vkCreatePipelineLayout(Context->Device, &PipeLayoutInfo, nullptr, &Layout) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create post processing pipeline layout");
+    }
+  // Layout
+
+  VkShaderModule Comp = CreateShaderModule(PostCompSpirv, sizeof(PostCompSpirv));
+
+  VkComputePipelineCreateInfo ComputePipe{};
+  ComputePipe.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  ComputePipe.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  ComputePipe.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  ComputePipe.stage.module = Comp;
+  ComputePipe.stage.pName = "main";
+  ComputePipe.layout = Layout;
+
+  VkResult Err = vkCreateComputePipelines(Context->Device, Context->Pipelines->Get(), 1, &ComputePipe, nullptr, &Pipeline);
+
+  vkDestroyShaderModule(Context->Device, Comp, nullptr);
+
+  if(Err != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create post processing pipeline");
+  }
+}
+
+void PostProcessor::CreateLut(const std::string& Path)
+{
+  // an identity LUT stands in when there's no grading, the binding always needs an image
+  std::vector<float> Entries = { 0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0, 1, 0, 1, 1, 1, 1, 1 };
+  uint32_t Size = 2;
+
+  if(!Path.empty())
+  {
+    std::string Error;
+    if(!LoadCubeLut(Path, Entries, Size, Error))
+    {
+      throw std::runtime_error(Error);
+    }
+  }
+
+  // half floats, 8 bits per channel bands visibly once the grade stretches a range
+  VkDeviceSize Bytes = VkDeviceSize(Size) * Size * Size * 4 * sizeof(uint16_t);
+  Buffer Staging = CreateStagingBuffer(Bytes);
+
+  uint16_t* Texels = static_cast<uint16_t*>(Staging.Memory.Mapped);
+  for(size_t e = 0; e < Entries.size() / 3; e++)
+  {
+    Texels[e * 4 + 0] = glm::packHalf1x16(Entries[e * 3 + 0]);
+    Texels[e * 4 + 1] = glm::packHalf1x16(Entries[e * 3 + 1]);
+    Texels[e * 4 + 2] = glm::packHalf1x16(Entries[e * 3 + 2]);
+    Texels[e * 4 + 3] = glm::packHalf1x16(1.f);
+  }
+
+  Context->Allocator->Flush(Staging.Memory, 0, Bytes);
+
+  // Image
+    // CreateImage only makes 2D images, a real 3D one gets trilinear filtering from the sampler
+    VkImageCreateInfo ImageCI{};
+    ImageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    ImageCI.extent = VkExtent3D{Size, Size, Size};
+    ImageCI.arrayLayers = 1;
+    ImageCI.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    ImageCI.imageType = VK_IMAGE_TYPE_3D;
+    ImageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    ImageCI.mipLevels = 1;
+    ImageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+    ImageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    ImageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+    ImageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    if(vkCreateImage(Context->Device, &ImageCI, nullptr, &Lut.Image) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create LUT image");
+    }
+
+    VkMemoryRequirements MemReq;
+    vkGetImageMemoryRequirements(Context->Device, Lut.Image, &MemReq);
+
+    Lut.Memory = Context->Allocator->Allocate(MemReq, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, false);
+    vkBindImageMemory(Context->Device, Lut.Image, Lut.Memory.Memory, Lut.Memory.Offset);
+
+    Lut.ImageFormat = ImageCI.format;
+    Lut.CurrentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    Lut.MipLevels = 1;
+    Lut.Extent = ImageCI.extent;
+
+    CreateView(Lut, VK_IMAGE_VIEW_TYPE_3D);
+  // Image
+
+  // Upload
+    // copied on the compute queue itself, it's the only queue that ever reads it so no ownership changes hands
+    VkCommandBufferAllocateInfo CmdAllocInfo{};
+    CmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    CmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    CmdAllocInfo.commandPool = ComputePool;
+    CmdAllocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer Cmd;
+    if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, &Cmd) != VK_SUCCESS)
+    {
+      throw std::runtime_error("failed to create command buffers");
+    }
+
+    VkCommandBufferBeginInfo BeginInf{};
+    BeginInf.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    BeginInf.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VkImageMemoryBarrier Barrier{};
+    Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.image = Lut.Image;
+    Barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.srcAccessMask = 0;
+    Barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    VkBufferImageCopy Region{};
+    Region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    Region.imageExtent = Lut.Extent;
+
+    vkBeginCommandBuffer(Cmd, &BeginInf);
+      vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+      vkCmdCopyBufferToImage(Cmd, Staging.Buffer, Lut.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Region);
+
+      Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+      vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+    vkEndCommandBuffer(Cmd);
+
+    // once at startup, a few hundred KB at most
+    Context->Sync->Wait(Context->Sync->Submit(QueueKind::Compute, Cmd));
+
+    vkFreeCommandBuffers(Context->Device, ComputePool, 1, &Cmd);
+    DestroyBuffer(Staging);
+  // Upload
+}
+
+void PostProcessor::CreateTargets()
+{
+  uint32_t Count = Context->SwapImages.size();
+  Targets.resize(Count);
+
+  // Descriptors
+    VkDescriptorPoolSize PoolSizes[2]{};
+    PoolSizes[0] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * Count };
+    PoolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, Count };
+
+    VkDescriptorPoolCreateInfo PoolCI{};
+    PoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    PoolCI.maxSets = Count;
+    PoolCI.poolSizeCount = 2;
+    PoolCI.pPoolSizes = PoolSizes;
+
+    if(vkCreateDescriptorPool(Context->Device, &PoolCI, nullptr, &DescriptorPool) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create post processing descriptor pool");
+    }
+
+    std::vector<VkDescriptorSetLayout> Layouts(Count, SetLayout);
+    std::vector<VkDescriptorSet> Sets(Count);
+
+    VkDescriptorSetAllocateInfo SetAllocInfo{};
+    SetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    SetAllocInfo.descriptorPool = DescriptorPool;
+    SetAllocInfo.descriptorSetCount = Count;
+    SetAllocInfo.pSetLayouts = Layouts.data();
+
+    if(vkAllocateDescriptorSets(Context->Device, &SetAllocInfo, Sets.data()) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to allocate post processing descriptor sets");
+    }
+  // Descriptors
+
+  // Command buffers
+    std::vector<VkCommandBuffer> Kernels(Count);
+    std::vector<VkCommandBuffer> Copies(Count);
+
+    VkCommandBufferAllocateInfo CmdAllocInfo{};
+    CmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    CmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    CmdAllocInfo.commandPool = ComputePool;
+    CmdAllocInfo.commandBufferCount = Count;
+
+    if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, Kernels.data()) != VK_SUCCESS)
+    {
+      throw std::runtime_error("failed to create command buffers");
+    }
+
+    CmdAllocInfo.commandPool = CopyPool;
+
+    if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, Copies.data()) != VK_SUCCESS)
+    {
+      throw std::runtime_error("failed to create command buffers");
+    }
+  // Command buffers
+
+  for(uint32_t i = 0; i < Count; i++)
+  {
+    Target& Frame = Targets[i];
+    Frame.Set = Sets[i];
+    Frame.Kernel = Kernels[i];
+    Frame.Copy = Copies[i];
+
+    // shared by both families, written by one queue and read by the other every frame
+    Frame.Scene = CreateImage(SceneFormat, Context->Extent,
+                              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1, true);
+    CreateView(Frame.Scene, VK_IMAGE_VIEW_TYPE_2D);
+
+    Frame.Output = CreateImage(VK_FORMAT_R8G8B8A8_UNORM, Context->Extent, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 1, true);
+    CreateView(Frame.Output, VK_IMAGE_VIEW_TYPE_2D);
+
+    VkDescriptorImageInfo SceneInfo{};
+    SceneInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    SceneInfo.imageView = Frame.Scene.ImageView;
+    SceneInfo.sampler = SceneSampler;
+
+    VkDescriptorImageInfo LutInfo{};
+    LutInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    LutInfo.imageView = Lut.ImageView;
+    LutInfo.sampler = LutSampler;
+
+    VkDescriptorImageInfo OutputInfo{};
+    OutputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    OutputInfo.imageView = Frame.Output.ImageView;
+
+    VkWriteDescriptorSet Writes[3]{};
+
+    for(uint32_t w = 0; w < 3; w++)
+    {
+      Writes[w].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      Writes[w].dstSet = Frame.Set;
+      Writes[w].dstBinding = w;
+      Writes[w].descriptorCount = 1;
+      Writes[w].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    }
+
+    Writes[0].pImageInfo = &SceneInfo;
+    Writes[1].pImageInfo = &LutInfo;
+    Writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    Writes[2].pImageInfo = &OutputInfo;
+
+    vkUpdateDescriptorSets(Context->Device, 3, Writes, 0, nullptr);
+
+    RecordKernel(Frame);
+    RecordCopy(Frame, i);
+  }
+}
+
+void PostProcessor::DestroyTargets()
+{
+  for(Target& Frame : Targets)
+  {
+    vkFreeCommandBuffers(Context->Device, ComputePool, 1, &Frame.Kernel);
+    vkFreeCommandBuffers(Context->Device, CopyPool, 1, &Frame.Copy);
+
+    DestroyImage(Frame.Scene);
+    DestroyImage(Frame.Output);
+  }
+
+  Targets.clear();
+
+  // the sets go with it
+  vkDestroyDescriptorPool(Context->Device, DescriptorPool, nullptr);
+  DescriptorPool = VK_NULL_HANDLE;
+}
+
+void PostProcessor::Resize()
+{
+  DestroyTargets();
+  CreateTargets();
+}
+
+void PostProcessor::RecordKernel(Target& Frame)
+{
+  // the copy out of last frame's output is ahead of the semaphore this waits on, so it can be discarded
+  VkImageMemoryBarrier OutputBarrier{};
+  OutputBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  OutputBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  OutputBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  OutputBarrier.image = Frame.Output.Image;
+  OutputBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+  OutputBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  OutputBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  OutputBarrier.srcAccessMask = 0;
+  OutputBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+  VkCommandBufferBeginInfo BeginInf{};
+  BeginInf.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+  vkBeginCommandBuffer(Frame.Kernel, &BeginInf);
+    vkCmdPipelineBarrier(Frame.Kernel, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &OutputBarrier);
+
+    vkCmdBindPipeline(Frame.Kernel, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline);
+    vkCmdBindDescriptorSets(Frame.Kernel, VK_PIPELINE_BIND_POINT_COMPUTE, Layout, 0, 1, &Frame.Set, 0, nullptr);
+    vkCmdPushConstants(Frame.Kernel, Layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Constants), &Push);
+
+    vkCmdDispatch(Frame.Kernel, (Context->Extent.width + GroupSize - 1) / GroupSize, (Context->Extent.height + GroupSize - 1) / GroupSize, 1);
+  vkEndCommandBuffer(Frame.Kernel);
+}
+
+void PostProcessor::RecordCopy(Target& Frame, uint32_t ImageIndex)
+{
+  const Image& Swap = Context->SwapImages[ImageIndex];
+
+  // TRANSFER is also where the acquire semaphore is waited on, the transition has to come after it
+  VkImageMemoryBarrier SwapBarrier{};
+  SwapBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  SwapBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  SwapBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  SwapBarrier.image = Swap.Image;
+  SwapBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+  SwapBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  SwapBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  SwapBarrier.srcAccessMask = 0;
+  SwapBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  // same size texels, the kernel already wrote them in the swap format's order and encoding
+  VkImageCopy Region{};
+  Region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+  Region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+  Region.extent = Context->Extent;
+
+  VkCommandBufferBeginInfo BeginInf{};
+  BeginInf.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+  vkBeginCommandBuffer(Frame.Copy, &BeginInf);
+    vkCmdPipelineBarrier(Frame.Copy, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &SwapBarrier);
+
+    vkCmdCopyImage(Frame.Copy, Frame.Output.Image, VK_IMAGE_LAYOUT_GENERAL, Swap.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Region);
+
+    // where the render pass would have left it, present or the headless readback
+    SwapBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    SwapBarrier.newLayout = Context->PresentLayout;
+    SwapBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    SwapBarrier.dstAccessMask = 0;
+
+    vkCmdPipelineBarrier(Frame.Copy, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &SwapBarrier);
+  vkEndCommandBuffer(Frame.Copy);
+}
+
+SyncPoint PostProcessor::Submit(uint32_t ImageIndex, VkCommandBuffer SceneCommands, const std::vector<SyncWait>& Waits, const BinarySync& Binary)
+{
+  Target& Frame = Targets[ImageIndex];
+
+  // doesn't touch the swap image, so it doesn't wait for the acquire either
+  SyncPoint SceneDone = Context->Sync->Submit(QueueKind::Graphics, SceneCommands, Waits);
+
+  // the graphics queue moves on to the next frame while this runs
+  SyncPoint KernelDone = Context->Sync->Submit(QueueKind::Compute, Frame.Kernel, { SyncWait{SceneDone, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT} });
+
+  // the copy is the first thing to write the swap image
+  BinarySync CopyBinary = Binary;
+  CopyBinary.WaitStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+  return Context->Sync->Submit(QueueKind::Graphics, Frame.Copy, { SyncWait{KernelDone, VK_PIPELINE_STAGE_TRANSFER_BIT} }, CopyBinary);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Vulkan.h"
+#include "Timeline.h"
+
+struct PostSettings
+{
+  float Exposure = 1.f;     // scales the linear color before the curve
+  bool ToneMap = true;      // filmic curve, highlights roll off instead of clipping
+  float Sharpen = 0.f;      // unsharp mask strength, 0 skips the neighbour reads
+  std::string LutPath;      // .cube color grading LUT, empty for none
+};
+
+// Image processing after the render pass, in one compute kernel: sharpen, exposure and tone mapping, a 3D LUT grade,
+// then conversion to the swap format's channel order and encoding.
+// Frames render into a half float scene image per swap image instead of the swap image, so exposure and tone mapping
+// see the whole range and only the kernel's output is in the swap format. The kernel runs on the compute queue,
+// which is an async compute family when the device has one, so it overlaps the graphics queue starting the next frame.
+// The compute submit waits for the scene's point on the graphics timeline, the copy into the swap image back on graphics
+// waits for the kernel's, and the copy's point covers all three. The scene and output images are shared between the families, nothing changes ownership.
+class PostProcessor
+{
+  public:
+  PostProcessor(const PostSettings& Settings);
+  // Destroy with the device idle.
+  ~PostProcessor();
+
+  // Swap images and extent change on recreation. Call with the device idle, before CreateFramebuffers, the frame
+  // graph's framebuffers are made from the scene images.
+  void Resize();
+
+  // What the frame graph's main pass renders to instead of the swap image, left in SHADER_READ_ONLY_OPTIMAL.
+  Image& Scene(uint32_t ImageIndex) { return Targets[ImageIndex].Scene; }
+
+  // Submits SceneCommands after Waits, the kernel and the copy into the swap image, which takes the acquire and present
+  // semaphores in Binary. Returns the copy's point, reached once all three are done.
+  SyncPoint Submit(uint32_t ImageIndex, VkCommandBuffer SceneCommands, const std::vector<SyncWait>& Waits, const BinarySync& Binary);
+
+  private:
+  // has to match post_comp.glsl
+  enum Flags : uint32_t
+  {
+    ToneMapBit = 1,
+    LutBit = 2,
+    EncodeSrgbBit = 4,
+    SwapRedBlueBit = 8
+  };
+
+  struct Constants
+  {
+    float Exposure;
+    float Sharpen;
+    uint32_t Flags;
+  };
+
+  struct Target
+  {
+    Image Scene;              // RGBA16F, rendered to and sampled
+    Image Output;             // RGBA8 storage, already in the swap format's byte order
+    VkDescriptorSet Set;
+    VkCommandBuffer Kernel;   // compute queue
+    VkCommandBuffer Copy;     // graphics queue
+  };
+
+  void CreatePipeline();
+  void CreateLut(const std::string& Path);
+  void CreateTargets();
+  void DestroyTargets();
+  void RecordKernel(Target& Frame);
+  void RecordCopy(Target& Frame, uint32_t ImageIndex);
+
+  Constants Push{};
+
+  VkDescriptorSetLayout SetLayout;
+  VkPipelineLayout Layout;
+  VkPipeline Pipeline;
+  VkDescriptorPool DescriptorPool = VK_NULL_HANDLE;
+
+  Image Lut;
+  VkSampler SceneSampler;
+  VkSampler LutSampler;
+
+  VkCommandPool ComputePool;
+  VkCommandPool CopyPool;
+
+  std::vector<Target> Targets;
+};
+
+// Reads an Adobe .cube 3D LUT into Size^3 RGB entries, red fastest. Returns false with Error set if it can't.
+bool LoadCubeLut(const std::string& Path, std::vector<float>& Entries, uint32_t& Size, std::string& Error);
@@ -0,0 +1,270 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+static const VkQueryPipelineStatisticFlags Statistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+                                                        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+GpuProfiler::GpuProfiler(uint32_t SlotCount, uint32_t Window) : Window(Window)
+{
+  VkPhysicalDeviceProperties DevProps;
+  vkGetPhysicalDeviceProperties(Context->PhysicalDevice, &DevProps);
+
+  uint32_t QueueFamilyCount;
+  vkGetPhysicalDeviceQueueFamilyProperties(Context->PhysicalDevice, &QueueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> QueueProps(QueueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(Context->PhysicalDevice, &QueueFamilyCount, QueueProps.data());
+
+  uint32_t ValidBits = QueueProps[Context->GraphicsFamily].timestampValidBits;
+
+  TimestampsSupported = ValidBits != 0;
+  StatisticsSupported = Context->Features.pipelineStatisticsQuery == VK_TRUE;
+  StatisticsInherited = StatisticsSupported && Context->Features.inheritedQueries == VK_TRUE;
+  Period = DevProps.limits.timestampPeriod;
+  TimestampMask = ValidBits >= 64 ? UINT64_MAX : (uint64_t(1) << ValidBits) - 1;
+
+  CreatePools(SlotCount);
+}
+
+GpuProfiler::~GpuProfiler()
+{
+  DestroyPools();
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::StatisticFlags() const
+{
+  return StatisticsInherited ? Statistics : 0;
+}
+
+void GpuProfiler::CreatePools(uint32_t SlotCount)
+{
+  TimestampPools.assign(SlotCount, VK_NULL_HANDLE);
+  StatisticsPools.assign(SlotCount, VK_NULL_HANDLE);
+  Submitted.assign(SlotCount, false);
+
+  for(uint32_t i = 0; i < SlotCount; i++)
+  {
+    if(TimestampsSupported)
+    {
+      VkQueryPoolCreateInfo PoolCI{};
+      PoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      PoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+      PoolCI.queryCount = MaxScopes * 2;
+
+      if(vkCreateQueryPool(Context->Device, &PoolCI, nullptr, &TimestampPools[i]) != VK_SUCCESS)
+      {
+        throw std::runtime_error("Failed to create timestamp query pool");
+      }
+    }
+
+    if(StatisticsSupported)
+    {
+      VkQueryPoolCreateInfo PoolCI{};
+      PoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      PoolCI.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+      PoolCI.queryCount = 1;
+      PoolCI.pipelineStatistics = Statistics;
+
+      if(vkCreateQueryPool(Context->Device, &PoolCI, nullptr, &StatisticsPools[i]) != VK_SUCCESS)
+      {
+        throw std::runtime_error("Failed to create pipeline statistics query pool");
+      }
+    }
+  }
+}
+
+void GpuProfiler::DestroyPools()
+{
+  for(uint32_t i = 0; i < TimestampPools.size(); i++)
+  {
+    if(TimestampPools[i] != VK_NULL_HANDLE)
+    {
+      vkDestroyQueryPool(Context->Device, TimestampPools[i], nullptr);
+    }
+
+    if(StatisticsPools[i] != VK_NULL_HANDLE)
+    {
+      vkDestroyQueryPool(Context->Device, StatisticsPools[i], nullptr);
+    }
+  }
+}
+
+void GpuProfiler::Resize(uint32_t SlotCount)
+{
+  DestroyPools();
+  CreatePools(SlotCount);
+}
+
+uint32_t GpuProfiler::Scope(const char* Name)
+{
+  for(uint32_t i = 0; i < Scopes.size(); i++)
+  {
+    if(Scopes[i].Name == Name)
+    {
+      return i;
+    }
+  }
+
+  if(Scopes.size() == MaxScopes)
+  {
+    throw std::runtime_error("Too many profiler scopes");
+  }
+
+  ScopeStats NewScope;
+  NewScope.Name = Name;
+  NewScope.Samples.resize(Window);
+  Scopes.push_back(NewScope);
+
+  return Scopes.size() - 1;
+}
+
+void GpuProfiler::Reset(VkCommandBuffer Cmd, uint32_t Slot)
+{
+  if(TimestampsSupported)
+  {
+    vkCmdResetQueryPool(Cmd, TimestampPools[Slot], 0, MaxScopes * 2);
+  }
+
+  if(StatisticsSupported)
+  {
+    vkCmdResetQueryPool(Cmd, StatisticsPools[Slot], 0, 1);
+  }
+}
+
+void GpuProfiler::BeginScope(VkCommandBuffer Cmd, uint32_t Slot, uint32_t ScopeId, VkPipelineStageFlagBits Stage)
+{
+  if(TimestampsSupported)
+  {
+    vkCmdWriteTimestamp(Cmd, Stage, TimestampPools[Slot], ScopeId * 2);
+  }
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer Cmd, uint32_t Slot, uint32_t ScopeId, VkPipelineStageFlagBits Stage)
+{
+  if(TimestampsSupported)
+  {
+    vkCmdWriteTimestamp(Cmd, Stage, TimestampPools[Slot], ScopeId * 2 + 1);
+  }
+}
+
+void GpuProfiler::BeginStatistics(VkCommandBuffer Cmd, uint32_t Slot, bool Secondaries)
+{
+  if(Secondaries ? StatisticsInherited : StatisticsSupported)
+  {
+    vkCmdBeginQuery(Cmd, StatisticsPools[Slot], 0, 0);
+  }
+}
+
+void GpuProfiler::EndStatistics(VkCommandBuffer Cmd, uint32_t Slot, bool Secondaries)
+{
+  if(Secondaries ? StatisticsInherited : StatisticsSupported)
+  {
+    vkCmdEndQuery(Cmd, StatisticsPools[Slot], 0);
+  }
+}
+
+void GpuProfiler::Collect(uint32_t Slot)
+{
+  // the queries are only reset inside the command buffer, nothing can be read before its first submission
+  if(!Submitted[Slot])
+  {
+    Submitted[Slot] = true;
+    return;
+  }
+
+  if(TimestampsSupported && !Scopes.empty())
+  {
+    // value, availability pairs. No WAIT bit, a scope that isn't ready is just skipped this frame
+    uint64_t Results[MaxScopes * 2][2];
+    uint32_t QueryCount = Scopes.size() * 2;
+
+    VkResult Err = vkGetQueryPoolResults(Context->Device, TimestampPools[Slot], 0, QueryCount, sizeof(Results), Results, sizeof(Results[0]),
+                                         VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    if(Err == VK_SUCCESS || Err == VK_NOT_READY)
+    {
+      for(uint32_t i = 0; i < Scopes.size(); i++)
+      {
+        if(Results[i * 2][1] == 0 || Results[i * 2 + 1][1] == 0)
+        {
+          continue;
+        }
+
+        uint64_t Ticks = ((Results[i * 2 + 1][0] - Results[i * 2][0]) & TimestampMask);
+
+        ScopeStats& Target = Scopes[i];
+        Target.Samples[Target.Next] = Ticks * Period / 1e6;
+        Target.Next = (Target.Next + 1) % Window;
+        Target.Count++;
+      }
+    }
+  }
+
+  if(StatisticsSupported)
+  {
+    uint64_t Results[StatisticCount + 1];
+
+    VkResult Err = vkGetQueryPoolResults(Context->Device, StatisticsPools[Slot], 0, 1, sizeof(Results), Results, sizeof(Results),
+                                         VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    if(Err == VK_SUCCESS && Results[StatisticCount] != 0)
+    {
+      for(uint32_t i = 0; i < StatisticCount; i++)
+      {
+        StatisticTotals[i] += Results[i];
+      }
+      StatisticFrames++;
+    }
+  }
+}
+
+void GpuProfiler::Print(std::ostream& Out) const
+{
+  if(!TimestampsSupported)
+  {
+    Out << "GPU timestamps not supported on the graphics queue\n";
+    return;
+  }
+
+  Out << std::fixed << std::setprecision(3);
+  Out << "GPU time (ms)            min      avg      p99   samples\n";
+
+  for(const ScopeStats& Scope : Scopes)
+  {
+    uint32_t Filled = std::min<uint64_t>(Scope.Count, Window);
+    if(Filled == 0)
+    {
+      continue;
+    }
+
+    std::vector<double> Sorted(Scope.Samples.begin(), Scope.Samples.begin() + Filled);
+    std::sort(Sorted.begin(), Sorted.end());
+
+    double Sum = 0.0;
+    for(double Sample : Sorted)
+    {
+      Sum += Sample;
+    }
+
+    uint32_t P99 = std::min<uint32_t>(Filled - 1, Filled * 99 / 100);
+
+    Out << "  " << Scope.Name << std::string(Scope.Name.size() < 20 ? 20 - Scope.Name.size() : 1, ' ')
+        << Sorted.front() << "  " << Sum / Filled << "  " << Sorted[P99] << "  " << Scope.Count << '\n';
+  }
+
+  if(StatisticFrames > 0)
+  {
+    // same order as the bits, which is the order the results come back in
+    const char* Names[StatisticCount] = { "vertices", "vertex invocations", "clipping primitives", "fragment invocations" };
+
+    Out << "Pipeline statistics (per frame)\n";
+    for(uint32_t i = 0; i < StatisticCount; i++)
+    {
+      Out << "  " << Names[i] << ": " << StatisticTotals[i] / StatisticFrames << '\n';
+    }
+  }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Vulkan.h"
+
+// GPU timings from timestamp queries written into the recorded command buffers.
+// Each command buffer (slot) gets its own query pool, a slot's results are read right before it is resubmitted,
+// by which point the frame scheduler has already waited for its previous submission, so reading never stalls.
+class GpuProfiler
+{
+  public:
+  // Window is how many frames the rolling statistics cover.
+  GpuProfiler(uint32_t SlotCount, uint32_t Window = 1024);
+  ~GpuProfiler();
+
+  // Slot count follows the recorded command buffers, which change with the swapchain.
+  void Resize(uint32_t SlotCount);
+
+  // Returns the id for Name, registering it the first time. Scopes must be registered before recording.
+  uint32_t Scope(const char* Name);
+
+  // Recorded once at the start of a slot's command buffer, outside any render pass.
+  void Reset(VkCommandBuffer Cmd, uint32_t Slot);
+
+  void BeginScope(VkCommandBuffer Cmd, uint32_t Slot, uint32_t ScopeId, VkPipelineStageFlagBits Stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+  void EndScope(VkCommandBuffer Cmd, uint32_t Slot, uint32_t ScopeId, VkPipelineStageFlagBits Stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+  // Pipeline statistics around a draw, no-ops when the device doesn't support them.
+  // Around secondaries they also need inherited queries, without them those frames go uncounted.
+  void BeginStatistics(VkCommandBuffer Cmd, uint32_t Slot, bool Secondaries = false);
+  void EndStatistics(VkCommandBuffer Cmd, uint32_t Slot, bool Secondaries = false);
+
+  // What the statistics query counts, secondary command buffers executed inside it must inherit these.
+  // 0 when the device can't inherit queries, the query is never active around secondaries then.
+  VkQueryPipelineStatisticFlags StatisticFlags() const;
+
+  // Reads Slot's results from its last submission into the rolling statistics.
+  // Call once the slot's previous submission has completed and right before it is submitted again.
+  void Collect(uint32_t Slot);
+
+  // min/avg/p99 per scope in ms, and average pipeline statistics per frame
+  void Print(std::ostream& Out) const;
+
+  bool Supported() const { return TimestampsSupported; }
+
+  private:
+  struct ScopeStats
+  {
+    std::string Name;
+    std::vector<double> Samples;   // ring of Window ms values
+    uint32_t Next = 0;
+    uint64_t Count = 0;
+  };
+
+  static const uint32_t MaxScopes = 16;
+  static const uint32_t StatisticCount = 4;
+
+  void CreatePools(uint32_t SlotCount);
+  void DestroyPools();
+
+  std::vector<VkQueryPool> TimestampPools;
+  std::vector<VkQueryPool> StatisticsPools;
+  std::vector<bool> Submitted;            // slot has results coming from a submission
+
+  std::vector<ScopeStats> Scopes;
+  uint32_t Window;
+
+  bool TimestampsSupported;
+  bool StatisticsSupported;
+  bool StatisticsInherited;
+  double Period;                          // ns per tick
+  uint64_t TimestampMask;
+
+  uint64_t StatisticTotals[StatisticCount] = {};
+  uint64_t StatisticFrames = 0;
+};
@@ -0,0 +1,283 @@
+#include "QuadBatch.h"
+#include "PipelineCache.h"
+#include "EmbeddedShaders.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+QuadBatch::QuadBatch(uint32_t Capacity, VkDescriptorSetLayout TextureLayout) : Capacity(Capacity)
+{
+  CreatePipeline(TextureLayout);
+
+  // the corners come from gl_VertexIndex, the only per-vertex data is the index list
+  uint16_t QuadIndices[6] = { 0, 1, 2, 2, 3, 0 };
+
+  Indices = CreateHostBuffer(sizeof(QuadIndices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  memcpy(Indices.Memory.Mapped, QuadIndices, sizeof(QuadIndices));
+  Context->Allocator->Flush(Indices.Memory, 0, sizeof(QuadIndices));
+
+  CreateInstanceBuffers(Context->SwapImages.size());
+}
+
+QuadBatch::~QuadBatch()
+{
+  DestroyInstanceBuffers();
+  DestroyBuffer(Indices);
+
+  vkDestroyPipeline(Context->Device, Pipeline, nullptr);
+  vkDestroyPipelineLayout(Context->Device, Layout, nullptr);
+}
+
+void QuadBatch::CreateInstanceBuffers(uint32_t ImageCount)
+{
+  Instances.resize(ImageCount);
+
+  for(Buffer& Target : Instances)
+  {
+    Target = CreateHostBuffer(InstanceOffset + VkDeviceSize(Capacity) * sizeof(Quad), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+    // nothing drawn until the first End()
+    VkDrawIndexedIndirectCommand Empty{};
+    memcpy(Target.Memory.Mapped, &Empty, sizeof(Empty));
+    Context->Allocator->Flush(Target.Memory, 0, sizeof(Empty));
+  }
+}
+
+void QuadBatch::DestroyInstanceBuffers()
+{
+  for(Buffer& Target : Instances)
+  {
+    DestroyBuffer(Target);
+  }
+
+  Instances.clear();
+}
+
+void QuadBatch::Resize(uint32_t ImageCount)
+{
+  DestroyInstanceBuffers();
+  CreateInstanceBuffers(ImageCount);
+}
+
+void QuadBatch::Begin(uint32_t ImageIndex)
+{
+  CurrentImage = ImageIndex;
+  QuadCount = 0;
+  Mapped = reinterpret_cast<Quad*>(static_cast<uint8_t*>(Instances[ImageIndex].Memory.Mapped) + InstanceOffset);
+}
+
+void QuadBatch::Add(const Quad& Instance)
+{
+  if(QuadCount == Capacity)
+  {
+    throw std::runtime_error("Quad batch is full");
+  }
+
+  Mapped[QuadCount++] = Instance;
+}
+
+void QuadBatch::End()
+{
+  Buffer& Target = Instances[CurrentImage];
+
+  VkDrawIndexedIndirectCommand Draw{};
+  Draw.indexCount = 6;
+  Draw.instanceCount = QuadCount;
+  Draw.firstIndex = 0;
+  Draw.vertexOffset = 0;
+  Draw.firstInstance = 0;
+
+  memcpy(Target.Memory.Mapped, &Draw, sizeof(Draw));
+
+  // a no-op on coherent memory, but the buffer may have landed on a non-coherent type
+  Context->Allocator->Flush(Target.Memory, 0, InstanceOffset + VkDeviceSize(QuadCount) * sizeof(Quad));
+
+  Mapped = nullptr;
+}
+
+void QuadBatch::Bind(VkCommandBuffer Cmd, uint32_t ImageIndex, VkDescriptorSet TextureSet)
+{
+  float ScreenSize[2] = { float(Context->Extent.width), float(Context->Extent.height) };
+
+  VkDeviceSize Offset = InstanceOffset;
+
+  vkCmdBindPipeline(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+  vkCmdBindDescriptorSets(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, Layout, 0, 1, &TextureSet, 0, nullptr);
+  vkCmdPushConstants(Cmd, Layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ScreenSize), ScreenSize);
+
+  vkCmdBindVertexBuffers(Cmd, 0, 1, &Instances[ImageIndex].Buffer, &Offset);
+  vkCmdBindIndexBuffer(Cmd, Indices.Buffer, 0, VK_INDEX_TYPE_UINT16);
+}
+
+void QuadBatch::Record(VkCommandBuffer Cmd, uint32_t ImageIndex, VkDescriptorSet TextureSet)
+{
+  Bind(Cmd, ImageIndex, TextureSet);
+
+  // the instance count is read from the buffer when the GPU gets here, not when this was recorded
+  vkCmdDrawIndexedIndirect(Cmd, Instances[ImageIndex].Buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void QuadBatch::RecordRange(VkCommandBuffer Cmd, uint32_t ImageIndex, VkDescriptorSet TextureSet, uint32_t First, uint32_t Count)
+{
+  // recorded after End(), so the count is known and the draw doesn't need the indirect command
+  Count = std::min(Count, QuadCount - std::min(First, QuadCount));
+
+  if(Count == 0)
+  {
+    return;
+  }
+
+  Bind(Cmd, ImageIndex, TextureSet);
+
+  vkCmdDrawIndexed(Cmd, 6, Count, 0, 0, First);
+}
+
+uint32_t QuadBatch::PackColor(float R, float G, float B, float A)
+{
+  auto Channel = [](float Value) { return uint32_t(std::clamp(Value, 0.f, 1.f) * 255.f + 0.5f); };
+
+  return Channel(R) | (Channel(G) << 8) | (Channel(B) << 16) | (Channel(A) << 24);
+}
+
+void QuadBatch::CreatePipeline(VkDescriptorSetLayout TextureLayout)
+{
+  // Shaders
+    VkShaderModule Vert = CreateShaderModule(QuadVertSpirv, sizeof(QuadVertSpirv));
+    VkShaderModule Frag = CreateShaderModule(QuadFragSpirv, sizeof(QuadFragSpirv));
+
+    VkPipelineShaderStageCreateInfo Stages[2]{};
+    Stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    Stages[0].pName = "main";
+    Stages[0].module = Vert;
+    Stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+
+    Stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    Stages[1].pName = "main";
+    Stages[1].module = Frag;
+    Stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  // Shaders
+
+  // Layout
+    VkPushConstantRange ScreenRange{};
+    ScreenRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    ScreenRange.offset = 0;
+    ScreenRange.size = sizeof(float) * 2;
+
+    VkPipelineLayoutCreateInfo PipeLayoutInfo{};
+    PipeLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    PipeLayoutInfo.setLayoutCount = 1;
+    PipeLayoutInfo.pSetLayouts = &TextureLayout;
+    PipeLayoutInfo.pushConstantRangeCount = 1;
+    PipeLayoutInfo.pPushConstantRanges = &ScreenRange;
+
+    if(vkCreatePipelineLayout(Context->Device, &PipeLayoutInfo, nullptr, &Layout) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create quad pipeline layout");
+    }
+  // Layout
+
+  // Input state
+    VkVertexInputBindingDescription InstanceBinding{};
+    InstanceBinding.binding = 0;
+    InstanceBinding.stride = sizeof(Quad);
+    InstanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    VkVertexInputAttributeDescription Attributes[6]{};
+    Attributes[0] = { 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Quad, Position) };
+    Attributes[1] = { 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Quad, Size) };
+    Attributes[2] = { 2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Quad, UVRect) };
+    Attributes[3] = { 3, 0, VK_FORMAT_R32_SFLOAT, offsetof(Quad, Rotation) };
+    Attributes[4] = { 4, 0, VK_FORMAT_R32_UINT, offsetof(Quad, TextureIndex) };
+    Attributes[5] = { 5, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(Quad, Tint) };
+
+    VkPipelineVertexInputStateCreateInfo VertInput{};
+    VertInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VertInput.vertexBindingDescriptionCount = 1;
+    VertInput.pVertexBindingDescriptions = &InstanceBinding;
+    VertInput.vertexAttributeDescriptionCount = 6;
+    VertInput.pVertexAttributeDescriptions = Attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo InputState{};
+    InputState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    InputState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    InputState.primitiveRestartEnable = VK_FALSE;
+  // Input state
+
+  // Viewport
+    VkPipelineViewportStateCreateInfo ViewPortInfo{};
+    ViewPortInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    ViewPortInfo.scissorCount = 1;
+    ViewPortInfo.viewportCount = 1;
+
+    VkDynamicState DynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo DynamicInfo{};
+    DynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    DynamicInfo.dynamicStateCount = 2;
+    DynamicInfo.pDynamicStates = DynamicStates;
+  // Viewport
+
+  // Color
+    // tiles overlap and the tint carries alpha, so quads blend over each other in submission order
+    VkPipelineColorBlendAttachmentState ColorBlendAttachment{};
+    ColorBlendAttachment.blendEnable = VK_TRUE;
+    ColorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    ColorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    ColorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    ColorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    ColorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    ColorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    ColorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo ColorBlendInfo{};
+    ColorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    ColorBlendInfo.logicOpEnable = VK_FALSE;
+    ColorBlendInfo.attachmentCount = 1;
+    ColorBlendInfo.pAttachments = &ColorBlendAttachment;
+  // Color
+
+  // Rasterizer
+    // rotated quads can come out either winding
+    VkPipelineRasterizationStateCreateInfo Rasterizer{};
+    Rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    Rasterizer.cullMode = VK_CULL_MODE_NONE;
+    Rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    Rasterizer.lineWidth = 1.f;
+    Rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  // Rasterizer
+
+  VkPipelineDepthStencilStateCreateInfo DepthStencilState{};
+  DepthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  DepthStencilState.depthTestEnable = VK_FALSE;
+  DepthStencilState.depthWriteEnable = VK_FALSE;
+
+  VkPipelineMultisampleStateCreateInfo MultisampleState{};
+  MultisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  MultisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkGraphicsPipelineCreateInfo GraphicsPipe{};
+  GraphicsPipe.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  GraphicsPipe.layout = Layout;
+  GraphicsPipe.stageCount = 2;
+  GraphicsPipe.pStages = Stages;
+  GraphicsPipe.renderPass = Context->Renderpass;
+  GraphicsPipe.subpass = 0;
+  GraphicsPipe.pVertexInputState = &VertInput;
+  GraphicsPipe.pInputAssemblyState = &InputState;
+  GraphicsPipe.pViewportState = &ViewPortInfo;
+  GraphicsPipe.pDynamicState = &DynamicInfo;
+  GraphicsPipe.pColorBlendState = &ColorBlendInfo;
+  GraphicsPipe.pRasterizationState = &Rasterizer;
+  GraphicsPipe.pMultisampleState = &MultisampleState;
+  GraphicsPipe.pDepthStencilState = &DepthStencilState;
+
+  if(vkCreateGraphicsPipelines(Context->Device, Context->Pipelines->Get(), 1, &GraphicsPipe, nullptr, &Pipeline) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create quad pipeline");
+  }
+
+  vkDestroyShaderModule(Context->Device, Vert, nullptr);
+  vkDestroyShaderModule(Context->Device, Frag, nullptr);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vulkan.h"
+
+// One textured quad, laid out exactly as the vertex shader reads it per instance.
+struct Quad
+{
+  glm::vec2 Position;      // center, in pixels from the top left of the render area
+  glm::vec2 Size;          // in pixels
+  glm::vec4 UVRect;        // u0, v0, u1, v1
+  float Rotation;          // radians, around the center
+  uint32_t TextureIndex;   // slot in the texture table
+  uint32_t Tint;           // RGBA8, multiplied with the texel
+};
+
+// Draws any number of quads with one instanced indexed draw per frame.
+// Each swap image has its own persistently mapped buffer holding an indirect draw command followed by the instances.
+// The recorded command buffers only point at those buffers, so quads change every frame without re-recording,
+// and a buffer is only rewritten after the frame scheduler has waited for its image's last submission.
+class QuadBatch
+{
+  public:
+  // Capacity is the most quads one frame can hold.
+  QuadBatch(uint32_t Capacity, VkDescriptorSetLayout TextureLayout);
+  ~QuadBatch();
+
+  // Swap image count changes on recreation, there's one instance buffer per image. Call with the device idle.
+  void Resize(uint32_t ImageCount);
+
+  // Starts filling ImageIndex's buffer. Call after BeginFrame returned ImageIndex.
+  void Begin(uint32_t ImageIndex);
+  void Add(const Quad& Instance);
+  // Writes the draw count and flushes the instances, before the frame is submitted.
+  void End();
+
+  // Records the batch's draw for ImageIndex, inside the render pass.
+  void Record(VkCommandBuffer Cmd, uint32_t ImageIndex, VkDescriptorSet TextureSet);
+
+  // Records a direct draw of Count quads starting at First, for command buffers recorded every frame after End().
+  // Ranges of one frame can be recorded on different threads into separate command buffers.
+  void RecordRange(VkCommandBuffer Cmd, uint32_t ImageIndex, VkDescriptorSet TextureSet, uint32_t First, uint32_t Count);
+
+  uint32_t Count() const { return QuadCount; }
+
+  static uint32_t PackColor(float R, float G, float B, float A = 1.f);
+
+  private:
+  void Bind(VkCommandBuffer Cmd, uint32_t ImageIndex, VkDescriptorSet TextureSet);
+  void CreatePipeline(VkDescriptorSetLayout TextureLayout);
+  void CreateInstanceBuffers(uint32_t ImageCount);
+  void DestroyInstanceBuffers();
+
+  // the indirect command sits in front of the instances, padded so the instances start aligned
+  static const VkDeviceSize InstanceOffset = 64;
+
+  uint32_t Capacity;
+
+  VkPipelineLayout Layout;
+  VkPipeline Pipeline;
+
+  Buffer Indices;
+  std::vector<Buffer> Instances;   // per swap image
+
+  uint32_t CurrentImage = 0;
+  uint32_t QuadCount = 0;
+  Quad* Mapped = nullptr;
+};
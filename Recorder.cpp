@@ -0,0 +1,135 @@
+#include "Recorder.h"
+#include "Profiler.h"
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+static uint32_t RecordingThreads(uint32_t ThreadCount)
+{
+  return ThreadCount > 0 ? ThreadCount : std::max(1u, std::thread::hardware_concurrency());
+}
+
+CommandRecorder::CommandRecorder(uint32_t FramesInFlight, uint32_t ThreadCount)
+  : Threads(RecordingThreads(ThreadCount)), Workers(std::max(Threads, 2u) - 1)
+{
+  // everything in a pool is recorded once and thrown away with the reset, no per-buffer reset bit
+  VkCommandPoolCreateInfo PoolCI{};
+  PoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  PoolCI.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  PoolCI.queueFamilyIndex = Context->GraphicsFamily;
+
+  Slots.resize(FramesInFlight);
+
+  for(SlotPools& Slot : Slots)
+  {
+    if(vkCreateCommandPool(Context->Device, &PoolCI, nullptr, &Slot.PrimaryPool) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create recording command pool");
+    }
+
+    VkCommandBufferAllocateInfo CmdAllocInfo{};
+    CmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    CmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    CmdAllocInfo.commandPool = Slot.PrimaryPool;
+    CmdAllocInfo.commandBufferCount = 1;
+
+    if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, &Slot.Primary) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to allocate primary command buffer");
+    }
+
+    Slot.Pools.resize(Threads);
+    Slot.Secondaries.resize(Threads);
+
+    for(uint32_t t = 0; t < Threads; t++)
+    {
+      if(vkCreateCommandPool(Context->Device, &PoolCI, nullptr, &Slot.Pools[t]) != VK_SUCCESS)
+      {
+        throw std::runtime_error("Failed to create recording command pool");
+      }
+
+      CmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      CmdAllocInfo.commandPool = Slot.Pools[t];
+
+      if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, &Slot.Secondaries[t]) != VK_SUCCESS)
+      {
+        throw std::runtime_error("Failed to allocate secondary command buffer");
+      }
+    }
+  }
+}
+
+CommandRecorder::~CommandRecorder()
+{
+  Workers.WaitIdle();
+
+  // destroying a pool frees its buffers
+  for(SlotPools& Slot : Slots)
+  {
+    vkDestroyCommandPool(Context->Device, Slot.PrimaryPool, nullptr);
+
+    for(VkCommandPool Pool : Slot.Pools)
+    {
+      vkDestroyCommandPool(Context->Device, Pool, nullptr);
+    }
+  }
+}
+
+VkCommandBuffer CommandRecorder::Record(uint32_t FrameSlot, uint32_t ImageIndex, uint32_t ItemCount, const RangeJob& Job)
+{
+  SlotPools& Slot = Slots[FrameSlot];
+
+  // the scheduler waited for this slot's point, nothing recorded from its pools is pending anymore
+  vkResetCommandPool(Context->Device, Slot.PrimaryPool, 0);
+
+  for(VkCommandPool Pool : Slot.Pools)
+  {
+    vkResetCommandPool(Context->Device, Pool, 0);
+  }
+
+  // never more ranges than items, an empty frame still gets one so the pass sets its viewport
+  uint32_t Ranges = std::max(1u, std::min(Threads, ItemCount));
+
+  VkCommandBufferInheritanceInfo Inheritance{};
+  Inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  Inheritance.renderPass = Context->Renderpass;
+  Inheritance.subpass = 0;
+  Inheritance.framebuffer = Context->Graph->Framebuffer(Context->MainPass, ImageIndex);
+  // the profiler's statistics query is active while the secondaries execute, if the device can inherit it
+  Inheritance.pipelineStatistics = Context->Profiler ? Context->Profiler->StatisticFlags() : 0;
+
+  auto RecordRange = [&](uint32_t Range)
+  {
+    uint32_t First = uint64_t(ItemCount) * Range / Ranges;
+    uint32_t Last = uint64_t(ItemCount) * (Range + 1) / Ranges;
+
+    VkCommandBufferBeginInfo BeginInf{};
+    BeginInf.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    BeginInf.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    BeginInf.pInheritanceInfo = &Inheritance;
+
+    VkCommandBuffer Cmd = Slot.Secondaries[Range];
+
+    vkBeginCommandBuffer(Cmd, &BeginInf);
+      SetRenderArea(Cmd);
+      Job(Cmd, First, Last - First);
+    vkEndCommandBuffer(Cmd);
+  };
+
+  for(uint32_t Range = 1; Range < Ranges; Range++)
+  {
+    Workers.Submit([&RecordRange, Range] { RecordRange(Range); });
+  }
+
+  RecordRange(0);
+  Workers.WaitIdle();
+
+  RecordFrame(Slot.Primary, ImageIndex, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, [&](VkCommandBuffer Cmd)
+  {
+    vkCmdExecuteCommands(Cmd, Ranges, Slot.Secondaries.data());
+  });
+
+  return Slot.Primary;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Vulkan.h"
+#include "ThreadPool.h"
+
+// Records every frame's render pass on several threads, for scenes that change too much to record once up front.
+// The pass's items are split into contiguous ranges, each recorded into its own secondary command buffer, and a
+// primary executes them in order. Each frame slot has one command pool per thread plus one for the primary, so a pool
+// is only ever touched by one thread, and a slot's pools are reset whole instead of buffer by buffer.
+class CommandRecorder
+{
+  public:
+  // Records items [First, First + Count) into Cmd, which is already inside the render pass with the viewport set.
+  // Runs on any of the threads, concurrently with other ranges of the same frame.
+  typedef std::function<void(VkCommandBuffer Cmd, uint32_t First, uint32_t Count)> RangeJob;
+
+  // ThreadCount of 0 uses every hardware thread. The render thread records the first range itself.
+  CommandRecorder(uint32_t FramesInFlight, uint32_t ThreadCount = 0);
+  // Destroy with the device idle.
+  ~CommandRecorder();
+
+  // Resets FrameSlot's pools and records ImageIndex's frame with ItemCount items split across the threads.
+  // Call after BeginFrame has waited for FrameSlot, and pass the returned primary to EndFrame.
+  VkCommandBuffer Record(uint32_t FrameSlot, uint32_t ImageIndex, uint32_t ItemCount, const RangeJob& Job);
+
+  uint32_t ThreadCount() const { return Threads; }
+
+  private:
+  struct SlotPools
+  {
+    VkCommandPool PrimaryPool;
+    VkCommandBuffer Primary;
+    std::vector<VkCommandPool> Pools;            // one per thread
+    std::vector<VkCommandBuffer> Secondaries;    // one per thread, allocated once and re-recorded after every reset
+  };
+
+  uint32_t Threads;
+  std::vector<SlotPools> Slots;
+
+  // declared last so workers are joined before the pools they record from are destroyed
+  ThreadPool Workers;
+};
@@ -0,0 +1,882 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+static const VkAccessFlags WriteAccess = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+                                         VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+static bool IsDepthFormat(VkFormat Format)
+{
+  switch(Format)
+  {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static VkImageAspectFlags AspectOf(VkFormat Format)
+{
+  return IsDepthFormat(Format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
+RenderGraph::~RenderGraph()
+{
+  DestroyTargets();
+
+  for(Pass& Target : Passes)
+  {
+    if(Target.Renderpass != VK_NULL_HANDLE)
+    {
+      vkDestroyRenderPass(Context->Device, Target.Renderpass, nullptr);
+    }
+  }
+}
+
+uint32_t RenderGraph::Import(const char* Name, const ImageSource& Source)
+{
+  Resource NewResource{};
+  NewResource.Name = Name;
+  NewResource.Imported = true;
+  NewResource.Source = Source;
+
+  Resources.push_back(NewResource);
+  return Resources.size() - 1;
+}
+
+void RenderGraph::Export(uint32_t Resource, VkImageLayout Layout)
+{
+  if(!Resources[Resource].Imported)
+  {
+    throw std::runtime_error("Only imported images can be exported from the render graph");
+  }
+
+  Resources[Resource].Exported = true;
+  Resources[Resource].ExportLayout = Layout;
+}
+
+uint32_t RenderGraph::Create(const char* Name, VkFormat Format)
+{
+  Resource NewResource{};
+  NewResource.Name = Name;
+  NewResource.Imported = false;
+  NewResource.Format = Format;
+
+  Resources.push_back(NewResource);
+  return Resources.size() - 1;
+}
+
+uint32_t RenderGraph::AddPass(const char* Name, PassType Type)
+{
+  Pass NewPass{};
+  NewPass.Name = Name;
+  NewPass.Type = Type;
+
+  Passes.push_back(NewPass);
+  return Passes.size() - 1;
+}
+
+void RenderGraph::AddUse(uint32_t Pass, uint32_t Resource, UseKind Kind, bool Written, bool Clear)
+{
+  RenderGraph::Pass& Target = Passes[Pass];
+
+  if(IsAttachment(Kind) && Target.Type != PassType::Graphics)
+  {
+    throw std::runtime_error("Render graph pass " + Target.Name + " isn't a graphics pass, it can't have attachments");
+  }
+
+  for(Use& Existing : Target.Uses)
+  {
+    if(Existing.Resource != Resource)
+    {
+      continue;
+    }
+
+    // a depth buffer tested and written is one attachment
+    if(Kind == UseKind::Depth && Existing.Kind == UseKind::Depth)
+    {
+      Existing.Written = Existing.Written || Written;
+      Existing.Clear = Written ? Clear : Existing.Clear;
+      Existing.Tested = Existing.Tested || !Written;
+      return;
+    }
+
+    throw std::runtime_error("Render graph pass " + Target.Name + " uses " + Resources[Resource].Name + " twice");
+  }
+
+  Use NewUse{};
+  NewUse.Resource = Resource;
+  NewUse.Kind = Kind;
+  NewUse.Written = Written;
+  NewUse.Clear = Clear;
+  NewUse.Tested = Kind == UseKind::Depth && !Written;
+
+  Target.Uses.push_back(NewUse);
+}
+
+void RenderGraph::WriteColor(uint32_t Pass, uint32_t Resource, bool Clear)
+{
+  AddUse(Pass, Resource, UseKind::Color, true, Clear);
+}
+
+void RenderGraph::WriteDepth(uint32_t Pass, uint32_t Resource, bool Clear)
+{
+  AddUse(Pass, Resource, UseKind::Depth, true, Clear);
+}
+
+void RenderGraph::ReadDepth(uint32_t Pass, uint32_t Resource)
+{
+  AddUse(Pass, Resource, UseKind::Depth, false, false);
+}
+
+void RenderGraph::ReadTexture(uint32_t Pass, uint32_t Resource)
+{
+  AddUse(Pass, Resource, UseKind::Sampled, false, false);
+}
+
+void RenderGraph::WriteStorage(uint32_t Pass, uint32_t Resource)
+{
+  AddUse(Pass, Resource, UseKind::Storage, true, false);
+}
+
+void RenderGraph::ReadTransfer(uint32_t Pass, uint32_t Resource)
+{
+  AddUse(Pass, Resource, UseKind::TransferSrc, false, false);
+}
+
+void RenderGraph::WriteTransfer(uint32_t Pass, uint32_t Resource)
+{
+  AddUse(Pass, Resource, UseKind::TransferDst, true, false);
+}
+
+RenderGraph::State RenderGraph::UseState(UseKind Kind, PassType Type)
+{
+  VkPipelineStageFlags ShaderStage = Type == PassType::Graphics ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+  switch(Kind)
+  {
+    case UseKind::Color:
+      // blending reads what's there
+      return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+               VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+    case UseKind::Depth:
+      return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+    case UseKind::Sampled:
+      return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, ShaderStage, VK_ACCESS_SHADER_READ_BIT };
+    case UseKind::Storage:
+      return { VK_IMAGE_LAYOUT_GENERAL, ShaderStage, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+    case UseKind::TransferSrc:
+      return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT };
+    case UseKind::TransferDst:
+    default:
+      return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT };
+  }
+}
+
+bool RenderGraph::NeedsBarrier(const State& Before, const State& After)
+{
+  // a layout change, anything after a write, or a write after reads that may still be running
+  return Before.Layout != After.Layout || (Before.Access & WriteAccess) || ((After.Access & WriteAccess) && Before.Stages != 0);
+}
+
+void RenderGraph::Cull()
+{
+  // walking back from the exports, a write only matters if something after it reads what it leaves
+  std::vector<bool> Needed(Resources.size());
+
+  for(uint32_t r = 0; r < Resources.size(); r++)
+  {
+    Needed[r] = Resources[r].Exported;
+  }
+
+  for(uint32_t p = Passes.size(); p-- > 0;)
+  {
+    Pass& Target = Passes[p];
+    bool Alive = false;
+
+    for(Use& Current : Target.Uses)
+    {
+      Current.Stored = Needed[Current.Resource];
+
+      if(Current.Written && Current.Stored)
+      {
+        Alive = true;
+      }
+    }
+
+    Target.Culled = !Alive;
+
+    // depth testing reads the pass's own writes, the depth buffer stays for as long as the pass does
+    for(Use& Current : Target.Uses)
+    {
+      Current.Kept = Alive && (!Current.Written || Current.Stored || Current.Tested);
+
+      if(!Current.Kept)
+      {
+        continue;
+      }
+
+      bool Loads = IsAttachment(Current.Kind) ? !Current.Clear : Current.Kind != UseKind::TransferDst;
+
+      if(Loads)
+      {
+        Needed[Current.Resource] = true;
+      }
+      else if(IsAttachment(Current.Kind))
+      {
+        Needed[Current.Resource] = false;
+      }
+    }
+  }
+}
+
+void RenderGraph::Alias()
+{
+  std::vector<uint32_t> First(Resources.size(), UINT32_MAX);
+  std::vector<uint32_t> Last(Resources.size(), 0);
+  std::vector<uint32_t> Owned;
+
+  for(Resource& Target : Resources)
+  {
+    // transient until one of its uses says otherwise
+    Target.Usage = 0;
+    Target.Lazy = !Target.Imported;
+  }
+
+  for(uint32_t p = 0; p < Passes.size(); p++)
+  {
+    for(Use& Current : Passes[p].Uses)
+    {
+      Resource& Target = Resources[Current.Resource];
+
+      if(!Current.Kept || Target.Imported)
+      {
+        continue;
+      }
+
+      bool FirstUse = First[Current.Resource] == UINT32_MAX;
+
+      if(FirstUse)
+      {
+        First[Current.Resource] = p;
+        Owned.push_back(Current.Resource);
+      }
+
+      Last[Current.Resource] = p;
+
+      switch(Current.Kind)
+      {
+        case UseKind::Color: Target.Usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; break;
+        case UseKind::Depth: Target.Usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; break;
+        case UseKind::Sampled: Target.Usage |= VK_IMAGE_USAGE_SAMPLED_BIT; break;
+        case UseKind::Storage: Target.Usage |= VK_IMAGE_USAGE_STORAGE_BIT; break;
+        case UseKind::TransferSrc: Target.Usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; break;
+        case UseKind::TransferDst: Target.Usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; break;
+      }
+
+      // contents that never leave a render pass, neither loaded nor stored, don't need memory behind them
+      if(!IsAttachment(Current.Kind) || Current.Stored || (!Current.Clear && !FirstUse))
+      {
+        Target.Lazy = false;
+      }
+    }
+  }
+
+  // first fit into a slot whose images are all done before this one starts, Owned is already in order of first use
+  Slots.clear();
+
+  for(uint32_t r : Owned)
+  {
+    Resource& Target = Resources[r];
+
+    if(Target.Lazy)
+    {
+      Target.Usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
+
+    uint32_t s = 0;
+    while(s < Slots.size() && (Slots[s].Lazy != Target.Lazy || Last[Slots[s].Resources.back()] >= First[r]))
+    {
+      s++;
+    }
+
+    if(s == Slots.size())
+    {
+      MemorySlot NewSlot{};
+      NewSlot.Lazy = Target.Lazy;
+      Slots.push_back(NewSlot);
+    }
+
+    Slots[s].Resources.push_back(r);
+    Target.Slot = s;
+  }
+}
+
+void RenderGraph::ResolveStates()
+{
+  // every kept use of each resource, in the order they're recorded
+  std::vector<std::vector<Use*>> Chains(Resources.size());
+
+  for(Pass& Target : Passes)
+  {
+    for(Use& Current : Target.Uses)
+    {
+      if(Current.Kept)
+      {
+        Current.During = UseState(Current.Kind, Target.Type);
+        Chains[Current.Resource].push_back(&Current);
+      }
+    }
+  }
+
+  for(uint32_t r = 0; r < Resources.size(); r++)
+  {
+    Resource& Target = Resources[r];
+    std::vector<Use*>& Chain = Chains[r];
+
+    for(uint32_t i = 0; i < Chain.size(); i++)
+    {
+      Use& Current = *Chain[i];
+      Use* Next = i + 1 < Chain.size() ? Chain[i + 1] : nullptr;
+
+      Current.After = Current.During.Layout;
+      Current.Next = { Current.During.Layout, 0, 0 };
+
+      // the render pass transitions it for its next use on the way out, exports are handed to the submit's semaphore
+      if(IsAttachment(Current.Kind))
+      {
+        if(Next)
+        {
+          Current.After = Next->During.Layout;
+          Current.Next = Next->During;
+        }
+        else if(Target.Exported)
+        {
+          Current.After = Target.ExportLayout;
+          Current.Next = { Target.ExportLayout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0 };
+        }
+      }
+    }
+
+    for(uint32_t i = 0; i < Chain.size(); i++)
+    {
+      Use& Current = *Chain[i];
+
+      if(i > 0)
+      {
+        Use& Previous = *Chain[i - 1];
+        Current.Before = { Previous.After, Previous.During.Stages, Previous.During.Access };
+        Current.HandedOver = IsAttachment(Previous.Kind);
+        Current.Imported = false;
+      }
+      else if(Target.Imported)
+      {
+        // where the last frame left it. Whatever got it here, an acquire or another submit, signaled a semaphore
+        // waited on at the stage it's first used in
+        Use& Last = *Chain.back();
+        VkImageLayout Steady = Target.Exported ? Target.ExportLayout : Last.After;
+
+        Current.Before = { Steady, Current.During.Stages, 0 };
+        Current.HandedOver = false;
+        Current.Imported = true;
+      }
+      else
+      {
+        // nothing to keep, but the memory's last user, this image's previous frame or whatever it's aliased with,
+        // has to be done with it
+        MemorySlot& Slot = Slots[Target.Slot];
+        uint32_t Index = std::find(Slot.Resources.begin(), Slot.Resources.end(), r) - Slot.Resources.begin();
+        uint32_t Predecessor = Slot.Resources[(Index + Slot.Resources.size() - 1) % Slot.Resources.size()];
+        Use& Last = *Chains[Predecessor].back();
+
+        Current.Before = { VK_IMAGE_LAYOUT_UNDEFINED, Last.During.Stages, Last.During.Access };
+        Current.HandedOver = false;
+        Current.Imported = false;
+      }
+    }
+  }
+
+  PassTransitions.assign(Passes.size(), {});
+  FinalTransitions.clear();
+
+  for(uint32_t p = 0; p < Passes.size(); p++)
+  {
+    for(Use& Current : Passes[p].Uses)
+    {
+      if(!Current.Kept || Current.HandedOver)
+      {
+        continue;
+      }
+
+      if(!IsAttachment(Current.Kind))
+      {
+        if(Current.Imported || NeedsBarrier(Current.Before, Current.During))
+        {
+          PassTransitions[p].push_back({ Current.Resource, Current.Before, Current.During, Current.Imported });
+        }
+      }
+      else if(Current.Imported && !Current.Clear)
+      {
+        // the render pass loads it from the layout it's left in every frame, only the first frame can differ
+        State Initial = { Current.Before.Layout, Current.During.Stages, Current.During.Access };
+        PassTransitions[p].push_back({ Current.Resource, Current.Before, Initial, true });
+      }
+    }
+  }
+
+  for(uint32_t r = 0; r < Resources.size(); r++)
+  {
+    if(!Resources[r].Exported || Chains[r].empty())
+    {
+      continue;
+    }
+
+    Use& Last = *Chains[r].back();
+
+    if(!IsAttachment(Last.Kind) && Last.After != Resources[r].ExportLayout)
+    {
+      State Exported = { Resources[r].ExportLayout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0 };
+      FinalTransitions.push_back({ r, Last.During, Exported, false });
+    }
+  }
+}
+
+void RenderGraph::CreateRenderpass(Pass& Target)
+{
+  std::vector<VkAttachmentDescription> Descriptions;
+  std::vector<VkAttachmentReference> ColorReferences;
+  VkAttachmentReference DepthReference{};
+  bool HasDepth = false;
+
+  VkSubpassDependency In{};
+  In.srcSubpass = VK_SUBPASS_EXTERNAL;
+  In.dstSubpass = 0;
+
+  VkSubpassDependency Out{};
+  Out.srcSubpass = 0;
+  Out.dstSubpass = VK_SUBPASS_EXTERNAL;
+
+  Target.Attachments.clear();
+  Target.Clears.clear();
+
+  for(uint32_t u = 0; u < Target.Uses.size(); u++)
+  {
+    Use& Current = Target.Uses[u];
+
+    if(!IsAttachment(Current.Kind))
+    {
+      continue;
+    }
+
+    // a culled color keeps its slot so the pipelines' blend states still line up, nothing is written to it
+    if(!Current.Kept)
+    {
+      if(Current.Kind == UseKind::Color)
+      {
+        ColorReferences.push_back({ VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+      }
+
+      continue;
+    }
+
+    Resource& Source = Resources[Current.Resource];
+
+    // graph owned images start out undefined, there's only something to load if an earlier pass wrote it
+    bool Loads = !Current.Clear && (Current.Imported || Current.Before.Layout != VK_IMAGE_LAYOUT_UNDEFINED);
+
+    VkAttachmentDescription Description{};
+    Description.format = Source.Imported ? Source.Source(0).ImageFormat : Source.Format;
+    Description.samples = VK_SAMPLE_COUNT_1_BIT;
+    Description.loadOp = Current.Clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : Loads ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    Description.storeOp = Current.Stored ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    Description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    Description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    Description.initialLayout = Loads ? Current.Before.Layout : VK_IMAGE_LAYOUT_UNDEFINED;
+    Description.finalLayout = Current.After;
+
+    VkAttachmentReference Reference{ uint32_t(Descriptions.size()), Current.During.Layout };
+
+    VkClearValue Clear{};
+
+    if(Current.Kind == UseKind::Color)
+    {
+      ColorReferences.push_back(Reference);
+    }
+    else
+    {
+      DepthReference = Reference;
+      HasDepth = true;
+      Clear.depthStencil.depth = 1.f;
+    }
+
+    Descriptions.push_back(Description);
+    Target.Attachments.push_back(u);
+    Target.Clears.push_back(Clear);
+
+    if(!Current.HandedOver)
+    {
+      In.srcStageMask |= Current.Before.Stages;
+      In.srcAccessMask |= Current.Before.Access & WriteAccess;
+      In.dstStageMask |= Current.During.Stages;
+      In.dstAccessMask |= Current.During.Access;
+    }
+
+    if(Current.Next.Stages != 0)
+    {
+      Out.srcStageMask |= Current.During.Stages;
+      Out.srcAccessMask |= Current.During.Access & WriteAccess;
+      Out.dstStageMask |= Current.Next.Stages;
+      Out.dstAccessMask |= Current.Next.Access;
+    }
+  }
+
+  VkSubpassDescription PrimarySubpass{};
+  PrimarySubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  PrimarySubpass.colorAttachmentCount = ColorReferences.size();
+  PrimarySubpass.pColorAttachments = ColorReferences.data();
+  PrimarySubpass.pDepthStencilAttachment = HasDepth ? &DepthReference : nullptr;
+
+  std::vector<VkSubpassDependency> Dependencies;
+
+  if(In.srcStageMask != 0)
+  {
+    Dependencies.push_back(In);
+  }
+
+  if(Out.srcStageMask != 0)
+  {
+    Dependencies.push_back(Out);
+  }
+
+  VkRenderPassCreateInfo RenderpassInfo{};
+  RenderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  RenderpassInfo.attachmentCount = Descriptions.size();
+  RenderpassInfo.pAttachments = Descriptions.data();
+  RenderpassInfo.subpassCount = 1;
+  RenderpassInfo.pSubpasses = &PrimarySubpass;
+  RenderpassInfo.dependencyCount = Dependencies.size();
+  RenderpassInfo.pDependencies = Dependencies.data();
+
+  if(vkCreateRenderPass(Context->Device, &RenderpassInfo, nullptr, &Target.Renderpass) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create renderpass for " + Target.Name);
+  }
+}
+
+void RenderGraph::Compile()
+{
+  Cull();
+  Alias();
+  ResolveStates();
+
+  for(Pass& Target : Passes)
+  {
+    if(Target.Type == PassType::Graphics && !Target.Culled)
+    {
+      CreateRenderpass(Target);
+    }
+  }
+}
+
+void RenderGraph::PrintStats() const
+{
+  uint32_t KeptPasses = 0, Attachments = 0, KeptAttachments = 0, Lazy = 0;
+
+  for(const Pass& Target : Passes)
+  {
+    KeptPasses += Target.Culled ? 0 : 1;
+
+    for(const Use& Current : Target.Uses)
+    {
+      if(IsAttachment(Current.Kind))
+      {
+        Attachments++;
+        KeptAttachments += Current.Kept ? 1 : 0;
+      }
+    }
+  }
+
+  for(const MemorySlot& Slot : Slots)
+  {
+    Lazy += Slot.Lazy ? 1 : 0;
+  }
+
+  std::cout << "Render graph: " << KeptPasses << " of " << Passes.size() << " passes, " << KeptAttachments << " of " << Attachments
+            << " attachments, " << Slots.size() << " graph owned allocations (" << Lazy << " lazily allocated)\n";
+}
+
+void RenderGraph::CreateTargets()
+{
+  TargetCount = Context->SwapImages.size();
+
+  // Graph owned images
+    for(MemorySlot& Slot : Slots)
+    {
+      VkMemoryRequirements Combined{};
+      Combined.alignment = 1;
+      Combined.memoryTypeBits = UINT32_MAX;
+
+      for(uint32_t r : Slot.Resources)
+      {
+        Resource& Target = Resources[r];
+
+        VkImageCreateInfo ImageCI{};
+        ImageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        ImageCI.extent = Context->Extent;
+        ImageCI.arrayLayers = 1;
+        ImageCI.format = Target.Format;
+        ImageCI.imageType = VK_IMAGE_TYPE_2D;
+        ImageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        ImageCI.mipLevels = 1;
+        ImageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+        ImageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ImageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+        ImageCI.usage = Target.Usage;
+
+        if(vkCreateImage(Context->Device, &ImageCI, nullptr, &Target.Owned.Image) != VK_SUCCESS)
+        {
+          throw std::runtime_error("Failed to create " + Target.Name);
+        }
+
+        VkMemoryRequirements MemReq;
+        vkGetImageMemoryRequirements(Context->Device, Target.Owned.Image, &MemReq);
+
+        Combined.size = std::max(Combined.size, MemReq.size);
+        Combined.alignment = std::max(Combined.alignment, MemReq.alignment);
+        Combined.memoryTypeBits &= MemReq.memoryTypeBits;
+
+        Target.Owned.ImageFormat = Target.Format;
+        Target.Owned.CurrentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Target.Owned.MipLevels = 1;
+        Target.Owned.Extent = Context->Extent;
+      }
+
+      if(Combined.memoryTypeBits == 0)
+      {
+        throw std::runtime_error("Render graph images sharing memory have no memory type in common");
+      }
+
+      // lazily allocated where the device has it, plain device local otherwise
+      VkMemoryPropertyFlags Preferred = Slot.Lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+      Slot.Memory = Context->Allocator->Allocate(Combined, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Preferred, false);
+
+      for(uint32_t r : Slot.Resources)
+      {
+        Image& Owned = Resources[r].Owned;
+        Owned.Memory = Slot.Memory;
+
+        vkBindImageMemory(Context->Device, Owned.Image, Slot.Memory.Memory, Slot.Memory.Offset);
+
+        VkImageViewCreateInfo ViewCI{};
+        ViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        ViewCI.image = Owned.Image;
+        ViewCI.format = Owned.ImageFormat;
+        ViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+
+        ViewCI.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        ViewCI.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        ViewCI.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        ViewCI.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+        ViewCI.subresourceRange.aspectMask = AspectOf(Owned.ImageFormat);
+        ViewCI.subresourceRange.baseMipLevel = 0;
+        ViewCI.subresourceRange.levelCount = 1;
+        ViewCI.subresourceRange.baseArrayLayer = 0;
+        ViewCI.subresourceRange.layerCount = 1;
+
+        if(vkCreateImageView(Context->Device, &ViewCI, nullptr, &Owned.ImageView) != VK_SUCCESS)
+        {
+          throw std::runtime_error("Failed to create " + Resources[r].Name + " view");
+        }
+      }
+    }
+  // Graph owned images
+
+  // Framebuffers
+    for(Pass& Target : Passes)
+    {
+      if(Target.Renderpass == VK_NULL_HANDLE)
+      {
+        continue;
+      }
+
+      Target.Framebuffers.resize(TargetCount);
+
+      for(uint32_t i = 0; i < TargetCount; i++)
+      {
+        std::vector<VkImageView> Views;
+
+        for(uint32_t u : Target.Attachments)
+        {
+          Views.push_back(Get(Target.Uses[u].Resource, i).ImageView);
+        }
+
+        VkFramebufferCreateInfo FBInfo{};
+        FBInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        FBInfo.renderPass = Target.Renderpass;
+        FBInfo.attachmentCount = Views.size();
+        FBInfo.pAttachments = Views.data();
+        FBInfo.width = Context->Extent.width;
+        FBInfo.height = Context->Extent.height;
+        FBInfo.layers = 1;
+
+        if(vkCreateFramebuffer(Context->Device, &FBInfo, nullptr, &Target.Framebuffers[i]) != VK_SUCCESS)
+        {
+          throw std::runtime_error("Failed to create a framebuffer");
+        }
+      }
+    }
+  // Framebuffers
+}
+
+void RenderGraph::DestroyTargets()
+{
+  for(Pass& Target : Passes)
+  {
+    for(VkFramebuffer Framebuffer : Target.Framebuffers)
+    {
+      vkDestroyFramebuffer(Context->Device, Framebuffer, nullptr);
+    }
+
+    Target.Framebuffers.clear();
+  }
+
+  if(TargetCount == 0)
+  {
+    return;
+  }
+
+  // the images only share the slot's allocation, it's freed once
+  for(MemorySlot& Slot : Slots)
+  {
+    for(uint32_t r : Slot.Resources)
+    {
+      vkDestroyImageView(Context->Device, Resources[r].Owned.ImageView, nullptr);
+      vkDestroyImage(Context->Device, Resources[r].Owned.Image, nullptr);
+    }
+
+    Context->Allocator->Free(Slot.Memory);
+  }
+
+  TargetCount = 0;
+}
+
+Image& RenderGraph::Get(uint32_t Resource, uint32_t Target)
+{
+  return Resources[Resource].Imported ? Resources[Resource].Source(Target) : Resources[Resource].Owned;
+}
+
+void RenderGraph::Record(VkCommandBuffer Cmd, uint32_t Target, const std::vector<Transition>& Transitions)
+{
+  std::vector<VkImageMemoryBarrier> Barriers;
+  VkPipelineStageFlags SrcStages = 0;
+  VkPipelineStageFlags DstStages = 0;
+
+  for(const Transition& Current : Transitions)
+  {
+    Image& Source = Get(Current.Resource, Target);
+
+    State Before = Current.Before;
+
+    // the semaphore that brought it into the frame already ordered it, only a layout change is left to do
+    if(Current.FromCurrent)
+    {
+      Before.Layout = Source.CurrentLayout;
+
+      if(Before.Layout == Current.After.Layout)
+      {
+        continue;
+      }
+    }
+
+    VkImageMemoryBarrier Barrier{};
+    Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.image = Source.Image;
+    Barrier.oldLayout = Before.Layout;
+    Barrier.newLayout = Current.After.Layout;
+    Barrier.srcAccessMask = Before.Access & WriteAccess;
+    Barrier.dstAccessMask = Current.After.Access;
+    Barrier.subresourceRange = { AspectOf(Source.ImageFormat), 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+
+    Barriers.push_back(Barrier);
+    SrcStages |= Before.Stages;
+    DstStages |= Current.After.Stages;
+
+    Source.CurrentLayout = Current.After.Layout;
+  }
+
+  if(Barriers.empty())
+  {
+    return;
+  }
+
+  // a transition out of nothing into nothing still needs some stage on either side
+  if(SrcStages == 0)
+  {
+    SrcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  }
+
+  if(DstStages == 0)
+  {
+    DstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  }
+
+  vkCmdPipelineBarrier(Cmd, SrcStages, DstStages, 0, 0, nullptr, 0, nullptr, Barriers.size(), Barriers.data());
+}
+
+void RenderGraph::RecordBarriers(VkCommandBuffer Cmd, uint32_t Target, uint32_t Pass)
+{
+  Record(Cmd, Target, PassTransitions[Pass]);
+
+  for(Use& Current : Passes[Pass].Uses)
+  {
+    if(Current.Kept && !IsAttachment(Current.Kind))
+    {
+      Get(Current.Resource, Target).CurrentLayout = Current.During.Layout;
+    }
+  }
+}
+
+void RenderGraph::BeginPass(VkCommandBuffer Cmd, uint32_t Target, uint32_t Pass, VkSubpassContents Contents)
+{
+  RenderGraph::Pass& Current = Passes[Pass];
+
+  VkRenderPassBeginInfo RenderBegin{};
+  RenderBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  RenderBegin.renderPass = Current.Renderpass;
+  RenderBegin.framebuffer = Current.Framebuffers[Target];
+  RenderBegin.renderArea.extent.width = Context->Extent.width;
+  RenderBegin.renderArea.extent.height = Context->Extent.height;
+  RenderBegin.clearValueCount = Current.Clears.size();
+  RenderBegin.pClearValues = Current.Clears.data();
+
+  vkCmdBeginRenderPass(Cmd, &RenderBegin, Contents);
+}
+
+void RenderGraph::EndPass(VkCommandBuffer Cmd, uint32_t Target, uint32_t Pass)
+{
+  vkCmdEndRenderPass(Cmd);
+
+  for(uint32_t u : Passes[Pass].Attachments)
+  {
+    Use& Current = Passes[Pass].Uses[u];
+    Get(Current.Resource, Target).CurrentLayout = Current.After;
+  }
+}
+
+void RenderGraph::Finish(VkCommandBuffer Cmd, uint32_t Target)
+{
+  Record(Cmd, Target, FinalTransitions);
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Vulkan.h"
+
+enum class PassType
+{
+  Graphics,   // one render pass over its color and depth attachments
+  Compute,
+  Transfer
+};
+
+// Passes declare the images they read and write, everything else is derived from that: which passes and attachments
+// matter at all, load and store ops, render passes with their layouts and external dependencies, and the barriers
+// between passes. A read after a read in the same layout gets no barrier, and attachments are handed to their next
+// use by the render pass's own final layout and dependency instead of a barrier after it.
+// Imported images belong to someone else, their CurrentLayout is where the graph picks them up and is kept up to date
+// as passes are recorded. Images the graph creates only live within a frame. They share memory with the ones whose
+// passes don't overlap, and the ones that never leave a render pass are transient and lazily allocated, which a tiler
+// never has to back with memory at all.
+// Declare, Compile once, then CreateTargets for every swapchain. Passes record in the order they were added.
+class RenderGraph
+{
+  public:
+  // Target is the swap image index.
+  using ImageSource = std::function<Image&(uint32_t Target)>;
+
+  // Destroy with the device idle.
+  ~RenderGraph();
+
+  // Resources
+  uint32_t Import(const char* Name, const ImageSource& Source);
+  // What the last pass writes is kept and left in Layout, for whatever runs after the frame's submit.
+  void Export(uint32_t Resource, VkImageLayout Layout);
+  // Graph owned, at Context->Extent. Usage comes from the passes using it.
+  uint32_t Create(const char* Name, VkFormat Format);
+
+  // Passes
+  uint32_t AddPass(const char* Name, PassType Type);
+  // Clear false keeps what's there. Colors clear to transparent black, depth to 1.
+  void WriteColor(uint32_t Pass, uint32_t Resource, bool Clear = true);
+  void WriteDepth(uint32_t Pass, uint32_t Resource, bool Clear = true);
+  // Depth testing against it, this pass's own writes included. Depth nothing tests against is dropped.
+  void ReadDepth(uint32_t Pass, uint32_t Resource);
+  // From the fragment shader in graphics passes, the compute shader otherwise.
+  void ReadTexture(uint32_t Pass, uint32_t Resource);
+  void WriteStorage(uint32_t Pass, uint32_t Resource);
+  void ReadTransfer(uint32_t Pass, uint32_t Resource);
+  void WriteTransfer(uint32_t Pass, uint32_t Resource);
+
+  // Culls passes and attachments nothing reads, picks load/store ops and layouts, and creates the render passes.
+  // Those don't depend on the extent, they and the pipelines made against them outlive swapchain recreation.
+  void Compile();
+
+  // Graph owned images and framebuffers for every swap image. Call with the device idle.
+  void CreateTargets();
+  void DestroyTargets();
+
+  // Recording, for each pass in order: RecordBarriers, then BeginPass and EndPass around what a graphics pass draws.
+  // Finish after the last one.
+  void RecordBarriers(VkCommandBuffer Cmd, uint32_t Target, uint32_t Pass);
+  void BeginPass(VkCommandBuffer Cmd, uint32_t Target, uint32_t Pass, VkSubpassContents Contents);
+  void EndPass(VkCommandBuffer Cmd, uint32_t Target, uint32_t Pass);
+  void Finish(VkCommandBuffer Cmd, uint32_t Target);
+
+  bool Culled(uint32_t Pass) const { return Passes[Pass].Culled; }
+  VkRenderPass Renderpass(uint32_t Pass) const { return Passes[Pass].Renderpass; }
+  VkFramebuffer Framebuffer(uint32_t Pass, uint32_t Target) const { return Passes[Pass].Framebuffers[Target]; }
+
+  // What Compile kept and how the graph owned images share memory.
+  void PrintStats() const;
+
+  private:
+  enum class UseKind
+  {
+    Color,
+    Depth,
+    Sampled,
+    Storage,
+    TransferSrc,
+    TransferDst
+  };
+
+  struct State
+  {
+    VkImageLayout Layout;
+    VkPipelineStageFlags Stages;
+    VkAccessFlags Access;
+  };
+
+  struct Use
+  {
+    uint32_t Resource;
+    UseKind Kind;
+    bool Written;        // depth can be only tested against
+    bool Clear;          // attachments only
+    bool Tested;         // depth only
+    bool Kept;           // survived culling
+    bool Stored;         // something after this use reads what it leaves
+    bool HandedOver;     // the previous use's render pass already made it ready for this one
+    bool Imported;       // first use of an imported image, starts from its CurrentLayout
+    State Before;        // what the previous use, or the previous frame, left
+    State During;
+    VkImageLayout After; // what it's left in, the render pass's final layout for attachments
+    State Next;          // attachments, what the render pass hands it over to, no stages for nothing
+  };
+
+  struct Resource
+  {
+    std::string Name;
+    bool Imported;
+    ImageSource Source;
+    bool Exported = false;
+    VkImageLayout ExportLayout;
+
+    // graph owned, one image shared by every target
+    VkFormat Format;
+    VkImageUsageFlags Usage = 0;
+    bool Lazy = false;
+    uint32_t Slot;
+    Image Owned{};
+  };
+
+  struct Pass
+  {
+    std::string Name;
+    PassType Type;
+    std::vector<Use> Uses;
+    bool Culled = false;
+
+    // graphics passes
+    VkRenderPass Renderpass = VK_NULL_HANDLE;
+    std::vector<uint32_t> Attachments;   // into Uses, in attachment order
+    std::vector<VkClearValue> Clears;
+    std::vector<VkFramebuffer> Framebuffers;
+  };
+
+  // graph owned images bound to the same memory, in the order their passes run
+  struct MemorySlot
+  {
+    std::vector<uint32_t> Resources;
+    bool Lazy;
+    Allocation Memory;
+  };
+
+  // a layout change or hazard between two uses, the image is only known once the target is
+  struct Transition
+  {
+    uint32_t Resource;
+    State Before;
+    State After;
+    bool FromCurrent;    // old layout is the image's CurrentLayout at record time, skipped if it's already in the new one
+  };
+
+  void AddUse(uint32_t Pass, uint32_t Resource, UseKind Kind, bool Written, bool Clear);
+  static State UseState(UseKind Kind, PassType Type);
+  static bool IsAttachment(UseKind Kind) { return Kind == UseKind::Color || Kind == UseKind::Depth; }
+  static bool NeedsBarrier(const State& Before, const State& After);
+
+  void Cull();
+  void Alias();
+  void ResolveStates();
+  void CreateRenderpass(Pass& Target);
+
+  Image& Get(uint32_t Resource, uint32_t Target);
+  void Record(VkCommandBuffer Cmd, uint32_t Target, const std::vector<Transition>& Transitions);
+
+  std::vector<Resource> Resources;
+  std::vector<Pass> Passes;
+  std::vector<MemorySlot> Slots;
+
+  std::vector<std::vector<Transition>> PassTransitions;   // per pass, before it
+  std::vector<Transition> FinalTransitions;               // exports the last use doesn't leave in place
+
+  uint32_t TargetCount = 0;
+};
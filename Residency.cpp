@@ -0,0 +1,321 @@
+#include "Residency.h"
+#include "Upload.h"
+#include "TextureTable.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+ResidencyManager::ResidencyManager(TextureLoader& Loader, uint32_t FramesInFlight, float Anisotropy, VkDeviceSize Limit)
+  : Loader(Loader), FramesInFlight(FramesInFlight), Limit(Limit)
+{
+  // views clamp to their own levels, one sampler covers every texture however many it has
+  Sampler = CreateSampler(16, Anisotropy);
+
+  // shared by everything that isn't loaded, never released
+  PlaceholderIndex = Context->Textures->Register(Loader.PlaceholderTexture(), Sampler);
+
+  Budget = Context->Allocator->DeviceLocalBudget();
+}
+
+ResidencyManager::~ResidencyManager()
+{
+  Release(true);
+
+  for(Entry& Target : Entries)
+  {
+    if(Target.HasTrimmed)
+    {
+      DestroyImage(Target.Trimmed);
+    }
+
+    if(Target.TableIndex != PlaceholderIndex)
+    {
+      Context->Textures->Release(Target.TableIndex);
+    }
+  }
+
+  Context->Textures->Release(PlaceholderIndex);
+  vkDestroySampler(Context->Device, Sampler, nullptr);
+}
+
+uint32_t ResidencyManager::Add(uint32_t Handle)
+{
+  Entry NewEntry{};
+  NewEntry.Handle = Handle;
+  NewEntry.TableIndex = PlaceholderIndex;
+  NewEntry.LastUsed = Frame;
+  NewEntry.State = Residency::Loading;
+
+  Entries.push_back(NewEntry);
+
+  return Entries.size() - 1;
+}
+
+uint32_t ResidencyManager::Use(uint32_t Id)
+{
+  Entry& Target = Entries[Id];
+  Target.LastUsed = Frame;
+
+  // back in view, decode it again and keep showing what's there until it lands
+  if(Target.State == Residency::Trimmed || Target.State == Residency::Evicted)
+  {
+    Loader.Reload(Target.Handle);
+    Target.State = Residency::Loading;
+    ReloadCount++;
+  }
+
+  return Target.TableIndex;
+}
+
+void ResidencyManager::Show(Entry& Target, const Image& Texture, VkDeviceSize Bytes)
+{
+  // a fresh slot, frames still in flight keep reading the old one untouched
+  uint32_t Index = Texture.Image == Loader.PlaceholderTexture().Image ? PlaceholderIndex : Context->Textures->Register(Texture, Sampler);
+
+  RetireSlot(Target.TableIndex);
+
+  Target.TableIndex = Index;
+  Target.Bytes = Bytes;
+}
+
+void ResidencyManager::RetireSlot(uint32_t TableIndex)
+{
+  if(TableIndex == PlaceholderIndex)
+  {
+    return;
+  }
+
+  Retired Old{};
+  Old.TableIndex = TableIndex;
+  Old.Frame = Frame;
+
+  RetiredQueue.push_back(Old);
+}
+
+void ResidencyManager::RetireImage(const Image& Texture)
+{
+  Retired Old{};
+  Old.Texture = Texture;
+  Old.HasImage = true;
+  Old.TableIndex = PlaceholderIndex;
+  Old.Frame = Frame;
+
+  RetiredQueue.push_back(Old);
+  RetiringBytes += Texture.Memory.Size;
+}
+
+void ResidencyManager::Release(bool All)
+{
+  // retired during Update of frame F, the last frame that could read it is F - 1 and the copy out of it went ahead of F.
+  // BeginFrame of F + FramesInFlight + 1 has waited for both.
+  while(!RetiredQueue.empty() && (All || RetiredQueue.front().Frame + FramesInFlight + 1 <= Frame))
+  {
+    Retired& Old = RetiredQueue.front();
+
+    if(Old.HasImage)
+    {
+      RetiringBytes -= Old.Texture.Memory.Size;
+      DestroyImage(Old.Texture);
+    }
+
+    if(Old.TableIndex != PlaceholderIndex)
+    {
+      Context->Textures->Release(Old.TableIndex);
+    }
+
+    RetiredQueue.pop_front();
+  }
+}
+
+VkDeviceSize ResidencyManager::ResidentBytes() const
+{
+  VkDeviceSize Bytes = 0;
+
+  for(const Entry& Target : Entries)
+  {
+    Bytes += Target.Bytes;
+  }
+
+  return Bytes;
+}
+
+bool ResidencyManager::OverBudget(bool Trimming) const
+{
+  // trimming starts at 90% and goes on down to 80%, so it doesn't kick in again on the very next load
+  VkDeviceSize Percent = Trimming ? 80 : 90;
+
+  VkDeviceSize Usage = Budget.Usage - std::min(Budget.Usage, RetiringBytes);
+
+  if(Usage > Budget.Budget / 100 * Percent)
+  {
+    return true;
+  }
+
+  return Limit > 0 && ResidentBytes() > Limit / 100 * Percent;
+}
+
+bool ResidencyManager::Trim(Entry& Target)
+{
+  Image& Full = Loader.Get(Target.Handle);
+
+  uint32_t Drop = 0;
+  while(Drop + 1 < Full.MipLevels && std::max(Full.Extent.width, Full.Extent.height) >> Drop > TrimmedSize)
+  {
+    Drop++;
+  }
+
+  if(Drop == 0)
+  {
+    return false;
+  }
+
+  Image Small = CreateSampledImage(Full.ImageFormat, std::max(1u, Full.Extent.width >> Drop), std::max(1u, Full.Extent.height >> Drop),
+                                   Full.MipLevels - Drop, 0);
+
+  // the loader lets go of the full image, it's destroyed after the copy and the frames before it are done
+  Image Source = Loader.Evict(Target.Handle);
+  Context->Uploads->CopyLevels(Source, Small, Drop);
+  RetireImage(Source);
+
+  Target.Trimmed = Small;
+  Target.HasTrimmed = true;
+  Target.State = Residency::Trimmed;
+
+  Show(Target, Small, Small.Memory.Size);
+  TrimCount++;
+
+  return true;
+}
+
+void ResidencyManager::Evict(Entry& Target)
+{
+  if(Target.HasTrimmed)
+  {
+    RetireImage(Target.Trimmed);
+    Target.HasTrimmed = false;
+  }
+  else
+  {
+    RetireImage(Loader.Evict(Target.Handle));
+  }
+
+  Target.State = Residency::Evicted;
+
+  Show(Target, Loader.PlaceholderTexture(), 0);
+  EvictCount++;
+}
+
+void ResidencyManager::Rebalance()
+{
+  if(!OverBudget(false))
+  {
+    return;
+  }
+
+  std::vector<Entry*> Cold;
+
+  for(Entry& Target : Entries)
+  {
+    bool Resident = Target.State == Residency::Full || Target.State == Residency::Trimmed;
+
+    if(Resident && Target.LastUsed + MinIdleFrames < Frame)
+    {
+      Cold.push_back(&Target);
+    }
+  }
+
+  std::sort(Cold.begin(), Cold.end(), [](const Entry* A, const Entry* B) { return A->LastUsed < B->LastUsed; });
+
+  bool Copied = false;
+
+  // dropping the top level alone gives back three quarters of a texture and keeps something to show,
+  // so every cold texture is trimmed before any is evicted. One trimmed here isn't evicted in the same pass,
+  // that would throw away its copy right after paying for it
+  std::vector<Entry*> Untrimmed;
+
+  for(Entry* Target : Cold)
+  {
+    if(OverBudget(true) && Target->State == Residency::Full && Trim(*Target))
+    {
+      Copied = true;
+      continue;
+    }
+
+    Untrimmed.push_back(Target);
+  }
+
+  // the trimmed copies are allocated now, the driver's usage counts them and the full images retiring
+  if(Copied)
+  {
+    Budget = Context->Allocator->DeviceLocalBudget();
+  }
+
+  for(Entry* Target : Untrimmed)
+  {
+    if(!OverBudget(true))
+    {
+      break;
+    }
+
+    Evict(*Target);
+  }
+
+  if(Copied)
+  {
+    Context->Uploads->Flush();
+  }
+}
+
+void ResidencyManager::Update()
+{
+  Frame++;
+
+  Release(false);
+
+  bool Landed = false;
+
+  for(Entry& Target : Entries)
+  {
+    if(Target.State != Residency::Loading)
+    {
+      continue;
+    }
+
+    TextureState Loaded = Loader.State(Target.Handle);
+
+    if(Loaded == TextureState::Resident)
+    {
+      Image& Full = Loader.Get(Target.Handle);
+      Show(Target, Full, Full.Memory.Size);
+
+      // the trimmed copy was standing in during the reload
+      if(Target.HasTrimmed)
+      {
+        RetireImage(Target.Trimmed);
+        Target.HasTrimmed = false;
+      }
+
+      Target.State = Residency::Full;
+      Landed = true;
+    }
+    else if(Loaded == TextureState::Failed)
+    {
+      Target.State = Residency::Failed;
+    }
+  }
+
+  // the driver's numbers only move when something was allocated, no need to ask every frame
+  if(Landed || Frame % BudgetInterval == 0)
+  {
+    Budget = Context->Allocator->DeviceLocalBudget();
+    Rebalance();
+  }
+}
+
+void ResidencyManager::PrintStats() const
+{
+  std::cout << "Residency: " << ResidentBytes() / (1024 * 1024) << "MB in textures, device " << Budget.Usage / (1024 * 1024) << "MB of "
+            << Budget.Budget / (1024 * 1024) << "MB budget, " << TrimCount << " trimmed, " << EvictCount << " evicted, "
+            << ReloadCount << " reloaded\n";
+}
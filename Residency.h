@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Vulkan.h"
+#include "TextureLoader.h"
+
+// Keeps a TextureLoader's textures inside the device's memory budget.
+// When usage nears the budget, textures that haven't been drawn for a while first lose their top levels, then their
+// image altogether, least recently used first. Using one again decodes and uploads it in full, it shows its smaller copy
+// or the placeholder until then.
+// Nothing a pending frame can read is ever rewritten: a texture that changes image moves to a new table slot, and the
+// old slot and image are released once every frame that could sample them has retired. That means draws have to ask
+// Use() for the index every frame, like the quad batch does, instead of recording it once.
+class ResidencyManager
+{
+  public:
+  // Limit caps the managed textures' bytes on top of the device budget, 0 leaves it to the device.
+  ResidencyManager(TextureLoader& Loader, uint32_t FramesInFlight, float Anisotropy, VkDeviceSize Limit = 0);
+  // Destroy with the device idle.
+  ~ResidencyManager();
+
+  // Puts a loader handle under management and returns its id. It shows the placeholder until its load finishes.
+  uint32_t Add(uint32_t Handle);
+
+  // Marks the texture as drawn this frame and returns its table index for this frame, which can change between frames.
+  uint32_t Use(uint32_t Id);
+
+  // Picks up finished loads, releases what retired and trims back to the budget.
+  // Call once a frame after BeginFrame and the loader's Poll(), before any Use().
+  void Update();
+
+  VkDeviceSize ResidentBytes() const;
+  void PrintStats() const;
+
+  private:
+  enum class Residency
+  {
+    Loading,    // the loader is decoding it, the table shows the placeholder or the trimmed copy
+    Full,       // the loader's image, every level
+    Trimmed,    // our smaller copy without the top levels, the loader's image was given up
+    Evicted,    // the placeholder
+    Failed
+  };
+
+  struct Entry
+  {
+    uint32_t Handle;
+    uint32_t TableIndex;
+    Image Trimmed;          // owned while trimmed, and while reloading from trimmed
+    bool HasTrimmed;
+    VkDeviceSize Bytes;     // of the image TableIndex shows, 0 for the placeholder
+    uint64_t LastUsed;
+    Residency State;
+  };
+
+  struct Retired
+  {
+    Image Texture;
+    bool HasImage;
+    uint32_t TableIndex;    // the placeholder's index when there's no slot to release
+    uint64_t Frame;
+  };
+
+  // cold means not drawn for this many frames, only cold textures are trimmed or evicted
+  static const uint64_t MinIdleFrames = 60;
+  // textures are trimmed down to the first level no bigger than this
+  static const uint32_t TrimmedSize = 256;
+  static const uint32_t BudgetInterval = 16;
+
+  void Show(Entry& Target, const Image& Texture, VkDeviceSize Bytes);
+  void RetireSlot(uint32_t TableIndex);
+  void RetireImage(const Image& Texture);
+  void Release(bool All);
+
+  bool OverBudget(bool Trimming) const;
+  void Rebalance();
+  bool Trim(Entry& Target);
+  void Evict(Entry& Target);
+
+  TextureLoader& Loader;
+  uint32_t FramesInFlight;
+  VkDeviceSize Limit;
+
+  VkSampler Sampler;
+  uint32_t PlaceholderIndex;
+
+  std::vector<Entry> Entries;
+  std::deque<Retired> RetiredQueue;
+  VkDeviceSize RetiringBytes = 0;     // images in the queue, already counted in the device's usage
+
+  MemoryBudget Budget{};
+  uint64_t Frame = 0;
+
+  uint32_t TrimCount = 0;
+  uint32_t EvictCount = 0;
+  uint32_t ReloadCount = 0;
+};
@@ -0,0 +1,401 @@
+#include "Sequence.h"
+#include "MappedFile.h"
+#include "TextureFile.h"
+#include "TextureTable.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <stb/stb_image.h>
+
+static bool IsFile(const std::string& Path)
+{
+  struct stat Info;
+  return stat(Path.c_str(), &Info) == 0 && S_ISREG(Info.st_mode);
+}
+
+static std::vector<std::string> ListFrames(const std::string& Source)
+{
+  std::vector<std::string> Files;
+
+  if(Source.find('%') != std::string::npos)
+  {
+    // numbered from 0 or 1, whichever exists, up to the first gap
+    char Path[4096];
+    uint32_t First = 0;
+
+    snprintf(Path, sizeof(Path), Source.c_str(), 0);
+    if(!IsFile(Path))
+    {
+      First = 1;
+    }
+
+    for(uint32_t i = First;; i++)
+    {
+      snprintf(Path, sizeof(Path), Source.c_str(), i);
+      if(!IsFile(Path))
+      {
+        break;
+      }
+
+      Files.push_back(Path);
+    }
+
+    return Files;
+  }
+
+  DIR* Directory = opendir(Source.c_str());
+  if(!Directory)
+  {
+    throw std::runtime_error("Failed to open sequence directory " + Source);
+  }
+
+  while(dirent* Entry = readdir(Directory))
+  {
+    std::string Path = Source + "/" + Entry->d_name;
+
+    if(Entry->d_name[0] != '.' && IsFile(Path))
+    {
+      Files.push_back(Path);
+    }
+  }
+
+  closedir(Directory);
+
+  // zero padded numbering sorts the same by name
+  std::sort(Files.begin(), Files.end());
+
+  return Files;
+}
+
+SequencePlayer::SequencePlayer(const std::string& Source, float Fps, uint32_t PrefetchCount, uint32_t FramesInFlight, float Anisotropy, uint32_t WorkerCount)
+  : Fps(Fps), FramesInFlight(FramesInFlight), Completed(std::max(1u, PrefetchCount)), Workers(WorkerCount)
+{
+  Files = ListFrames(Source);
+
+  if(Files.empty())
+  {
+    throw std::runtime_error("No frames found for sequence " + Source);
+  }
+
+  // the first frame sizes every staging buffer and texture
+  {
+    std::string Error;
+    MappedFile Encoded;
+    int Width, Height;
+
+    if(!Encoded.Open(Files[0], FileAccess::Sequential, Error))
+    {
+      throw std::runtime_error("Failed to open " + Files[0] + ": " + Error);
+    }
+
+    if(!ImageSize(Encoded, Width, Height, Error))
+    {
+      throw std::runtime_error("Failed to read " + Files[0] + ": " + Error);
+    }
+
+    FrameWidth = Width;
+    FrameHeight = Height;
+  }
+
+  VkCommandPoolCreateInfo PoolCI{};
+  PoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  PoolCI.queueFamilyIndex = Context->TransferFamily;
+  PoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  if(vkCreateCommandPool(Context->Device, &PoolCI, nullptr, &Pool) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create a command pool");
+  }
+
+  // Staging
+    Slots.resize(std::max(1u, PrefetchCount));
+
+    std::vector<VkCommandBuffer> Cmds(Slots.size());
+
+    VkCommandBufferAllocateInfo CmdAllocInfo{};
+    CmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    CmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    CmdAllocInfo.commandPool = Pool;
+    CmdAllocInfo.commandBufferCount = Cmds.size();
+
+    if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, Cmds.data()) != VK_SUCCESS)
+    {
+      throw std::runtime_error("failed to create command buffers");
+    }
+
+    for(uint32_t i = 0; i < Slots.size(); i++)
+    {
+      StagingSlot& Target = Slots[i];
+      Target = StagingSlot{};
+      Target.Staging = CreateStagingBuffer(VkDeviceSize(FrameWidth) * FrameHeight * 4);
+      Target.Cmd = Cmds[i];
+      Target.State = SlotState::Free;
+    }
+  // Staging
+
+  // Textures
+    // three at the default two frames in flight, so the copy for the next frame never waits on the ones still drawing.
+    // Written on the transfer queue and sampled on graphics, shared so nothing changes ownership
+    Textures.resize(std::max(3u, FramesInFlight + 1));
+
+    Sampler = CreateSampler(1, Anisotropy);
+
+    for(RingTexture& Target : Textures)
+    {
+      Target = RingTexture{};
+      Target.Texture = CreateSampledImage(VK_FORMAT_R8G8B8A8_SRGB, FrameWidth, FrameHeight, 1, 0, true);
+
+      // the descriptor is written once, in the layout every copy leaves it in. Nothing samples it before the first one
+      Target.Texture.CurrentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      Target.TableIndex = Context->Textures->Register(Target.Texture, Sampler);
+    }
+  // Textures
+}
+
+SequencePlayer::~SequencePlayer()
+{
+  Workers.WaitIdle();
+
+  for(StagingSlot& Target : Slots)
+  {
+    DestroyBuffer(Target.Staging);
+  }
+
+  for(RingTexture& Target : Textures)
+  {
+    Context->Textures->Release(Target.TableIndex);
+    DestroyImage(Target.Texture);
+  }
+
+  vkDestroySampler(Context->Device, Sampler, nullptr);
+  vkDestroyCommandPool(Context->Device, Pool, nullptr);
+}
+
+void SequencePlayer::Decode(uint32_t Index, uint64_t SequenceFrame)
+{
+  StagingSlot& Target = Slots[Index];
+  Target.State = SlotState::Decoding;
+  Target.Failed = false;
+  Target.Frame = SequenceFrame;
+
+  Workers.Submit([this, Index, File = Files[SequenceFrame % Files.size()], Staging = Target.Staging, Queued = std::chrono::steady_clock::now()]
+  {
+    DecodedFrame Result{};
+    Result.Slot = Index;
+
+    MappedFile Encoded;
+    unsigned char* Pixels = nullptr;
+    PixelConversion Layout;
+    int Width = 0, Height = 0;
+
+    if(Encoded.Open(File, FileAccess::Sequential, Result.Error))
+    {
+      // RGB and 16 bit are widened by the conversion into staging
+      Pixels = DecodeImage(Encoded, Layout, Width, Height, Result.Error);
+
+      if(Pixels && (uint32_t(Width) != FrameWidth || uint32_t(Height) != FrameHeight))
+      {
+        Result.Error = "frame is " + std::to_string(Width) + "x" + std::to_string(Height) + ", the sequence is " +
+                       std::to_string(FrameWidth) + "x" + std::to_string(FrameHeight);
+      }
+      else if(Pixels)
+      {
+        // the slot is ours until the render thread has copied out of it, write-combined so only written, never read
+        ConvertPixels(Pixels, uint64_t(Width) * Layout.SourceTexelSize(), Staging.Memory.Mapped, uint64_t(Width) * 4, Width, Height, Layout);
+        Context->Allocator->Flush(Staging.Memory, 0, uint64_t(Width) * Height * 4);
+      }
+
+      stbi_image_free(Pixels);
+    }
+
+    Result.Failed = !Result.Error.empty();
+    Result.Error = Result.Failed ? File + ": " + Result.Error : std::string();
+    Result.Latency = std::chrono::steady_clock::now() - Queued;
+
+    // one result per slot at most, the queue has room for every slot
+    while(!Completed.Push(std::move(Result)))
+    {
+      std::this_thread::yield();
+    }
+  });
+}
+
+void SequencePlayer::Upload(StagingSlot& Source)
+{
+  RingTexture& Target = Textures[CurrentTexture];
+
+  // Barriers
+    // the whole image is replaced and the frames that sampled it have retired, nothing to wait for or keep
+    VkImageMemoryBarrier ToCopy{};
+    ToCopy.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    ToCopy.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    ToCopy.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    ToCopy.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ToCopy.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ToCopy.image = Target.Texture.Image;
+    ToCopy.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    ToCopy.srcAccessMask = 0;
+    ToCopy.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    VkImageMemoryBarrier ToSampled = ToCopy;
+    ToSampled.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    ToSampled.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    ToSampled.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    ToSampled.dstAccessMask = 0;
+  // Barriers
+
+  VkBufferImageCopy Region{};
+  Region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+  Region.imageExtent = VkExtent3D{FrameWidth, FrameHeight, 1};
+
+  VkCommandBufferBeginInfo BeginInf{};
+  BeginInf.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  BeginInf.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  // the first barrier starts from the top of the pipe, so the copy isn't held behind anything else on its queue.
+  // The frame's wait on the copy's point makes the writes visible to its fragment shaders, the last barrier only changes layout
+  vkBeginCommandBuffer(Source.Cmd, &BeginInf);
+    vkCmdPipelineBarrier(Source.Cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &ToCopy);
+
+    vkCmdCopyBufferToImage(Source.Cmd, Source.Staging.Buffer, Target.Texture.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Region);
+
+    vkCmdPipelineBarrier(Source.Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &ToSampled);
+  vkEndCommandBuffer(Source.Cmd);
+
+  // the same queue as graphics when the device has no transfer family, ordered ahead of the frame either way
+  LastUpload = Context->Sync->Submit(QueueKind::Transfer, Source.Cmd);
+
+  Target.Written = true;
+
+  Source.State = SlotState::Copying;
+  Source.Copied = LastUpload;
+}
+
+void SequencePlayer::Update(uint64_t Frame)
+{
+  // Release
+    for(StagingSlot& Target : Slots)
+    {
+      if(Target.State == SlotState::Copying && Context->Sync->Reached(Target.Copied))
+      {
+        Target.State = SlotState::Free;
+      }
+    }
+  // Release
+
+  DecodedFrame Result;
+  while(Completed.Pop(Result))
+  {
+    StagingSlot& Target = Slots[Result.Slot];
+    Target.State = SlotState::Ready;
+    Target.Failed = Result.Failed;
+
+    Decoded++;
+    LatencyTotal += Result.Latency;
+    LatencyMax = std::max(LatencyMax, Result.Latency);
+
+    if(Result.Failed && Failed++ == 0)
+    {
+      FirstError = Result.Error;
+    }
+  }
+
+  // the clock starts with the first frame on screen, start up isn't counted as dropping frames
+  uint64_t Due = Shown;
+  if(Fps > 0.f && Showing())
+  {
+    Due = std::chrono::duration<double>(std::chrono::steady_clock::now() - PlayStart).count() * Fps;
+  }
+
+  // Show
+    // the newest frame that's due, anything older that's ready was passed over
+    StagingSlot* Newest = nullptr;
+
+    for(StagingSlot& Target : Slots)
+    {
+      if(Target.State == SlotState::Ready && Target.Frame >= Shown && Target.Frame <= Due && (!Newest || Target.Frame > Newest->Frame))
+      {
+        Newest = &Target;
+      }
+    }
+
+    uint32_t Next = Showing() ? (CurrentTexture + 1) % Textures.size() : CurrentTexture;
+    const RingTexture& NextTexture = Textures[Next];
+
+    // a failed frame is skipped without an upload, the last image stays up
+    if(Newest && (Newest->Failed || !NextTexture.Written || NextTexture.LastUsed + FramesInFlight <= Frame))
+    {
+      Dropped += Newest->Frame - Shown;
+      Shown = Newest->Frame + 1;
+
+      if(Newest->Failed)
+      {
+        Newest->State = SlotState::Free;
+      }
+      else
+      {
+        if(!Showing())
+        {
+          PlayStart = std::chrono::steady_clock::now();
+        }
+        else
+        {
+          // sampled up to the frame before this one
+          Textures[CurrentTexture].LastUsed = Frame - 1;
+        }
+
+        CurrentTexture = Next;
+        Upload(*Newest);
+        ShownCount++;
+      }
+    }
+
+    for(StagingSlot& Target : Slots)
+    {
+      if(Target.State == SlotState::Ready && Target.Frame < Shown)
+      {
+        Target.State = SlotState::Free;
+      }
+    }
+
+    if(Showing() && Due >= Shown)
+    {
+      Late++;
+    }
+  // Show
+
+  // Prefetch
+    // never decode what's already overdue
+    NextDecode = std::max(NextDecode, std::max(Due, Shown));
+
+    for(uint32_t i = 0; i < Slots.size(); i++)
+    {
+      if(Slots[i].State == SlotState::Free)
+      {
+        Decode(i, NextDecode++);
+      }
+    }
+  // Prefetch
+}
+
+void SequencePlayer::PrintStats() const
+{
+  double AverageMs = Decoded > 0 ? std::chrono::duration<double, std::milli>(LatencyTotal).count() / Decoded : 0.0;
+  double MaxMs = std::chrono::duration<double, std::milli>(LatencyMax).count();
+
+  std::cout << "Sequence: " << Files.size() << " files at " << FrameWidth << "x" << FrameHeight << ", " << Slots.size() << " staging buffers, "
+            << Textures.size() << " textures, " << Workers.WorkerCount() << " decoders\n";
+  std::cout << "  " << ShownCount << " frames shown, " << Dropped << " dropped, " << Late << " rendered frames waiting on a late decode\n";
+  std::cout << "  decode latency " << AverageMs << " ms average, " << MaxMs << " ms max over " << Decoded << " frames\n";
+
+  if(Failed > 0)
+  {
+    std::cout << "  " << Failed << " failed, first: " << FirstError << '\n';
+  }
+}
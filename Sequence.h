@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Vulkan.h"
+#include "ThreadPool.h"
+#include "PixelConvert.h"
+#include "Timeline.h"
+
+// Plays a numbered image sequence as a texture, looping at the end.
+// Workers decode up to PrefetchCount frames ahead, each straight into its own persistently mapped staging buffer. Once a
+// frame is due, its copy goes into the next of a small ring of textures on the transfer queue, alongside the frames in
+// flight that keep sampling the older ones, and the frame waits for the copy's timeline point. A staging buffer is
+// reused once its copy's point is reached and a texture once the frames that sampled it have retired, which BeginFrame
+// has already waited for, so nothing ever waits on the device.
+// The texture shown changes between frames, draws ask Current() for its index every frame.
+class SequencePlayer
+{
+  public:
+  // Source is a printf pattern like "frames/%05d.png", counted up from 0 or 1 until a file is missing, or a directory whose
+  // files play in name order. Every frame must be the size of the first. Fps of 0 shows the next frame every frame.
+  SequencePlayer(const std::string& Source, float Fps, uint32_t PrefetchCount, uint32_t FramesInFlight, float Anisotropy, uint32_t WorkerCount = 0);
+  // Destroy with the device idle.
+  ~SequencePlayer();
+
+  // Shows the newest decoded frame that's due and queues decodes into the free staging buffers.
+  // Call once a frame after BeginFrame, with the scheduler's FrameCount(). The frame waits for Uploaded().
+  void Update(uint64_t Frame);
+
+  // The latest copy into the ring, reached once Current() is ready to sample.
+  SyncPoint Uploaded() const { return LastUpload; }
+
+  // Nothing is shown until the first frame is decoded.
+  bool Showing() const { return Textures[CurrentTexture].Written; }
+  // Table index of the texture to draw this frame.
+  uint32_t Current() const { return Textures[CurrentTexture].TableIndex; }
+
+  uint32_t Width() const { return FrameWidth; }
+  uint32_t Height() const { return FrameHeight; }
+
+  void PrintStats() const;
+
+  private:
+  enum class SlotState
+  {
+    Free,
+    Decoding,
+    Ready,
+    Copying     // until its copy's point is reached
+  };
+
+  struct StagingSlot
+  {
+    Buffer Staging;
+    VkCommandBuffer Cmd;
+    SlotState State;
+    bool Failed;          // ready but empty, the frame is skipped
+    uint64_t Frame;       // sequence frame it holds, counting on through every loop
+    SyncPoint Copied;
+  };
+
+  struct RingTexture
+  {
+    Image Texture;
+    uint32_t TableIndex;
+    bool Written;
+    uint64_t LastUsed;    // last frame that sampled it
+  };
+
+  struct DecodedFrame
+  {
+    uint32_t Slot;
+    bool Failed;
+    std::chrono::steady_clock::duration Latency;   // from queueing to the pixels sitting in staging
+    std::string Error;
+  };
+
+  void Decode(uint32_t Index, uint64_t SequenceFrame);
+  void Upload(StagingSlot& Source);
+
+  std::vector<std::string> Files;
+  float Fps;
+  uint32_t FramesInFlight;
+  uint32_t FrameWidth;
+  uint32_t FrameHeight;
+
+  VkCommandPool Pool;
+  VkSampler Sampler;
+  std::vector<StagingSlot> Slots;
+  std::vector<RingTexture> Textures;
+  uint32_t CurrentTexture = 0;
+  SyncPoint LastUpload;
+
+  // sequence frames, Shown is one past the last one shown or skipped because it failed to decode
+  uint64_t Shown = 0;
+  uint64_t NextDecode = 0;
+  std::chrono::steady_clock::time_point PlayStart;
+
+  uint64_t ShownCount = 0;
+  uint64_t Dropped = 0;       // due frames that were never shown, decoded too late or passed over
+  uint64_t Late = 0;          // rendered frames that repeated the last image because the due one wasn't decoded yet
+  uint64_t Failed = 0;
+  std::string FirstError;
+  uint64_t Decoded = 0;
+  std::chrono::steady_clock::duration LatencyTotal{};
+  std::chrono::steady_clock::duration LatencyMax{};
+
+  CompletionQueue<DecodedFrame> Completed;
+
+  // declared last so workers are joined before the queue they push into is destroyed
+  ThreadPool Workers;
+};
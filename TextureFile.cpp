@@ -0,0 +1,400 @@
+#include "TextureFile.h"
+#include "Vulkan.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include <stb/stb_image.h>
+
+FormatBlock GetFormatBlock(VkFormat Format)
+{
+  switch(Format)
+  {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      return {4, 1, 1};
+
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+      return {8, 4, 4};
+
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+      return {16, 4, 4};
+
+    case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+      return {16, 6, 6};
+
+    case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+      return {16, 8, 8};
+
+    default:
+      return {0, 0, 0};
+  }
+}
+
+bool IsContainerFile(const std::string& Path)
+{
+  std::string Extension = Path.substr(Path.find_last_of('.') + 1);
+  std::transform(Extension.begin(), Extension.end(), Extension.begin(), ::tolower);
+
+  return Extension == "ktx2" || Extension == "dds";
+}
+
+static uint64_t LevelSize(const FormatBlock& Block, uint32_t Width, uint32_t Height)
+{
+  return (uint64_t)((Width + Block.Width - 1) / Block.Width) * ((Height + Block.Height - 1) / Block.Height) * Block.Size;
+}
+
+template<typename T>
+static T Read(const MappedFile& Data, size_t Offset)
+{
+  T Value;
+  memcpy(&Value, Data.Data() + Offset, sizeof(T));
+  return Value;
+}
+
+// a full chain down to 1x1, a file claiming more levels than this is corrupt
+static uint32_t MaxLevelCount(uint32_t Width, uint32_t Height)
+{
+  uint32_t Count = 1;
+
+  for(uint32_t Size = std::max(Width, Height); Size > 1; Size >>= 1)
+  {
+    Count++;
+  }
+
+  return Count;
+}
+
+// KTX2 spec section 3, everything little endian
+static bool ParseKTX2(CompressedImage& Out, std::string& Error)
+{
+  const MappedFile& Data = Out.File;
+
+  if(Data.Size() < 80)
+  {
+    Error = "truncated KTX2 header";
+    return false;
+  }
+
+  Out.Format = (VkFormat)Read<uint32_t>(Data, 12);
+  Out.Width = Read<uint32_t>(Data, 20);
+  Out.Height = Read<uint32_t>(Data, 24);
+  uint32_t Depth = Read<uint32_t>(Data, 28);
+  uint32_t Layers = Read<uint32_t>(Data, 32);
+  uint32_t Faces = Read<uint32_t>(Data, 36);
+  uint32_t LevelCount = std::max(Read<uint32_t>(Data, 40), 1u);
+  uint32_t Supercompression = Read<uint32_t>(Data, 44);
+
+  if(Supercompression != 0)
+  {
+    Error = "supercompressed KTX2 is not supported";
+    return false;
+  }
+
+  if(Depth > 1 || Layers > 1 || Faces != 1)
+  {
+    Error = "only single 2D textures are supported";
+    return false;
+  }
+
+  Out.Block = GetFormatBlock(Out.Format);
+  if(Out.Block.Size == 0)
+  {
+    Error = "unsupported KTX2 format " + std::to_string(Out.Format);
+    return false;
+  }
+
+  if(LevelCount > MaxLevelCount(Out.Width, Out.Height))
+  {
+    Error = "KTX2 has " + std::to_string(LevelCount) + " levels, more than its size allows";
+    return false;
+  }
+
+  if(Data.Size() < 80 + uint64_t(LevelCount) * 24)
+  {
+    Error = "truncated KTX2 level index";
+    return false;
+  }
+
+  for(uint32_t i = 0; i < LevelCount; i++)
+  {
+    MipLevel Level;
+    Level.Offset = Read<uint64_t>(Data, 80 + i * 24);
+    Level.Size = Read<uint64_t>(Data, 80 + i * 24 + 8);
+    Level.Width = std::max(Out.Width >> i, 1u);
+    Level.Height = std::max(Out.Height >> i, 1u);
+
+    // both come from the file, checked so their sum can't wrap
+    if(Level.Offset > Data.Size() || Level.Size > Data.Size() - Level.Offset || Level.Size != LevelSize(Out.Block, Level.Width, Level.Height))
+    {
+      Error = "KTX2 level " + std::to_string(i) + " is out of bounds or the wrong size";
+      return false;
+    }
+
+    Out.Levels.push_back(Level);
+  }
+
+  return true;
+}
+
+static VkFormat FromDXGI(uint32_t Format)
+{
+  switch(Format)
+  {
+    case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+    case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+    case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+    case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+    case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+    case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+    case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+    default: return VK_FORMAT_UNDEFINED;
+  }
+}
+
+static uint32_t FourCC(const char* Code)
+{
+  return Code[0] | (Code[1] << 8) | (Code[2] << 16) | (Code[3] << 24);
+}
+
+// "DDS " then the 124 byte DDS_HEADER, then DDS_HEADER_DXT10 if the pixel format's fourCC is DX10
+static bool ParseDDS(CompressedImage& Out, std::string& Error)
+{
+  const MappedFile& Data = Out.File;
+
+  if(Data.Size() < 128)
+  {
+    Error = "truncated DDS header";
+    return false;
+  }
+
+  Out.Height = Read<uint32_t>(Data, 12);
+  Out.Width = Read<uint32_t>(Data, 16);
+  uint32_t LevelCount = std::max(Read<uint32_t>(Data, 28), 1u);
+  uint32_t PixelFlags = Read<uint32_t>(Data, 80);
+  uint32_t Code = Read<uint32_t>(Data, 84);
+  uint32_t Caps2 = Read<uint32_t>(Data, 112);
+
+  size_t DataOffset = 128;
+
+  if(Caps2 & 0x200)
+  {
+    Error = "DDS cube maps are not supported";
+    return false;
+  }
+
+  // DDPF_FOURCC, uncompressed DDS without a DX10 header is left to stb
+  if(!(PixelFlags & 0x4))
+  {
+    Error = "DDS without a fourCC format is not supported";
+    return false;
+  }
+
+  if(Code == FourCC("DX10"))
+  {
+    if(Data.Size() < 148)
+    {
+      Error = "truncated DDS DX10 header";
+      return false;
+    }
+
+    uint32_t Dimension = Read<uint32_t>(Data, 132);
+    uint32_t ArraySize = Read<uint32_t>(Data, 140);
+
+    if(Dimension != 3 || ArraySize > 1)
+    {
+      Error = "only single 2D DDS textures are supported";
+      return false;
+    }
+
+    Out.Format = FromDXGI(Read<uint32_t>(Data, 128));
+    DataOffset = 148;
+  }
+  else if(Code == FourCC("DXT1"))
+  {
+    Out.Format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  }
+  else if(Code == FourCC("DXT5"))
+  {
+    Out.Format = VK_FORMAT_BC3_UNORM_BLOCK;
+  }
+  else if(Code == FourCC("ATI2") || Code == FourCC("BC5U"))
+  {
+    Out.Format = VK_FORMAT_BC5_UNORM_BLOCK;
+  }
+  else
+  {
+    Out.Format = VK_FORMAT_UNDEFINED;
+  }
+
+  Out.Block = GetFormatBlock(Out.Format);
+  if(Out.Block.Size == 0)
+  {
+    Error = "unsupported DDS format";
+    return false;
+  }
+
+  if(LevelCount > MaxLevelCount(Out.Width, Out.Height))
+  {
+    Error = "DDS has " + std::to_string(LevelCount) + " levels, more than its size allows";
+    return false;
+  }
+
+  // levels are packed back to back, largest first
+  uint64_t Offset = DataOffset;
+
+  for(uint32_t i = 0; i < LevelCount; i++)
+  {
+    MipLevel Level;
+    Level.Width = std::max(Out.Width >> i, 1u);
+    Level.Height = std::max(Out.Height >> i, 1u);
+    Level.Offset = Offset;
+    Level.Size = LevelSize(Out.Block, Level.Width, Level.Height);
+
+    if(Level.Offset + Level.Size > Data.Size())
+    {
+      Error = "DDS level " + std::to_string(i) + " is truncated";
+      return false;
+    }
+
+    Out.Levels.push_back(Level);
+    Offset += Level.Size;
+  }
+
+  return true;
+}
+
+bool LoadContainer(const std::string& Path, CompressedImage& Out, std::string& Error)
+{
+  // the worker only parses the header, start reading the levels in before the render thread copies them out
+  if(!Out.File.Open(Path, FileAccess::WillNeed, Error))
+  {
+    return false;
+  }
+
+  Out.Levels.clear();
+
+  static const uint8_t KTX2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+  bool Parsed;
+  if(Out.File.Size() >= 12 && memcmp(Out.File.Data(), KTX2Identifier, 12) == 0)
+  {
+    Parsed = ParseKTX2(Out, Error);
+  }
+  else if(Out.File.Size() >= 4 && memcmp(Out.File.Data(), "DDS ", 4) == 0)
+  {
+    Parsed = ParseDDS(Out, Error);
+  }
+  else
+  {
+    Error = "not a KTX2 or DDS file";
+    return false;
+  }
+
+  if(!Parsed)
+  {
+    return false;
+  }
+
+  if(Out.Width == 0 || Out.Height == 0)
+  {
+    Error = "zero sized texture";
+    return false;
+  }
+
+  // no CPU decode path, the data goes to the GPU as is or not at all
+  VkFormatProperties Props;
+  vkGetPhysicalDeviceFormatProperties(Context->PhysicalDevice, Out.Format, &Props);
+
+  VkFormatFeatureFlags Needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  if((Props.optimalTilingFeatures & Needed) != Needed)
+  {
+    Error = "format " + std::to_string(Out.Format) + " can't be sampled on this device";
+    return false;
+  }
+
+  return true;
+}
+
+bool ImageSize(const MappedFile& Encoded, int& Width, int& Height, std::string& Error)
+{
+  // stb takes the size as an int, a larger file would be read truncated
+  if(Encoded.Size() > INT_MAX)
+  {
+    Error = "files over 2 GB can't be decoded";
+    return false;
+  }
+
+  int Channels;
+
+  if(!stbi_info_from_memory(Encoded.Data(), (int)Encoded.Size(), &Width, &Height, &Channels))
+  {
+    Error = stbi_failure_reason();
+    return false;
+  }
+
+  if(uint64_t(Width) * Height * 4 > INT_MAX)
+  {
+    Error = std::to_string(Width) + "x" + std::to_string(Height) + " is over 2 GB as RGBA, too large to decode";
+    return false;
+  }
+
+  return true;
+}
+
+unsigned char* DecodeImage(const MappedFile& Encoded, PixelConversion& Layout, int& Width, int& Height, std::string& Error)
+{
+  if(!ImageSize(Encoded, Width, Height, Error))
+  {
+    return nullptr;
+  }
+
+  const stbi_uc* Data = Encoded.Data();
+  int Size = (int)Encoded.Size();
+  int Channels;
+  unsigned char* Pixels;
+
+  Layout = PixelConversion{};
+
+  if(stbi_is_16_bit_from_memory(Data, Size))
+  {
+    Pixels = (unsigned char*)stbi_load_16_from_memory(Data, Size, &Width, &Height, &Channels, STBI_rgb_alpha);
+    Layout.Source16 = true;
+  }
+  else if(stbi_info_from_memory(Data, Size, &Width, &Height, &Channels) && Channels == 3)
+  {
+    Pixels = stbi_load_from_memory(Data, Size, &Width, &Height, &Channels, STBI_rgb);
+    Layout.SourceChannels = 3;
+  }
+  else
+  {
+    Pixels = stbi_load_from_memory(Data, Size, &Width, &Height, &Channels, STBI_rgb_alpha);
+  }
+
+  if(!Pixels)
+  {
+    Error = stbi_failure_reason();
+  }
+
+  return Pixels;
+}
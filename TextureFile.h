@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "MappedFile.h"
+#include "PixelConvert.h"
+
+// Bytes per block and block size in texels. Uncompressed formats are 1x1 blocks.
+struct FormatBlock
+{
+  uint32_t Size;
+  uint32_t Width;
+  uint32_t Height;
+};
+
+struct MipLevel
+{
+  uint64_t Offset;   // into CompressedImage::Data
+  uint64_t Size;
+  uint32_t Width;
+  uint32_t Height;
+};
+
+// A pre-baked texture exactly as the GPU wants it, every mip level already encoded.
+struct CompressedImage
+{
+  VkFormat Format;
+  uint32_t Width;
+  uint32_t Height;
+  FormatBlock Block;
+  std::vector<MipLevel> Levels;   // largest first
+  MappedFile File;                // the whole container, level offsets point into it and upload straight from it
+};
+
+// Block layout of the formats the container loaders accept, Size is 0 for anything else.
+FormatBlock GetFormatBlock(VkFormat Format);
+
+// True if Path ends in .ktx2 or .dds.
+bool IsContainerFile(const std::string& Path);
+
+// Parses a KTX2 or DDS file into Out. Returns false with Error set for malformed files, supercompressed KTX2,
+// cube maps/arrays/3D textures, and formats this device can't sample from.
+bool LoadContainer(const std::string& Path, CompressedImage& Out, std::string& Error);
+
+// Size of an image stb can decode, without decoding it. Returns false with Error set if stb can't read it, or if the file
+// or its RGBA8 pixels are over 2 GB, which stb can't address.
+bool ImageSize(const MappedFile& Encoded, int& Width, int& Height, std::string& Error);
+
+// Decodes a PNG, JPEG or anything else stb reads straight out of its mapping. RGB and 16 bit images stay as they are and
+// Layout says so, ConvertPixels widens them on their way to RGBA8 instead of stb doing it a texel at a time. Grey and
+// grey-alpha are rare, stb still expands those. Returns null with Error set on failure, free with stbi_image_free.
+unsigned char* DecodeImage(const MappedFile& Encoded, PixelConversion& Layout, int& Width, int& Height, std::string& Error);
@@ -0,0 +1,217 @@
+#include "TextureLoader.h"
+#include "Upload.h"
+#include "MappedFile.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#include <stb/stb_image.h>
+
+TextureLoader::TextureLoader(uint32_t WorkerCount) : Completed(256), Workers(WorkerCount)
+{
+  uint8_t White[4] = { 255, 255, 255, 255 };
+  Placeholder = CreateTexture(White, 1, 1);
+
+  Context->Uploads->Flush();
+}
+
+TextureLoader::~TextureLoader()
+{
+  Stopping = true;
+  Workers.WaitIdle();
+
+  // free anything that was decoded but never uploaded
+  DecodedImage Leftover;
+  while(Completed.Pop(Leftover))
+  {
+    stbi_image_free(Leftover.Pixels);
+    delete Leftover.Compressed;
+  }
+
+  for(Slot& Texture : Slots)
+  {
+    if(Texture.State == TextureState::Resident)
+    {
+      DestroyImage(Texture.Texture);
+    }
+  }
+
+  DestroyImage(Placeholder);
+}
+
+uint32_t TextureLoader::Load(const char* Path)
+{
+  uint32_t Handle = Slots.size();
+
+  Slot NewSlot{};
+  NewSlot.State = TextureState::Pending;
+  NewSlot.Path = Path;
+  Slots.push_back(NewSlot);
+
+  Queue(Handle);
+
+  return Handle;
+}
+
+Image TextureLoader::Evict(uint32_t Handle)
+{
+  if(State(Handle) != TextureState::Resident)
+  {
+    throw std::runtime_error("Evicting a texture that isn't resident");
+  }
+
+  Slots[Handle].State = TextureState::Evicted;
+
+  return Slots[Handle].Texture;
+}
+
+void TextureLoader::Reload(uint32_t Handle)
+{
+  if(State(Handle) != TextureState::Evicted)
+  {
+    throw std::runtime_error("Reloading a texture that wasn't evicted");
+  }
+
+  Slots[Handle].State = TextureState::Pending;
+  Queue(Handle);
+}
+
+void TextureLoader::Queue(uint32_t Handle)
+{
+  Pending++;
+
+  Workers.Submit([this, Handle, File = Slots[Handle].Path]
+  {
+    if(Stopping)
+    {
+      return;
+    }
+
+    DecodedImage Result{};
+    Result.Handle = Handle;
+
+    if(IsContainerFile(File))
+    {
+      // already in its GPU format, nothing to decode
+      CompressedImage* Compressed = new CompressedImage();
+
+      if(LoadContainer(File, *Compressed, Result.Error))
+      {
+        Result.Compressed = Compressed;
+        Result.Width = Compressed->Width;
+        Result.Height = Compressed->Height;
+      }
+      else
+      {
+        delete Compressed;
+      }
+    }
+    else
+    {
+      // stb decodes out of the page cache, no stdio buffer and no copy of the encoded file
+      MappedFile Encoded;
+
+      if(Encoded.Open(File, FileAccess::Sequential, Result.Error))
+      {
+        int Width, Height;
+
+        // RGB and 16 bit images stay as they are, the upload widens them with SIMD on the way into the ring
+        Result.Pixels = DecodeImage(Encoded, Result.Layout, Width, Height, Result.Error);
+
+        if(Result.Pixels)
+        {
+          Result.Width = Width;
+          Result.Height = Height;
+        }
+      }
+    }
+
+    // the render thread drains this every frame, so a full queue only means it's behind
+    while(!Completed.Push(std::move(Result)))
+    {
+      if(Stopping)
+      {
+        stbi_image_free(Result.Pixels);
+        delete Result.Compressed;
+        return;
+      }
+
+      std::this_thread::yield();
+    }
+  });
+}
+
+uint32_t TextureLoader::Poll(uint32_t MaxUploads)
+{
+  uint32_t Uploaded = 0;
+  DecodedImage Decoded;
+
+  while(Uploaded < MaxUploads && Completed.Pop(Decoded))
+  {
+    Slot& Target = Slots[Decoded.Handle];
+    Pending--;
+
+    if(!Decoded.Pixels && !Decoded.Compressed)
+    {
+      std::cout << "Failed to load " << Target.Path << ": " << (Decoded.Error.empty() ? "unknown error" : Decoded.Error) << '\n';
+      Target.State = TextureState::Failed;
+      continue;
+    }
+
+    if(Decoded.Compressed)
+    {
+      Target.Texture = CreateCompressedTexture(*Decoded.Compressed);
+      delete Decoded.Compressed;
+    }
+    else
+    {
+      Target.Texture = CreateTexture(Decoded.Pixels, Decoded.Width, Decoded.Height, Decoded.Layout);
+      stbi_image_free(Decoded.Pixels);
+    }
+
+    Target.State = TextureState::Resident;
+
+    Uploaded++;
+  }
+
+  // everything uploaded this frame goes to the GPU as one submission
+  Context->Uploads->Flush();
+
+  return Uploaded;
+}
+
+void TextureLoader::WaitAll()
+{
+  while(Pending > 0)
+  {
+    if(Poll() == 0)
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+Image& TextureLoader::Get(uint32_t Handle)
+{
+  if(Handle >= Slots.size())
+  {
+    throw std::runtime_error("Invalid texture handle");
+  }
+
+  if(Slots[Handle].State != TextureState::Resident)
+  {
+    return Placeholder;
+  }
+
+  return Slots[Handle].Texture;
+}
+
+TextureState TextureLoader::State(uint32_t Handle) const
+{
+  if(Handle >= Slots.size())
+  {
+    throw std::runtime_error("Invalid texture handle");
+  }
+
+  return Slots[Handle].State;
+}
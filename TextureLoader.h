@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Vulkan.h"
+#include "ThreadPool.h"
+#include "TextureFile.h"
+
+enum class TextureState
+{
+  Pending,
+  Resident,
+  Failed,
+  Evicted     // given up to make room, Reload() decodes it again
+};
+
+// Pixels handed from a decode worker back to the render thread. KTX2/DDS files skip decoding and come back in Compressed.
+struct DecodedImage
+{
+  uint32_t Handle;
+  unsigned char* Pixels;
+  PixelConversion Layout;        // what Pixels hold, expanded to RGBA8 while they're copied to the staging ring
+  CompressedImage* Compressed;
+  uint32_t Width;
+  uint32_t Height;
+  std::string Error;
+};
+
+// Decodes images on a worker pool and uploads them on the render thread as they finish.
+// Until a texture is resident, Get() returns a 1x1 placeholder so descriptors always have something valid to point at.
+class TextureLoader
+{
+  public:
+  TextureLoader(uint32_t WorkerCount = 0);
+  ~TextureLoader();
+
+  // Queues Path for decoding and returns a handle to it. Returns immediately, the file is opened on a worker.
+  uint32_t Load(const char* Path);
+
+  // Uploads up to MaxUploads finished decodes, returns how many became resident. Call once per frame on the render thread.
+  uint32_t Poll(uint32_t MaxUploads = UINT32_MAX);
+
+  // Blocks until every queued texture is either resident or failed.
+  void WaitAll();
+
+  // Hands a resident texture's image over to the caller, who destroys it once nothing samples it anymore.
+  // Get() returns the placeholder until the texture is reloaded.
+  Image Evict(uint32_t Handle);
+  // Queues an evicted texture for decoding again from its path, it comes back through Poll() like a new load.
+  void Reload(uint32_t Handle);
+
+  Image& Get(uint32_t Handle);
+  // The 1x1 image Get() falls back to.
+  const Image& PlaceholderTexture() const { return Placeholder; }
+  TextureState State(uint32_t Handle) const;
+  bool IsResident(uint32_t Handle) const { return State(Handle) == TextureState::Resident; }
+
+  uint32_t PendingCount() const { return Pending; }
+
+  private:
+  void Queue(uint32_t Handle);
+
+  struct Slot
+  {
+    Image Texture;
+    TextureState State;
+    std::string Path;
+  };
+
+  CompletionQueue<DecodedImage> Completed;
+  std::vector<Slot> Slots;
+  Image Placeholder;
+  uint32_t Pending = 0;
+
+  // set by the destructor, workers drop what they have instead of waiting for room in a queue nobody drains anymore
+  std::atomic<bool> Stopping{false};
+
+  // declared last so workers are joined before the queue they push into is destroyed
+  ThreadPool Workers;
+};
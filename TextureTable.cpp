@@ -0,0 +1,141 @@
+#include "TextureTable.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+TextureTable::TextureTable(uint32_t Capacity)
+{
+  VkPhysicalDeviceDescriptorIndexingProperties IndexingProps{};
+  IndexingProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 DevProps{};
+  DevProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  DevProps.pNext = &IndexingProps;
+  vkGetPhysicalDeviceProperties2(Context->PhysicalDevice, &DevProps);
+
+  SlotCount = std::min({ Capacity, IndexingProps.maxDescriptorSetUpdateAfterBindSampledImages,
+                         IndexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                         IndexingProps.maxPerStageDescriptorUpdateAfterBindSamplers });
+
+  if(SlotCount == 0)
+  {
+    throw std::runtime_error("Device can't hold any update-after-bind textures");
+  }
+
+  VkDescriptorPoolSize ImageSize{};
+  ImageSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  ImageSize.descriptorCount = SlotCount;
+
+  VkDescriptorPoolCreateInfo PoolInfo{};
+  PoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  PoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  PoolInfo.maxSets = 1;
+  PoolInfo.poolSizeCount = 1;
+  PoolInfo.pPoolSizes = &ImageSize;
+
+  if(vkCreateDescriptorPool(Context->Device, &PoolInfo, nullptr, &Pool) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create texture table pool");
+  }
+
+  VkDescriptorSetLayoutBinding SetBinding{};
+  SetBinding.binding = 0;
+  SetBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  SetBinding.descriptorCount = SlotCount;
+  SetBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  SetBinding.pImmutableSamplers = nullptr;
+
+  // slots past Next are never written, and written slots are rewritten while frames that don't read them are in flight
+  VkDescriptorBindingFlags BindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo BindingFlagsCI{};
+  BindingFlagsCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  BindingFlagsCI.bindingCount = 1;
+  BindingFlagsCI.pBindingFlags = &BindingFlags;
+
+  VkDescriptorSetLayoutCreateInfo TextureLayoutCI{};
+  TextureLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  TextureLayoutCI.pNext = &BindingFlagsCI;
+  TextureLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  TextureLayoutCI.pBindings = &SetBinding;
+  TextureLayoutCI.bindingCount = 1;
+
+  if(vkCreateDescriptorSetLayout(Context->Device, &TextureLayoutCI, nullptr, &SetLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create texture table layout");
+  }
+
+  VkDescriptorSetVariableDescriptorCountAllocateInfo VariableCount{};
+  VariableCount.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+  VariableCount.descriptorSetCount = 1;
+  VariableCount.pDescriptorCounts = &SlotCount;
+
+  VkDescriptorSetAllocateInfo DescriptorAllocInfo{};
+  DescriptorAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  DescriptorAllocInfo.pNext = &VariableCount;
+  DescriptorAllocInfo.descriptorPool = Pool;
+  DescriptorAllocInfo.descriptorSetCount = 1;
+  DescriptorAllocInfo.pSetLayouts = &SetLayout;
+
+  if(vkAllocateDescriptorSets(Context->Device, &DescriptorAllocInfo, &TextureSet) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to allocate texture table");
+  }
+}
+
+TextureTable::~TextureTable()
+{
+  // the set goes with the pool
+  vkDestroyDescriptorPool(Context->Device, Pool, nullptr);
+  vkDestroyDescriptorSetLayout(Context->Device, SetLayout, nullptr);
+}
+
+uint32_t TextureTable::Register(const Image& Texture, VkSampler Sampler)
+{
+  uint32_t Index;
+
+  if(!FreeSlots.empty())
+  {
+    Index = FreeSlots.back();
+    FreeSlots.pop_back();
+  }
+  else if(Next < SlotCount)
+  {
+    Index = Next++;
+  }
+  else
+  {
+    throw std::runtime_error("Texture table is full");
+  }
+
+  Update(Index, Texture, Sampler);
+
+  return Index;
+}
+
+void TextureTable::Update(uint32_t Index, const Image& Texture, VkSampler Sampler)
+{
+  VkDescriptorImageInfo DescImgInf{};
+  DescImgInf.sampler = Sampler;
+  DescImgInf.imageView = Texture.ImageView;
+  DescImgInf.imageLayout = Texture.CurrentLayout;
+
+  VkWriteDescriptorSet TextureWrite{};
+  TextureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+
+  TextureWrite.descriptorCount = 1;
+  TextureWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  TextureWrite.dstSet = TextureSet;
+
+  TextureWrite.dstBinding = 0;
+  TextureWrite.dstArrayElement = Index;
+  TextureWrite.pImageInfo = &DescImgInf;
+
+  vkUpdateDescriptorSets(Context->Device, 1, &TextureWrite, 0, nullptr);
+}
+
+void TextureTable::Release(uint32_t Index)
+{
+  FreeSlots.push_back(Index);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vulkan.h"
+
+// One global array of combined image samplers at set 0, binding 0, indexed by shaders instead of bound per texture.
+// Built on descriptor indexing: the binding is partially bound, update-after-bind and sized with a variable count,
+// so slots can be filled after the set is bound and unused slots never have to hold a valid image.
+class TextureTable
+{
+  public:
+  // Capacity is clamped to what the device allows for update-after-bind samplers.
+  TextureTable(uint32_t Capacity = 4096);
+  ~TextureTable();
+
+  // Writes Texture into a free slot and returns its index for the shader.
+  uint32_t Register(const Image& Texture, VkSampler Sampler);
+
+  // Points Index at a different image. The slot must not be read by a submission that's still executing.
+  void Update(uint32_t Index, const Image& Texture, VkSampler Sampler);
+
+  // The slot is reused by a later Register, the caller makes sure nothing still samples it.
+  void Release(uint32_t Index);
+
+  VkDescriptorSetLayout Layout() const { return SetLayout; }
+  VkDescriptorSet Set() const { return TextureSet; }
+  uint32_t Capacity() const { return SlotCount; }
+
+  private:
+  VkDescriptorPool Pool;
+  VkDescriptorSetLayout SetLayout;
+  VkDescriptorSet TextureSet;
+
+  uint32_t SlotCount;
+  uint32_t Next = 0;
+  std::vector<uint32_t> FreeSlots;
+};
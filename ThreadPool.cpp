@@ -0,0 +1,80 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t WorkerCount)
+{
+  if(WorkerCount == 0)
+  {
+    uint32_t Hardware = std::thread::hardware_concurrency();
+    WorkerCount = Hardware > 1 ? Hardware - 1 : 1;
+  }
+
+  for(uint32_t i = 0; i < WorkerCount; i++)
+  {
+    Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> Lock(QueueLock);
+    Stopping = true;
+  }
+
+  JobReady.notify_all();
+
+  for(std::thread& Worker : Workers)
+  {
+    Worker.join();
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> Job)
+{
+  {
+    std::lock_guard<std::mutex> Lock(QueueLock);
+    Jobs.push_back(std::move(Job));
+  }
+
+  JobReady.notify_one();
+}
+
+void ThreadPool::WaitIdle()
+{
+  std::unique_lock<std::mutex> Lock(QueueLock);
+  JobsDone.wait(Lock, [this]{ return Jobs.empty() && Running == 0; });
+}
+
+void ThreadPool::WorkerLoop()
+{
+  for(;;)
+  {
+    std::function<void()> Job;
+
+    {
+      std::unique_lock<std::mutex> Lock(QueueLock);
+      JobReady.wait(Lock, [this]{ return Stopping || !Jobs.empty(); });
+
+      if(Jobs.empty())
+      {
+        return;
+      }
+
+      Job = std::move(Jobs.front());
+      Jobs.pop_front();
+      Running++;
+    }
+
+    Job();
+
+    {
+      std::lock_guard<std::mutex> Lock(QueueLock);
+      Running--;
+
+      if(Jobs.empty() && Running == 0)
+      {
+        JobsDone.notify_all();
+      }
+    }
+  }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs off a shared queue.
+class ThreadPool
+{
+  public:
+  // WorkerCount of 0 picks one worker per hardware thread, leaving one for the render thread.
+  ThreadPool(uint32_t WorkerCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void Submit(std::function<void()> Job);
+
+  // Blocks until every submitted job has finished running.
+  void WaitIdle();
+
+  uint32_t WorkerCount() const { return Workers.size(); }
+
+  private:
+  void WorkerLoop();
+
+  std::vector<std::thread> Workers;
+  std::deque<std::function<void()>> Jobs;
+
+  std::mutex QueueLock;
+  std::condition_variable JobReady;
+  std::condition_variable JobsDone;
+
+  uint32_t Running = 0;
+  bool Stopping = false;
+};
+
+// Bounded multi-producer/single-consumer queue. Producers claim a slot with a CAS on the tail,
+// the consumer owns the head, and each slot carries a sequence number so neither side takes a lock.
+template<typename T>
+class CompletionQueue
+{
+  public:
+  CompletionQueue(uint32_t Capacity)
+  {
+    // round up to a power of two so the index wraps with a mask
+    uint32_t Size = 1;
+    while(Size < Capacity) Size <<= 1;
+
+    Slots = std::vector<Slot>(Size);
+    Mask = Size - 1;
+
+    for(uint32_t i = 0; i < Size; i++)
+    {
+      Slots[i].Sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns false if the queue is full.
+  bool Push(T&& Value)
+  {
+    uint64_t Pos = Tail.load(std::memory_order_relaxed);
+
+    for(;;)
+    {
+      Slot& Cell = Slots[Pos & Mask];
+      uint64_t Seq = Cell.Sequence.load(std::memory_order_acquire);
+      int64_t Diff = (int64_t)Seq - (int64_t)Pos;
+
+      if(Diff == 0)
+      {
+        if(Tail.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+        {
+          Cell.Value = std::move(Value);
+          Cell.Sequence.store(Pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if(Diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        Pos = Tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Single consumer only.
+  bool Pop(T& Out)
+  {
+    Slot& Cell = Slots[Head & Mask];
+    uint64_t Seq = Cell.Sequence.load(std::memory_order_acquire);
+
+    if((int64_t)Seq - (int64_t)(Head + 1) < 0)
+    {
+      return false;
+    }
+
+    Out = std::move(Cell.Value);
+    Cell.Sequence.store(Head + Mask + 1, std::memory_order_release);
+    Head++;
+
+    return true;
+  }
+
+  private:
+  struct Slot
+  {
+    std::atomic<uint64_t> Sequence;
+    T Value;
+  };
+
+  std::vector<Slot> Slots;
+  uint64_t Mask;
+
+  alignas(64) std::atomic<uint64_t> Tail{0};
+  alignas(64) uint64_t Head = 0;
+};
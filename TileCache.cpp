@@ -0,0 +1,368 @@
+#include "TileCache.h"
+#include "TextureFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+#include <sys/stat.h>
+
+#include <stb/stb_image.h>
+
+std::vector<TileLevel> TileLevels(uint32_t Width, uint32_t Height, uint32_t Payload)
+{
+  std::vector<TileLevel> Levels;
+  uint32_t First = 0;
+
+  for(;;)
+  {
+    TileLevel Level;
+    Level.Width = Width;
+    Level.Height = Height;
+    Level.TilesX = (Width + Payload - 1) / Payload;
+    Level.TilesY = (Height + Payload - 1) / Payload;
+    Level.First = First;
+
+    Levels.push_back(Level);
+    First += Level.TilesX * Level.TilesY;
+
+    if(Level.TilesX == 1 && Level.TilesY == 1)
+    {
+      return Levels;
+    }
+
+    // rounded up so every texel of a level has a parent, tile x of a level always covers tiles 2x and 2x + 1 below it
+    Width = (Width + 1) / 2;
+    Height = (Height + 1) / 2;
+  }
+}
+
+bool TileCache::Open(const std::string& Path, std::string& Error)
+{
+  if(!File.Open(Path, FileAccess::Random, Error))
+  {
+    return false;
+  }
+
+  if(File.Size() < sizeof(TileCacheHeader))
+  {
+    Error = "Tile cache is truncated";
+    return false;
+  }
+
+  memcpy(&Info, File.Data(), sizeof(Info));
+
+  if(memcmp(Info.Magic, "VTC1", 4) != 0 || Info.TileSize == 0 || Info.TileSize <= 2 * Info.Border)
+  {
+    Error = "Not a tile cache";
+    return false;
+  }
+
+  LevelTable = TileLevels(Info.Width, Info.Height, Payload());
+  Count = LevelTable.back().First + 1;
+
+  if(LevelTable.size() != Info.LevelCount || File.Size() < TileBytes() * (uint64_t(Count) + 1))
+  {
+    Error = "Tile cache is truncated";
+    return false;
+  }
+
+  return true;
+}
+
+// Binary PPM, 8 bits per channel. Its rows sit uncompressed in the file, so they're read one at a time straight out
+// of the mapping and an image of any size is cut without ever being held whole. Returns the offset of the first pixel.
+static bool ParsePPM(const MappedFile& File, uint32_t& Width, uint32_t& Height, uint64_t& PixelOffset, std::string& Error)
+{
+  const uint8_t* Data = File.Data();
+  uint64_t Size = File.Size();
+  uint64_t Pos = 2;
+  uint64_t Fields[3];
+
+  // width, height and maxval, separated by whitespace and # comments running to the end of their line
+  for(uint64_t& Field : Fields)
+  {
+    while(Pos < Size && (isspace(Data[Pos]) || Data[Pos] == '#'))
+    {
+      if(Data[Pos] == '#')
+      {
+        while(Pos < Size && Data[Pos] != '\n')
+        {
+          Pos++;
+        }
+      }
+      else
+      {
+        Pos++;
+      }
+    }
+
+    if(Pos == Size || !isdigit(Data[Pos]))
+    {
+      Error = "malformed PPM header";
+      return false;
+    }
+
+    Field = 0;
+    while(Pos < Size && isdigit(Data[Pos]) && Field <= UINT32_MAX)
+    {
+      Field = Field * 10 + (Data[Pos++] - '0');
+    }
+  }
+
+  if(Fields[0] == 0 || Fields[1] == 0 || Fields[0] > UINT32_MAX || Fields[1] > UINT32_MAX)
+  {
+    Error = "malformed PPM header";
+    return false;
+  }
+
+  if(Fields[2] != 255)
+  {
+    Error = "only 8 bit PPM is supported, maxval is " + std::to_string(Fields[2]);
+    return false;
+  }
+
+  // exactly one whitespace byte between the header and the pixels
+  Width = Fields[0];
+  Height = Fields[1];
+  PixelOffset = Pos + 1;
+
+  if(PixelOffset > Size || (Size - PixelOffset) / 3 / Width < Height)
+  {
+    Error = "PPM is truncated";
+    return false;
+  }
+
+  return true;
+}
+
+// One level of the cache being built top to bottom. It only ever holds its newest TileSize rows, exactly what one row
+// of tiles spans with its borders, so the build keeps a band per level in memory instead of the image.
+struct LevelBand
+{
+  TileLevel Level;
+  std::vector<uint8_t> Rows;    // row y sits in slot y % TileSize
+  uint32_t NextTileRow = 0;
+};
+
+class TileWriter
+{
+  public:
+  TileWriter(std::ofstream& Out, const std::vector<TileLevel>& Levels, uint32_t TileSize, uint32_t Border)
+    : Out(Out), TileSize(TileSize), Border(Border), Scratch(size_t(TileSize) * TileSize * 4)
+  {
+    Bands.resize(Levels.size());
+
+    for(size_t l = 0; l < Levels.size(); l++)
+    {
+      Bands[l].Level = Levels[l];
+      Bands[l].Rows.resize(size_t(TileSize) * Levels[l].Width * 4);
+    }
+  }
+
+  // Where row y of a level goes, call Added() once it's written.
+  uint8_t* Slot(uint32_t LevelIndex, uint32_t y)
+  {
+    LevelBand& Band = Bands[LevelIndex];
+    return &Band.Rows[size_t(y % TileSize) * Band.Level.Width * 4];
+  }
+
+  // Writes every row of tiles the row completes and filters it with the row above into the next level.
+  // Rows come in order, the last one of each level finishes that level and everything below it.
+  void Added(uint32_t LevelIndex, uint32_t y)
+  {
+    LevelBand& Band = Bands[LevelIndex];
+    const TileLevel& Level = Band.Level;
+    uint32_t Payload = TileSize - 2 * Border;
+
+    while(Band.NextTileRow < Level.TilesY &&
+          std::min<uint64_t>(uint64_t(Band.NextTileRow) * Payload + Payload + Border - 1, Level.Height - 1) <= y)
+    {
+      WriteTileRow(Band, Band.NextTileRow++);
+    }
+
+    if(LevelIndex + 1 == Bands.size() || (y % 2 == 0 && y + 1 != Level.Height))
+    {
+      return;
+    }
+
+    // 2x2 box filter, an odd edge averages its last texel or row with itself
+    const uint8_t* Upper = Slot(LevelIndex, y - y % 2);
+    const uint8_t* Lower = Slot(LevelIndex, y);
+    uint8_t* Filtered = Slot(LevelIndex + 1, y / 2);
+    uint32_t NextWidth = Bands[LevelIndex + 1].Level.Width;
+
+    for(uint32_t x = 0; x < NextWidth; x++)
+    {
+      uint32_t x0 = std::min(x * 2, Level.Width - 1), x1 = std::min(x * 2 + 1, Level.Width - 1);
+
+      for(uint32_t c = 0; c < 4; c++)
+      {
+        uint32_t Sum = Upper[x0 * 4 + c] + Upper[x1 * 4 + c] + Lower[x0 * 4 + c] + Lower[x1 * 4 + c];
+        Filtered[size_t(x) * 4 + c] = (Sum + 2) / 4;
+      }
+    }
+
+    Added(LevelIndex + 1, y / 2);
+  }
+
+  private:
+  void WriteTileRow(LevelBand& Band, uint32_t TileY)
+  {
+    const TileLevel& Level = Band.Level;
+    uint32_t Payload = TileSize - 2 * Border;
+    uint64_t TileBytes = Scratch.size();
+
+    for(uint32_t TileX = 0; TileX < Level.TilesX; TileX++)
+    {
+      // the border and anything past the image edge repeat the nearest edge texel
+      for(uint32_t y = 0; y < TileSize; y++)
+      {
+        int64_t SourceY = std::clamp<int64_t>(int64_t(TileY) * Payload + y - Border, 0, Level.Height - 1);
+        const uint8_t* Row = &Band.Rows[size_t(SourceY % TileSize) * Level.Width * 4];
+
+        for(uint32_t x = 0; x < TileSize; x++)
+        {
+          int64_t SourceX = std::clamp<int64_t>(int64_t(TileX) * Payload + x - Border, 0, Level.Width - 1);
+          memcpy(&Scratch[(size_t(y) * TileSize + x) * 4], &Row[size_t(SourceX) * 4], 4);
+        }
+      }
+
+      // levels finish in an interleaved order, every tile goes to its own slot after the header
+      Out.seekp(TileBytes * (uint64_t(Level.First) + uint64_t(TileY) * Level.TilesX + TileX + 1));
+      Out.write(reinterpret_cast<const char*>(Scratch.data()), Scratch.size());
+    }
+  }
+
+  std::ofstream& Out;
+  uint32_t TileSize;
+  uint32_t Border;
+  std::vector<LevelBand> Bands;
+  std::vector<uint8_t> Scratch;
+};
+
+bool PrepareTileCache(const std::string& Source, const std::string& CachePath, std::string& Error, uint32_t TileSize, uint32_t Border)
+{
+  struct stat SourceStat, CacheStat;
+
+  if(stat(Source.c_str(), &SourceStat) != 0)
+  {
+    Error = "Can't find " + Source;
+    return false;
+  }
+
+  // an existing cache is trusted if it's newer than its source and was cut with the same tiles
+  if(stat(CachePath.c_str(), &CacheStat) == 0 && CacheStat.st_mtime >= SourceStat.st_mtime)
+  {
+    TileCache Existing;
+    std::string Ignored;
+
+    if(Existing.Open(CachePath, Ignored) && Existing.Header().TileSize == TileSize && Existing.Header().Border == Border)
+    {
+      return true;
+    }
+  }
+
+  MappedFile Encoded;
+  if(!Encoded.Open(Source, FileAccess::Sequential, Error))
+  {
+    return false;
+  }
+
+  // level 0 rows as RGBA8, read top to bottom. PPM comes straight from the mapping, anything else stb decodes whole
+  uint32_t Width, Height;
+  unsigned char* Decoded = nullptr;
+  std::function<void(uint32_t, uint8_t*)> ReadRow;
+
+  if(Encoded.Size() >= 2 && Encoded.Data()[0] == 'P' && Encoded.Data()[1] == '6')
+  {
+    uint64_t PixelOffset;
+
+    if(!ParsePPM(Encoded, Width, Height, PixelOffset, Error))
+    {
+      Error = Source + ": " + Error;
+      return false;
+    }
+
+    PixelConversion Layout;
+    Layout.SourceChannels = 3;
+
+    ReadRow = [&Encoded, Width, PixelOffset, Layout](uint32_t y, uint8_t* Row)
+    {
+      ConvertPixels(Encoded.Data() + PixelOffset + uint64_t(y) * Width * 3, uint64_t(Width) * 3, Row, uint64_t(Width) * 4, Width, 1, Layout);
+    };
+  }
+  else
+  {
+    PixelConversion Layout;
+    int DecodedWidth, DecodedHeight;
+
+    Decoded = DecodeImage(Encoded, Layout, DecodedWidth, DecodedHeight, Error);
+
+    if(!Decoded)
+    {
+      Error = Source + ": " + Error + ", convert it to binary PPM to cut it without decoding it whole";
+      return false;
+    }
+
+    Width = DecodedWidth;
+    Height = DecodedHeight;
+
+    ReadRow = [Decoded, Width, Layout](uint32_t y, uint8_t* Row)
+    {
+      uint64_t Pitch = uint64_t(Width) * Layout.SourceTexelSize();
+      ConvertPixels(Decoded + y * Pitch, Pitch, Row, uint64_t(Width) * 4, Width, 1, Layout);
+    };
+  }
+
+  std::vector<TileLevel> Levels = TileLevels(Width, Height, TileSize - 2 * Border);
+
+  // written next to the cache and renamed over it, a crash mid-build never leaves a cache that looks complete
+  std::string TempPath = CachePath + ".tmp";
+  std::ofstream Out(TempPath, std::ios::binary | std::ios::trunc);
+
+  if(!Out)
+  {
+    stbi_image_free(Decoded);
+    Error = "Can't write " + TempPath;
+    return false;
+  }
+
+  TileCacheHeader Header{};
+  memcpy(Header.Magic, "VTC1", 4);
+  Header.Width = Width;
+  Header.Height = Height;
+  Header.TileSize = TileSize;
+  Header.Border = Border;
+  Header.LevelCount = Levels.size();
+
+  // the header takes a whole tile slot so every tile starts page aligned
+  std::vector<uint8_t> HeaderSlot(size_t(TileSize) * TileSize * 4, 0);
+  memcpy(HeaderSlot.data(), &Header, sizeof(Header));
+  Out.write(reinterpret_cast<const char*>(HeaderSlot.data()), HeaderSlot.size());
+
+  // every level is built in the same pass, each from the rows of the one above as they come in
+  TileWriter Writer(Out, Levels, TileSize, Border);
+
+  for(uint32_t y = 0; y < Height && Out; y++)
+  {
+    ReadRow(y, Writer.Slot(0, y));
+    Writer.Added(0, y);
+  }
+
+  stbi_image_free(Decoded);
+
+  Out.close();
+
+  if(!Out || std::rename(TempPath.c_str(), CachePath.c_str()) != 0)
+  {
+    Error = "Failed to write " + CachePath;
+    std::remove(TempPath.c_str());
+    return false;
+  }
+
+  return true;
+}
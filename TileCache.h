@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+// On-disk layout of a tile cache: this header padded out to one tile, then every tile of every level as raw RGBA8,
+// level 0 first, each level row-major. Tiles are TileSize texels square with Border texels of clamped neighbour
+// around a TileSize - 2 * Border payload, so bilinear filtering inside the physical pool never reads another tile.
+struct TileCacheHeader
+{
+  char Magic[4];          // "VTC1"
+  uint32_t Width;         // of level 0
+  uint32_t Height;
+  uint32_t TileSize;
+  uint32_t Border;
+  uint32_t LevelCount;    // the last level fits in one tile
+  uint32_t Reserved[2];
+};
+
+struct TileLevel
+{
+  uint32_t Width;         // in texels, each level is half the one before rounded up
+  uint32_t Height;
+  uint32_t TilesX;
+  uint32_t TilesY;
+  uint32_t First;         // index of the level's first tile
+};
+
+// Read side of a tile cache file. Tiles are handed out straight from the mapping, one page aligned TileBytes() block each.
+class TileCache
+{
+  public:
+  static const uint32_t DefaultTileSize = 128;
+  static const uint32_t DefaultBorder = 1;
+
+  // Returns false with Error set if Path isn't a complete tile cache.
+  bool Open(const std::string& Path, std::string& Error);
+
+  const TileCacheHeader& Header() const { return Info; }
+  uint32_t Payload() const { return Info.TileSize - 2 * Info.Border; }
+  uint64_t TileBytes() const { return uint64_t(Info.TileSize) * Info.TileSize * 4; }
+
+  const std::vector<TileLevel>& Levels() const { return LevelTable; }
+  uint32_t TileCount() const { return Count; }
+
+  // Index is First of the tile's level plus its row-major position in the level.
+  const uint8_t* Tile(uint32_t Index) const { return File.Data() + TileBytes() * (uint64_t(Index) + 1); }
+
+  // Starts reading a tile in, for a loader about to touch it.
+  void Prefetch(uint32_t Index) const { File.Prefetch(TileBytes() * (uint64_t(Index) + 1), TileBytes()); }
+
+  private:
+  TileCacheHeader Info{};
+  std::vector<TileLevel> LevelTable;
+  uint32_t Count = 0;
+  MappedFile File;
+};
+
+// Level sizes and tile counts for an image, shared by the builder and the reader so they can't disagree.
+std::vector<TileLevel> TileLevels(uint32_t Width, uint32_t Height, uint32_t Payload);
+
+// Cuts Source into a tile cache at CachePath, unless one is already there that is newer than Source and was cut with
+// the same TileSize and Border. Every level is built in one pass over Source's rows, holding a band of TileSize rows per
+// level. Binary PPM is read straight from the file and can be any size, other formats are decoded whole by stb first,
+// which limits them to 2 GB as RGBA.
+bool PrepareTileCache(const std::string& Source, const std::string& CachePath, std::string& Error,
+                      uint32_t TileSize = TileCache::DefaultTileSize, uint32_t Border = TileCache::DefaultBorder);
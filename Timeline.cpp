@@ -0,0 +1,157 @@
+#include "Timeline.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+TimelineSync::TimelineSync()
+{
+  WaitSemaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(Context->Device, "vkWaitSemaphores");
+  GetCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(Context->Device, "vkGetSemaphoreCounterValue");
+
+  if(!WaitSemaphores || !GetCounterValue)
+  {
+    WaitSemaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(Context->Device, "vkWaitSemaphoresKHR");
+    GetCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(Context->Device, "vkGetSemaphoreCounterValueKHR");
+  }
+
+  if(!WaitSemaphores || !GetCounterValue)
+  {
+    throw std::runtime_error("Device doesn't support timeline semaphores");
+  }
+
+  VkSemaphoreTypeCreateInfo TypeCI{};
+  TypeCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  TypeCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  TypeCI.initialValue = 0;
+
+  VkSemaphoreCreateInfo SemaphoreCI{};
+  SemaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  SemaphoreCI.pNext = &TypeCI;
+
+  VkQueue Queues[3] = { Context->GraphicsQueue, Context->ComputeQueue, Context->TransferQueue };
+
+  for(uint32_t i = 0; i < 3; i++)
+  {
+    Timelines[i].Queue = Queues[i];
+
+    if(vkCreateSemaphore(Context->Device, &SemaphoreCI, nullptr, &Timelines[i].Semaphore) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create timeline semaphore");
+    }
+  }
+}
+
+TimelineSync::~TimelineSync()
+{
+  for(Timeline& Target : Timelines)
+  {
+    vkDestroySemaphore(Context->Device, Target.Semaphore, nullptr);
+  }
+}
+
+SyncPoint TimelineSync::Submit(QueueKind Queue, VkCommandBuffer Cmd, const std::vector<SyncWait>& Waits, const BinarySync& Binary)
+{
+  Timeline& Target = Timelines[uint32_t(Queue)];
+
+  // Waits
+    // binary semaphores take a value too, it's ignored
+    std::vector<VkSemaphore> Semaphores;
+    std::vector<uint64_t> WaitValues;
+    std::vector<VkPipelineStageFlags> WaitStages;
+
+    for(const SyncWait& Wait : Waits)
+    {
+      // still waited on once the CPU has seen it reached, the wait is also what makes the writes before it visible
+      if(Wait.Point.Value == 0)
+      {
+        continue;
+      }
+
+      Semaphores.push_back(Timelines[uint32_t(Wait.Point.Queue)].Semaphore);
+      WaitValues.push_back(Wait.Point.Value);
+      WaitStages.push_back(Wait.Stages);
+    }
+
+    if(Binary.Wait != VK_NULL_HANDLE)
+    {
+      Semaphores.push_back(Binary.Wait);
+      WaitValues.push_back(0);
+      WaitStages.push_back(Binary.WaitStages);
+    }
+  // Waits
+
+  // Signals
+    VkSemaphore Signals[2] = { Target.Semaphore, Binary.Signal };
+    uint64_t SignalValues[2] = { Target.Submitted + 1, 0 };
+  // Signals
+
+  VkTimelineSemaphoreSubmitInfo TimelineInf{};
+  TimelineInf.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  TimelineInf.waitSemaphoreValueCount = WaitValues.size();
+  TimelineInf.pWaitSemaphoreValues = WaitValues.data();
+  TimelineInf.signalSemaphoreValueCount = Binary.Signal != VK_NULL_HANDLE ? 2 : 1;
+  TimelineInf.pSignalSemaphoreValues = SignalValues;
+
+  VkSubmitInfo SubmitInf{};
+  SubmitInf.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  SubmitInf.pNext = &TimelineInf;
+  SubmitInf.waitSemaphoreCount = Semaphores.size();
+  SubmitInf.pWaitSemaphores = Semaphores.data();
+  SubmitInf.pWaitDstStageMask = WaitStages.data();
+  SubmitInf.commandBufferCount = Cmd != VK_NULL_HANDLE ? 1 : 0;
+  SubmitInf.pCommandBuffers = &Cmd;
+  SubmitInf.signalSemaphoreCount = TimelineInf.signalSemaphoreValueCount;
+  SubmitInf.pSignalSemaphores = Signals;
+
+  if(vkQueueSubmit(Target.Queue, 1, &SubmitInf, VK_NULL_HANDLE) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to submit");
+  }
+
+  Target.Submitted++;
+
+  return SyncPoint{Queue, Target.Submitted};
+}
+
+bool TimelineSync::Reached(SyncPoint Point)
+{
+  Timeline& Target = Timelines[uint32_t(Point.Queue)];
+
+  if(Target.Completed < Point.Value)
+  {
+    GetCounterValue(Context->Device, Target.Semaphore, &Target.Completed);
+  }
+
+  return Target.Completed >= Point.Value;
+}
+
+void TimelineSync::Wait(SyncPoint Point)
+{
+  Timeline& Target = Timelines[uint32_t(Point.Queue)];
+
+  if(Target.Completed >= Point.Value)
+  {
+    return;
+  }
+
+  VkSemaphoreWaitInfo WaitInf{};
+  WaitInf.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  WaitInf.semaphoreCount = 1;
+  WaitInf.pSemaphores = &Target.Semaphore;
+  WaitInf.pValues = &Point.Value;
+
+  if(WaitSemaphores(Context->Device, &WaitInf, UINT64_MAX) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to wait for timeline semaphore");
+  }
+
+  Target.Completed = std::max(Target.Completed, Point.Value);
+}
+
+void TimelineSync::WaitIdle()
+{
+  for(uint32_t i = 0; i < 3; i++)
+  {
+    Wait(Last(QueueKind(i)));
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vulkan.h"
+
+enum class QueueKind
+{
+  Graphics,
+  Compute,
+  Transfer
+};
+
+// A value on one queue's timeline. It's reached once that queue has finished every submission up to the one that
+// signaled it, value 0 always is.
+struct SyncPoint
+{
+  QueueKind Queue = QueueKind::Graphics;
+  uint64_t Value = 0;
+};
+
+// A submission doesn't start its WaitStages before Point is reached.
+struct SyncWait
+{
+  SyncPoint Point;
+  VkPipelineStageFlags Stages;
+};
+
+// The swapchain only takes binary semaphores, acquire and present still hand theirs over with the submission.
+struct BinarySync
+{
+  VkSemaphore Wait = VK_NULL_HANDLE;
+  VkPipelineStageFlags WaitStages = 0;
+  VkSemaphore Signal = VK_NULL_HANDLE;
+};
+
+// One timeline semaphore per queue, counting up with every submission to it. Work on any queue waits for a point on
+// any other, and the CPU polls or blocks on points the same way, so nothing needs a fence or semaphore of its own:
+// whoever needs to know when a resource is free again keeps the point of the submission that last used it.
+// Compute and transfer keep their own timelines when they share a queue with graphics, points stay comparable per kind.
+// Submit from the render thread only, like the queues themselves.
+class TimelineSync
+{
+  public:
+  TimelineSync();
+  // Destroy with the device idle.
+  ~TimelineSync();
+
+  // Submits Cmd, which may be null to only wait and signal, and returns the point it signals.
+  SyncPoint Submit(QueueKind Queue, VkCommandBuffer Cmd, const std::vector<SyncWait>& Waits = {}, const BinarySync& Binary = BinarySync{});
+
+  // Doesn't block, only asks the driver when the last answer wasn't far enough along.
+  bool Reached(SyncPoint Point);
+  void Wait(SyncPoint Point);
+  // Blocks until every queue has finished what was submitted to it.
+  void WaitIdle();
+
+  // What the latest submission to Queue signals, reached once the queue is idle.
+  SyncPoint Last(QueueKind Queue) const { return SyncPoint{Queue, Timelines[uint32_t(Queue)].Submitted}; }
+
+  private:
+  struct Timeline
+  {
+    VkSemaphore Semaphore;
+    VkQueue Queue;
+    uint64_t Submitted = 0;
+    uint64_t Completed = 0;   // last value read back, never ahead of the GPU
+  };
+
+  Timeline Timelines[3];
+
+  // core in 1.2, the KHR extension's entry points on older devices
+  PFN_vkWaitSemaphores WaitSemaphores;
+  PFN_vkGetSemaphoreCounterValue GetCounterValue;
+};
@@ -0,0 +1,856 @@
+#include "Upload.h"
+#include "PixelConvert.h"
+#include "PipelineCache.h"
+#include "EmbeddedShaders.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static const uint32_t BatchCount = 4;
+
+// sets one batch's pool holds, a texture's chain needs one per level past the first
+static const uint32_t MipSetsPerBatch = 64;
+
+// matches local_size in mip_comp.glsl
+static const uint32_t MipGroupSize = 8;
+
+static VkDeviceSize AlignUp(VkDeviceSize Value, VkDeviceSize Alignment)
+{
+  return (Value + Alignment - 1) / Alignment * Alignment;
+}
+
+Uploader::Uploader(VkDeviceSize Size) : RingSize(Size)
+{
+  VkPhysicalDeviceProperties DevProps;
+  vkGetPhysicalDeviceProperties(Context->PhysicalDevice, &DevProps);
+
+  // 16 keeps every offset a multiple of any uncompressed texel size and of the 8/16 byte block sizes
+  Alignment = std::max<VkDeviceSize>(DevProps.limits.optimalBufferCopyOffsetAlignment, 16);
+
+  Staging = CreateStagingBuffer(RingSize);
+
+  Mapped = (uint8_t*)Staging.Memory.Mapped;
+
+  VkCommandPoolCreateInfo PoolCI{};
+  PoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  PoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  PoolCI.queueFamilyIndex = Context->TransferFamily;
+
+  if(vkCreateCommandPool(Context->Device, &PoolCI, nullptr, &TransferPool) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create transfer command pool");
+  }
+
+  PoolCI.queueFamilyIndex = Context->GraphicsFamily;
+
+  if(vkCreateCommandPool(Context->Device, &PoolCI, nullptr, &AcquirePool) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create acquire command pool");
+  }
+
+  Batches.resize(BatchCount);
+
+  for(Batch& Slot : Batches)
+  {
+    VkCommandBufferAllocateInfo CmdAllocInfo{};
+    CmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    CmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    CmdAllocInfo.commandPool = TransferPool;
+    CmdAllocInfo.commandBufferCount = 1;
+
+    if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, &Slot.TransferCmd) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to allocate upload command buffer");
+    }
+
+    CmdAllocInfo.commandPool = AcquirePool;
+
+    if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, &Slot.AcquireCmd) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to allocate acquire command buffer");
+    }
+
+    Slot.RingEnd = 0;
+    Slot.Bytes = 0;
+    Slot.Recording = false;
+    Slot.MipPool = VK_NULL_HANDLE;
+    Slot.MipSets = 0;
+  }
+}
+
+Uploader::~Uploader()
+{
+  Flush();
+  WaitIdle();
+
+  vkDestroyCommandPool(Context->Device, TransferPool, nullptr);
+  vkDestroyCommandPool(Context->Device, AcquirePool, nullptr);
+
+  for(Batch& Slot : Batches)
+  {
+    for(VkImageView View : Slot.MipViews)
+    {
+      vkDestroyImageView(Context->Device, View, nullptr);
+    }
+
+    vkDestroyDescriptorPool(Context->Device, Slot.MipPool, nullptr);
+  }
+
+  vkDestroyPipeline(Context->Device, MipPipeline, nullptr);
+  vkDestroyPipelineLayout(Context->Device, MipLayout, nullptr);
+  vkDestroyDescriptorSetLayout(Context->Device, MipSetLayout, nullptr);
+
+  DestroyBuffer(Staging);
+}
+
+Uploader::Batch& Uploader::Current()
+{
+  Batch& Slot = Batches[CurrentBatch];
+
+  if(Slot.Recording)
+  {
+    return Slot;
+  }
+
+  // the slot we're about to reuse is the oldest one still on the GPU
+  while(std::find(InFlight.begin(), InFlight.end(), CurrentBatch) != InFlight.end())
+  {
+    Retire(true);
+  }
+
+  // its mip dispatches are done with their views and sets
+  for(VkImageView View : Slot.MipViews)
+  {
+    vkDestroyImageView(Context->Device, View, nullptr);
+  }
+
+  Slot.MipViews.clear();
+  Slot.MipSets = 0;
+
+  if(Slot.MipPool != VK_NULL_HANDLE)
+  {
+    vkResetDescriptorPool(Context->Device, Slot.MipPool, 0);
+  }
+
+  VkCommandBufferBeginInfo BeginInf{};
+  BeginInf.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  BeginInf.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(Slot.TransferCmd, &BeginInf);
+
+  if(DedicatedTransfer())
+  {
+    vkBeginCommandBuffer(Slot.AcquireCmd, &BeginInf);
+  }
+
+  Slot.Bytes = 0;
+  Slot.Recording = true;
+
+  return Slot;
+}
+
+VkDeviceSize Uploader::Allocate(VkDeviceSize Size)
+{
+  if(Size > RingSize)
+  {
+    throw std::runtime_error("Upload larger than the staging ring");
+  }
+
+  for(;;)
+  {
+    Batch& Slot = Current();
+    Retire(false);
+
+    if(Used == 0)
+    {
+      Head = 0;
+      Tail = 0;
+    }
+
+    VkDeviceSize Offset = AlignUp(Head, Alignment);
+    VkDeviceSize Skipped = Offset - Head;
+    bool Fits = false;
+
+    if(Used == 0 || Head > Tail)
+    {
+      // free space is [Head, RingSize) followed by [0, Tail)
+      if(Offset + Size <= RingSize)
+      {
+        Fits = true;
+      }
+      else if(Size <= Tail)
+      {
+        // wrap, the bytes left at the end belong to this batch until it retires
+        Skipped = RingSize - Head;
+        Offset = 0;
+        Fits = true;
+      }
+    }
+    else if(Head < Tail)
+    {
+      Fits = Offset + Size <= Tail;
+    }
+
+    if(Fits)
+    {
+      Slot.Bytes += Skipped + Size;
+      Used += Skipped + Size;
+      Head = Offset + Size;
+
+      return Offset;
+    }
+
+    // out of room: push out what we have so it can retire, then wait for the oldest batch
+    Flush();
+    Retire(true);
+  }
+}
+
+void Uploader::Retire(bool Wait)
+{
+  while(!InFlight.empty())
+  {
+    Batch& Oldest = Batches[InFlight.front()];
+
+    if(Wait)
+    {
+      Context->Sync->Wait(Oldest.Done);
+      Wait = false;
+    }
+    else if(!Context->Sync->Reached(Oldest.Done))
+    {
+      return;
+    }
+
+    Tail = Oldest.RingEnd;
+    Used -= Oldest.Bytes;
+    InFlight.pop_front();
+  }
+}
+
+bool Uploader::CanBlit(VkFormat Format)
+{
+  VkFormatProperties Props;
+  vkGetPhysicalDeviceFormatProperties(Context->PhysicalDevice, Format, &Props);
+
+  VkFormatFeatureFlags Needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  return (Props.optimalTilingFeatures & Needed) == Needed;
+}
+
+VkFormat Uploader::StorageFormat(VkFormat Format)
+{
+  // storage images can't be sRGB, the kernel decodes and encodes those itself. RGBA8 UNORM storage is required of every
+  // device, and is what the kernel's rgba8 images expect
+  if(Format == VK_FORMAT_R8G8B8A8_SRGB || Format == VK_FORMAT_R8G8B8A8_UNORM)
+  {
+    return VK_FORMAT_R8G8B8A8_UNORM;
+  }
+
+  return VK_FORMAT_UNDEFINED;
+}
+
+bool Uploader::ComputesMips(VkFormat Format) const
+{
+  return ForceComputeMips || !CanBlit(Format);
+}
+
+void Uploader::CreateMipPipeline()
+{
+  if(MipPipeline != VK_NULL_HANDLE)
+  {
+    return;
+  }
+
+  // Descriptors
+    VkDescriptorSetLayoutBinding Bindings[2]{};
+    Bindings[0] = { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    Bindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+    VkDescriptorSetLayoutCreateInfo SetLayoutCI{};
+    SetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    SetLayoutCI.bindingCount = 2;
+    SetLayoutCI.pBindings = Bindings;
+
+    if(vkCreateDescriptorSetLayout(Context->Device, &SetLayoutCI, nullptr, &MipSetLayout) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create mip set layout");
+    }
+
+    // one pool per batch, so a retired batch's sets are reset together
+    VkDescriptorPoolSize PoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MipSetsPerBatch * 2 };
+
+    VkDescriptorPoolCreateInfo PoolCI{};
+    PoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    PoolCI.maxSets = MipSetsPerBatch;
+    PoolCI.poolSizeCount = 1;
+    PoolCI.pPoolSizes = &PoolSize;
+
+    for(Batch& Slot : Batches)
+    {
+      if(vkCreateDescriptorPool(Context->Device, &PoolCI, nullptr, &Slot.MipPool) != VK_SUCCESS)
+      {
+        throw std::runtime_error("Failed to create mip descriptor pool");
+      }
+    }
+  // Descriptors
+
+  // Layout
+    VkPushConstantRange PushRange{};
+    PushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    PushRange.offset = 0;
+    PushRange.size = sizeof(uint32_t);
+
+    VkPipelineLayoutCreateInfo PipeLayoutInfo{};
+    PipeLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    PipeLayoutInfo.setLayoutCount = 1;
+    PipeLayoutInfo.pSetLayouts = &MipSetLayout;
+    PipeLayoutInfo.pushConstantRangeCount = 1;
+    PipeLayoutInfo.pPushConstantRanges = &PushRange;
+
+    if(vkCreatePipelineLayout(Context->Device, &PipeLayoutInfo, nullptr, &MipLayout) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create mip pipeline layout");
+    }
+  // Layout
+
+  VkShaderModule Comp = CreateShaderModule(MipCompSpirv, sizeof(MipCompSpirv));
+
+  VkComputePipelineCreateInfo ComputePipe{};
+  ComputePipe.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  ComputePipe.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  ComputePipe.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  ComputePipe.stage.module = Comp;
+  ComputePipe.stage.pName = "main";
+  ComputePipe.layout = MipLayout;
+
+  VkResult Err = vkCreateComputePipelines(Context->Device, Context->Pipelines->Get(), 1, &ComputePipe, nullptr, &MipPipeline);
+
+  vkDestroyShaderModule(Context->Device, Comp, nullptr);
+
+  if(Err != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create mip pipeline");
+  }
+}
+
+VkCommandBuffer Uploader::GraphicsCmd()
+{
+  return DedicatedTransfer() ? Current().AcquireCmd : Current().TransferCmd;
+}
+
+void Uploader::CopyLevel(Image& Target, const void* Pixels, uint32_t Width, uint32_t Height, uint32_t Level, const FormatBlock& Block,
+                         VkOffset2D Origin, bool Graphics, const PixelConversion* Convert)
+{
+  // strips are whole rows of blocks, a partial block at the edge still takes a full block in the buffer
+  uint32_t BlocksWide = (Width + Block.Width - 1) / Block.Width;
+  uint32_t BlocksHigh = (Height + Block.Height - 1) / Block.Height;
+  VkDeviceSize RowSize = (VkDeviceSize)BlocksWide * Block.Size;
+
+  // keep strips to a quarter of the ring so a big image still overlaps with the copies before it
+  uint32_t MaxRows = std::max<VkDeviceSize>(1, (RingSize / 4) / RowSize);
+
+  for(uint32_t Row = 0; Row < BlocksHigh;)
+  {
+    uint32_t Rows = std::min(MaxRows, BlocksHigh - Row);
+    VkDeviceSize Size = RowSize * Rows;
+
+    VkDeviceSize Offset = Allocate(Size);
+
+    if(Convert)
+    {
+      // converted straight into the ring, the RGBA8 image never exists anywhere else
+      VkDeviceSize SourcePitch = (VkDeviceSize)Width * Convert->SourceTexelSize();
+      ConvertPixels((const uint8_t*)Pixels + SourcePitch * Row, SourcePitch, Mapped + Offset, RowSize, Width, Rows, *Convert);
+    }
+    else
+    {
+      memcpy(Mapped + Offset, (const uint8_t*)Pixels + RowSize * Row, Size);
+    }
+
+    Context->Allocator->Flush(Staging.Memory, Offset, Size);
+
+    uint32_t FirstTexelRow = Row * Block.Height;
+
+    VkBufferImageCopy Copy{};
+    Copy.bufferOffset = Offset;
+    Copy.bufferRowLength = 0;
+    Copy.bufferImageHeight = 0;
+    Copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    Copy.imageSubresource.mipLevel = Level;
+    Copy.imageSubresource.baseArrayLayer = 0;
+    Copy.imageSubresource.layerCount = 1;
+    Copy.imageOffset = VkOffset3D{Origin.x, Origin.y + (int32_t)FirstTexelRow, 0};
+    Copy.imageExtent = VkExtent3D{Width, std::min(Rows * Block.Height, Height - FirstTexelRow), 1};
+
+    // Allocate may have flushed and started a new batch, so the command buffer is looked up after it
+    VkCommandBuffer Cmd = Graphics ? GraphicsCmd() : Current().TransferCmd;
+
+    vkCmdCopyBufferToImage(Cmd, Staging.Buffer, Target.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Copy);
+
+    Row += Rows;
+  }
+}
+
+void Uploader::GenerateMips(VkCommandBuffer Cmd, Image& Target, uint32_t Width, uint32_t Height)
+{
+  VkImageMemoryBarrier Barrier{};
+  Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  Barrier.image = Target.Image;
+  Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  Barrier.subresourceRange.levelCount = 1;
+  Barrier.subresourceRange.baseArrayLayer = 0;
+  Barrier.subresourceRange.layerCount = 1;
+
+  int32_t SrcWidth = Width, SrcHeight = Height;
+
+  for(uint32_t Level = 1; Level < Target.MipLevels; Level++)
+  {
+    int32_t DstWidth = std::max(SrcWidth / 2, 1);
+    int32_t DstHeight = std::max(SrcHeight / 2, 1);
+
+    // the previous level is finished once it has been written, read it as the blit source
+    Barrier.subresourceRange.baseMipLevel = Level - 1;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+    VkImageBlit Blit{};
+    Blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    Blit.srcSubresource.mipLevel = Level - 1;
+    Blit.srcSubresource.baseArrayLayer = 0;
+    Blit.srcSubresource.layerCount = 1;
+    Blit.srcOffsets[0] = VkOffset3D{0, 0, 0};
+    Blit.srcOffsets[1] = VkOffset3D{SrcWidth, SrcHeight, 1};
+    Blit.dstSubresource = Blit.srcSubresource;
+    Blit.dstSubresource.mipLevel = Level;
+    Blit.dstOffsets[0] = VkOffset3D{0, 0, 0};
+    Blit.dstOffsets[1] = VkOffset3D{DstWidth, DstHeight, 1};
+
+    vkCmdBlitImage(Cmd, Target.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Target.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Blit, VK_FILTER_LINEAR);
+
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+    SrcWidth = DstWidth;
+    SrcHeight = DstHeight;
+  }
+
+  // the last level was only ever a blit destination
+  Barrier.subresourceRange.baseMipLevel = Target.MipLevels - 1;
+  Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+}
+
+void Uploader::ComputeMips(VkCommandBuffer Cmd, Image& Target, uint32_t Width, uint32_t Height)
+{
+  Batch& Slot = Current();
+  VkFormat Storage = StorageFormat(Target.ImageFormat);
+
+  // a storage view per level, each dispatch reads one and writes the next
+  size_t FirstView = Slot.MipViews.size();
+
+  for(uint32_t Level = 0; Level < Target.MipLevels; Level++)
+  {
+    VkImageViewCreateInfo ViewCI{};
+    ViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    ViewCI.image = Target.Image;
+    ViewCI.format = Storage;
+    ViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    ViewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, Level, 1, 0, 1 };
+
+    VkImageView View;
+    if(vkCreateImageView(Context->Device, &ViewCI, nullptr, &View) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create mip level view");
+    }
+
+    Slot.MipViews.push_back(View);
+  }
+
+  std::vector<VkDescriptorSetLayout> Layouts(Target.MipLevels - 1, MipSetLayout);
+  std::vector<VkDescriptorSet> Sets(Layouts.size());
+
+  VkDescriptorSetAllocateInfo SetAllocInfo{};
+  SetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  SetAllocInfo.descriptorPool = Slot.MipPool;
+  SetAllocInfo.descriptorSetCount = Sets.size();
+  SetAllocInfo.pSetLayouts = Layouts.data();
+
+  if(vkAllocateDescriptorSets(Context->Device, &SetAllocInfo, Sets.data()) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to allocate mip descriptor sets");
+  }
+
+  Slot.MipSets += Sets.size();
+
+  std::vector<VkDescriptorImageInfo> Levels(Target.MipLevels);
+  std::vector<VkWriteDescriptorSet> Writes(Sets.size() * 2);
+
+  for(uint32_t Level = 0; Level < Target.MipLevels; Level++)
+  {
+    Levels[Level].imageView = Slot.MipViews[FirstView + Level];
+    Levels[Level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  }
+
+  for(size_t w = 0; w < Writes.size(); w++)
+  {
+    // set i reads level i and writes level i + 1
+    Writes[w].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    Writes[w].dstSet = Sets[w / 2];
+    Writes[w].dstBinding = w % 2;
+    Writes[w].descriptorCount = 1;
+    Writes[w].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    Writes[w].pImageInfo = &Levels[w / 2 + w % 2];
+  }
+
+  vkUpdateDescriptorSets(Context->Device, Writes.size(), Writes.data(), 0, nullptr);
+
+  VkImageMemoryBarrier Barrier{};
+  Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  Barrier.image = Target.Image;
+  Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  Barrier.subresourceRange.baseMipLevel = 0;
+  Barrier.subresourceRange.levelCount = Target.MipLevels;
+  Barrier.subresourceRange.baseArrayLayer = 0;
+  Barrier.subresourceRange.layerCount = 1;
+
+  // storage images live in GENERAL, level 0 is read after its copy and the rest are written
+  Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  Barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+  uint32_t Srgb = Target.ImageFormat != Storage;
+
+  vkCmdBindPipeline(Cmd, VK_PIPELINE_BIND_POINT_COMPUTE, MipPipeline);
+  vkCmdPushConstants(Cmd, MipLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Srgb), &Srgb);
+
+  uint32_t DstWidth = Width, DstHeight = Height;
+
+  Barrier.subresourceRange.levelCount = 1;
+  Barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  Barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  for(uint32_t Level = 1; Level < Target.MipLevels; Level++)
+  {
+    DstWidth = std::max(DstWidth / 2, 1u);
+    DstHeight = std::max(DstHeight / 2, 1u);
+
+    vkCmdBindDescriptorSets(Cmd, VK_PIPELINE_BIND_POINT_COMPUTE, MipLayout, 0, 1, &Sets[Level - 1], 0, nullptr);
+    vkCmdDispatch(Cmd, (DstWidth + MipGroupSize - 1) / MipGroupSize, (DstHeight + MipGroupSize - 1) / MipGroupSize, 1);
+
+    // the next dispatch reads what this one wrote
+    if(Level + 1 < Target.MipLevels)
+    {
+      Barrier.subresourceRange.baseMipLevel = Level;
+      Barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+    }
+  }
+
+  Barrier.subresourceRange.baseMipLevel = 0;
+  Barrier.subresourceRange.levelCount = Target.MipLevels;
+  Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+}
+
+void Uploader::UploadImage(Image& Target, const void* Pixels, uint32_t Width, uint32_t Height, const PixelConversion& Source)
+{
+  const uint32_t TexelSize = 4;
+
+  // blits need a format that can be linearly filtered, the kernel takes the rest
+  MipSource Mips = MipSource::Copied;
+
+  if(Target.MipLevels > 1)
+  {
+    Mips = ComputesMips(Target.ImageFormat) ? MipSource::Compute : MipSource::Blit;
+  }
+
+  if(Mips == MipSource::Compute)
+  {
+    if(StorageFormat(Target.ImageFormat) == VK_FORMAT_UNDEFINED)
+    {
+      throw std::runtime_error("Can't generate mips for a format that can neither be blitted nor written by the mip kernel");
+    }
+
+    CreateMipPipeline();
+
+    // all of a chain's sets come out of one batch's pool
+    Batch& Slot = Batches[CurrentBatch];
+    if(Slot.Recording && Slot.MipSets + Target.MipLevels - 1 > MipSetsPerBatch)
+    {
+      Flush();
+    }
+  }
+
+  VkImageMemoryBarrier ToTransfer{};
+  ToTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  ToTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  ToTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  ToTransfer.image = Target.Image;
+  ToTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  ToTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  ToTransfer.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  ToTransfer.subresourceRange.baseMipLevel = 0;
+  ToTransfer.subresourceRange.levelCount = Target.MipLevels;
+  ToTransfer.subresourceRange.baseArrayLayer = 0;
+  ToTransfer.subresourceRange.layerCount = 1;
+  ToTransfer.srcAccessMask = 0;
+  ToTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(Current().TransferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &ToTransfer);
+
+  CopyLevel(Target, Pixels, Width, Height, 0, FormatBlock{TexelSize, 1, 1}, VkOffset2D{0, 0}, false, Source.IsCopy() ? nullptr : &Source);
+
+  Finish(Target, Mips, Width, Height);
+}
+
+void Uploader::UploadCompressed(Image& Target, const CompressedImage& Source)
+{
+  VkImageMemoryBarrier ToTransfer{};
+  ToTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  ToTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  ToTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  ToTransfer.image = Target.Image;
+  ToTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  ToTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  ToTransfer.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  ToTransfer.subresourceRange.baseMipLevel = 0;
+  ToTransfer.subresourceRange.levelCount = Target.MipLevels;
+  ToTransfer.subresourceRange.baseArrayLayer = 0;
+  ToTransfer.subresourceRange.layerCount = 1;
+  ToTransfer.srcAccessMask = 0;
+  ToTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(Current().TransferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &ToTransfer);
+
+  for(uint32_t Level = 0; Level < Target.MipLevels; Level++)
+  {
+    const MipLevel& Mip = Source.Levels[Level];
+    // straight out of the file mapping into the ring, the level is never copied anywhere else
+    CopyLevel(Target, Source.File.Data() + Mip.Offset, Mip.Width, Mip.Height, Level, Source.Block);
+  }
+
+  // every level came from the file, nothing to generate
+  Finish(Target, MipSource::Copied, Source.Width, Source.Height);
+}
+
+void Uploader::UploadRegion(Image& Target, const void* Pixels, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height, uint32_t TexelSize)
+{
+  VkImageMemoryBarrier Barrier{};
+  Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  Barrier.image = Target.Image;
+  Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  Barrier.subresourceRange.baseMipLevel = 0;
+  Barrier.subresourceRange.levelCount = 1;
+  Barrier.subresourceRange.baseArrayLayer = 0;
+  Barrier.subresourceRange.layerCount = 1;
+
+  // waits for the fragment shaders of every frame submitted before this batch, they may still be sampling the old contents
+  Barrier.oldLayout = Target.CurrentLayout;
+  Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  Barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  Barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(GraphicsCmd(), VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+  CopyLevel(Target, Pixels, Width, Height, 0, FormatBlock{TexelSize, 1, 1}, VkOffset2D{(int32_t)X, (int32_t)Y}, true);
+
+  Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier(GraphicsCmd(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+  Target.CurrentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+void Uploader::CopyLevels(Image& Source, Image& Target, uint32_t FirstLevel)
+{
+  VkCommandBuffer Cmd = GraphicsCmd();
+
+  VkImageMemoryBarrier Barriers[2]{};
+
+  for(VkImageMemoryBarrier& Barrier : Barriers)
+  {
+    Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    Barrier.subresourceRange.levelCount = Target.MipLevels;
+    Barrier.subresourceRange.baseArrayLayer = 0;
+    Barrier.subresourceRange.layerCount = 1;
+  }
+
+  // frames submitted before this batch may still be sampling the source
+  Barriers[0].image = Source.Image;
+  Barriers[0].subresourceRange.baseMipLevel = FirstLevel;
+  Barriers[0].oldLayout = Source.CurrentLayout;
+  Barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  Barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  Barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  Barriers[1].image = Target.Image;
+  Barriers[1].subresourceRange.baseMipLevel = 0;
+  Barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  Barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  Barriers[1].srcAccessMask = 0;
+  Barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, Barriers);
+
+  std::vector<VkImageCopy> Copies(Target.MipLevels);
+
+  for(uint32_t Level = 0; Level < Target.MipLevels; Level++)
+  {
+    VkImageCopy& Copy = Copies[Level];
+    Copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, FirstLevel + Level, 0, 1 };
+    Copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, Level, 0, 1 };
+    Copy.srcOffset = { 0, 0, 0 };
+    Copy.dstOffset = { 0, 0, 0 };
+    Copy.extent = { std::max(1u, Target.Extent.width >> Level), std::max(1u, Target.Extent.height >> Level), 1 };
+  }
+
+  vkCmdCopyImage(Cmd, Source.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Target.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, Copies.size(), Copies.data());
+
+  Barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  Barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  Barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  Barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barriers[1]);
+
+  Source.CurrentLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  Target.CurrentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+void Uploader::Finish(Image& Target, MipSource Mips, uint32_t Width, uint32_t Height)
+{
+  Batch& Slot = Current();
+
+  VkImageMemoryBarrier ToShader{};
+  ToShader.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  ToShader.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  ToShader.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  ToShader.image = Target.Image;
+  ToShader.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  ToShader.subresourceRange.baseMipLevel = 0;
+  ToShader.subresourceRange.levelCount = Target.MipLevels;
+  ToShader.subresourceRange.baseArrayLayer = 0;
+  ToShader.subresourceRange.layerCount = 1;
+  ToShader.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  ToShader.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  ToShader.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  ToShader.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  if(Mips != MipSource::Copied)
+  {
+    // stay in TRANSFER_DST, GenerateMips and ComputeMips move each level to SHADER_READ_ONLY once they're done with it
+    ToShader.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    ToShader.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  }
+
+  // the graphics queue side, both generators start with a barrier from the transfer stage
+  VkCommandBuffer Cmd = Slot.TransferCmd;
+
+  if(DedicatedTransfer())
+  {
+    // release on the transfer queue, acquire on the graphics queue after the semaphore
+    ToShader.srcQueueFamilyIndex = Context->TransferFamily;
+    ToShader.dstQueueFamilyIndex = Context->GraphicsFamily;
+
+    VkImageMemoryBarrier Release = ToShader;
+    Release.dstAccessMask = 0;
+
+    VkImageMemoryBarrier Acquire = ToShader;
+    Acquire.srcAccessMask = 0;
+
+    VkPipelineStageFlags AcquireStage = Mips != MipSource::Copied ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    vkCmdPipelineBarrier(Slot.TransferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &Release);
+    vkCmdPipelineBarrier(Slot.AcquireCmd, AcquireStage, AcquireStage, 0, 0, nullptr, 0, nullptr, 1, &Acquire);
+
+    Cmd = Slot.AcquireCmd;
+  }
+  else if(Mips == MipSource::Copied)
+  {
+    vkCmdPipelineBarrier(Slot.TransferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &ToShader);
+  }
+
+  // on the same queue, the generator's first barrier is all the copied level needs
+  if(Mips == MipSource::Blit)
+  {
+    GenerateMips(Cmd, Target, Width, Height);
+  }
+  else if(Mips == MipSource::Compute)
+  {
+    ComputeMips(Cmd, Target, Width, Height);
+  }
+
+  Target.CurrentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+void Uploader::Flush()
+{
+  Batch& Slot = Batches[CurrentBatch];
+
+  if(!Slot.Recording)
+  {
+    return;
+  }
+
+  vkEndCommandBuffer(Slot.TransferCmd);
+
+  if(DedicatedTransfer())
+  {
+    vkEndCommandBuffer(Slot.AcquireCmd);
+
+    SyncPoint Released = Context->Sync->Submit(QueueKind::Transfer, Slot.TransferCmd);
+
+    // mip blits and dispatches run on the graphics queue after the acquire, so they wait too
+    Slot.Done = Context->Sync->Submit(QueueKind::Graphics, Slot.AcquireCmd,
+                                      { SyncWait{Released, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT} });
+  }
+  else
+  {
+    Slot.Done = Context->Sync->Submit(QueueKind::Graphics, Slot.TransferCmd);
+  }
+
+  Slot.RingEnd = Head;
+  Slot.Recording = false;
+
+  InFlight.push_back(CurrentBatch);
+  CurrentBatch = (CurrentBatch + 1) % BatchCount;
+}
+
+void Uploader::WaitIdle()
+{
+  while(!InFlight.empty())
+  {
+    Retire(true);
+  }
+}
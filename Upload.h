@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Vulkan.h"
+#include "Timeline.h"
+#include "TextureFile.h"
+#include "PixelConvert.h"
+
+// Streams pixel data to optimal-tiled device-local images through one persistently mapped staging ring.
+// Copies are batched into a single command buffer until Flush(), and run on the dedicated transfer queue when there is one.
+class Uploader
+{
+  public:
+  Uploader(VkDeviceSize RingSize);
+  ~Uploader();
+
+  // Records a copy of Width x Height tightly packed texels into mip 0 of Target and a transition to SHADER_READ_ONLY_OPTIMAL.
+  // Target is RGBA8, Pixels are laid out as Source describes and converted on their way into the staging ring.
+  // Images bigger than the ring are split into row strips. The rest of Target's mip chain is filled on the graphics queue,
+  // by blits or by a compute kernel when the format can't be linearly blitted. See ComputesMips for what that needs.
+  void UploadImage(Image& Target, const void* Pixels, uint32_t Width, uint32_t Height, const PixelConversion& Source = PixelConversion{});
+
+  // Records copies of every level in Source, Target must have been created with Source's format and level count.
+  void UploadCompressed(Image& Target, const CompressedImage& Source);
+
+  // Copies Width x Height tightly packed texels into mip 0 of Target at X, Y and leaves the rest of the image alone.
+  // Recorded on the graphics queue so it's ordered after every frame already submitted, Target can still be in use.
+  // For single level images that are updated piecewise, like atlas pages.
+  void UploadRegion(Image& Target, const void* Pixels, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height, uint32_t TexelSize);
+
+  // Records a copy of Source's levels from FirstLevel down into Target's levels from 0, on the graphics queue so it's
+  // ordered after every frame that may still sample Source. Target is a new image of the same format, FirstLevel levels
+  // smaller. Source is left in TRANSFER_SRC_OPTIMAL, it's only fit to be destroyed once the batch retires.
+  void CopyLevels(Image& Source, Image& Target, uint32_t FirstLevel);
+
+  // Submits everything recorded since the last flush. Does not wait.
+  void Flush();
+
+  // Blocks until every flushed batch has finished on the GPU.
+  void WaitIdle();
+
+  // Whether UploadImage fills Format's mip chain with the compute kernel. Those images need STORAGE usage and the
+  // MUTABLE_FORMAT and EXTENDED_USAGE flags, the levels are written through UNORM storage views.
+  bool ComputesMips(VkFormat Format) const;
+
+  // takes the compute path even where blits work, so it can be measured and tested on any device
+  bool ForceComputeMips = false;
+
+  private:
+  struct Batch
+  {
+    VkCommandBuffer TransferCmd;
+    VkCommandBuffer AcquireCmd;   // graphics side of the queue family ownership transfer
+    SyncPoint Done;               // the graphics side's point, the transfer side is always reached before it
+    VkDeviceSize RingEnd;
+    VkDeviceSize Bytes;           // ring bytes this batch holds, padding and wrap-around included
+    bool Recording;
+
+    // the mip kernel's sets and level views, released once the batch retires
+    VkDescriptorPool MipPool;
+    uint32_t MipSets;
+    std::vector<VkImageView> MipViews;
+  };
+
+  // where a target's levels past the first come from
+  enum class MipSource
+  {
+    Copied,
+    Blit,
+    Compute
+  };
+
+  bool DedicatedTransfer() const { return Context->TransferFamily != Context->GraphicsFamily; }
+
+  Batch& Current();
+
+  static bool CanBlit(VkFormat Format);
+  // what the kernel's storage views of Format are, UNDEFINED if the device can't store it
+  static VkFormat StorageFormat(VkFormat Format);
+  // Graphics records on the queue that samples the image instead of the transfer queue.
+  // With Convert set Pixels are in its source layout and Block must be 4 byte texels.
+  void CopyLevel(Image& Target, const void* Pixels, uint32_t Width, uint32_t Height, uint32_t Level, const FormatBlock& Block,
+                 VkOffset2D Origin = VkOffset2D{0, 0}, bool Graphics = false, const PixelConversion* Convert = nullptr);
+
+  // Where graphics queue work goes in the current batch, the acquire buffer when there's a dedicated transfer queue.
+  VkCommandBuffer GraphicsCmd();
+
+  // Moves every level from TRANSFER_DST to SHADER_READ_ONLY on the graphics queue, generating mips on the way unless Copied.
+  void Finish(Image& Target, MipSource Mips, uint32_t Width, uint32_t Height);
+
+  // Both expect every level in TRANSFER_DST with level 0 written, and leave every level in SHADER_READ_ONLY.
+  void GenerateMips(VkCommandBuffer Cmd, Image& Target, uint32_t Width, uint32_t Height);
+  void ComputeMips(VkCommandBuffer Cmd, Image& Target, uint32_t Width, uint32_t Height);
+
+  // the kernel's pipeline and per batch pools, made the first time an image needs them
+  void CreateMipPipeline();
+
+  // Reserves Size bytes in the ring, waiting for older batches to retire if it is full.
+  VkDeviceSize Allocate(VkDeviceSize Size);
+  void Retire(bool Wait);
+
+  Buffer Staging;
+  uint8_t* Mapped;
+  VkDeviceSize RingSize;
+  VkDeviceSize Alignment;
+
+  // bytes [Tail, Head) are owned by in-flight or recording batches, Used disambiguates empty from full
+  VkDeviceSize Head = 0;
+  VkDeviceSize Tail = 0;
+  VkDeviceSize Used = 0;
+
+  VkCommandPool TransferPool;
+  VkCommandPool AcquirePool;
+
+  VkDescriptorSetLayout MipSetLayout = VK_NULL_HANDLE;
+  VkPipelineLayout MipLayout = VK_NULL_HANDLE;
+  VkPipeline MipPipeline = VK_NULL_HANDLE;
+
+  std::vector<Batch> Batches;
+  std::deque<uint32_t> InFlight;
+  uint32_t CurrentBatch = 0;
+};
@@ -0,0 +1,540 @@
+#include "VirtualTexture.h"
+#include "Upload.h"
+#include "PipelineCache.h"
+#include "EmbeddedShaders.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+static_assert(sizeof(glm::uvec4) == 16 && sizeof(glm::vec4) == 16, "page table header has to match the shader's std430 layout");
+
+static VkDeviceSize AlignUp(VkDeviceSize Value, VkDeviceSize Alignment)
+{
+  return (Value + Alignment - 1) / Alignment * Alignment;
+}
+
+VirtualTexture::VirtualTexture(const std::string& CachePath, uint32_t PoolTiles) : Loaded(MaxLoadsInFlight), Workers(2)
+{
+  std::string Error;
+  if(!Cache.Open(CachePath, Error))
+  {
+    throw std::runtime_error(Error);
+  }
+
+  if(!Context->Features.fragmentStoresAndAtomics)
+  {
+    throw std::runtime_error("Virtual textures need fragmentStoresAndAtomics for their feedback");
+  }
+
+  if(Cache.Header().LevelCount > MaxLevels)
+  {
+    throw std::runtime_error("Tile cache has more levels than the page table holds");
+  }
+
+  VkPhysicalDeviceProperties DevProps;
+  vkGetPhysicalDeviceProperties(Context->PhysicalDevice, &DevProps);
+
+  // entries hold 12 bits of slot position per axis
+  uint32_t TileSize = Cache.Header().TileSize;
+  PoolSize = std::clamp(PoolTiles, 1u, std::min(DevProps.limits.maxImageDimension2D / TileSize, 4096u));
+
+  uint32_t TileCount = Cache.TileCount();
+  const std::vector<TileLevel>& Levels = Cache.Levels();
+
+  // tile x, y of a level is covered by x / 2, y / 2 of the next, the last level is a single tile with no parent
+  Parents.assign(TileCount, NoTile);
+
+  for(size_t l = 0; l + 1 < Levels.size(); l++)
+  {
+    const TileLevel& Level = Levels[l];
+    const TileLevel& Next = Levels[l + 1];
+
+    for(uint32_t y = 0; y < Level.TilesY; y++)
+    {
+      for(uint32_t x = 0; x < Level.TilesX; x++)
+      {
+        Parents[Level.First + y * Level.TilesX + x] = Next.First + (y / 2) * Next.TilesX + x / 2;
+      }
+    }
+  }
+
+  SlotOf.assign(TileCount, NoTile);
+  LastUsed.assign(TileCount, 0);
+  Pending.assign(TileCount, 0);
+  Slots.assign(PoolSize * PoolSize, NoTile);
+  Entries.assign(TileCount, 0);
+
+  Pool = CreateSampledImage(VK_FORMAT_R8G8B8A8_SRGB, PoolSize * TileSize, PoolSize * TileSize, 1, 0);
+  PoolSampler = CreateSampler(1, 0.f);
+
+  CreatePipeline();
+
+  // the single top tile is always resident, every lookup has somewhere to fall back to
+  Upload(TileCount - 1);
+  Context->Uploads->Flush();
+
+  RebuildEntries();
+  CreateBuffers(Context->SwapImages.size());
+}
+
+VirtualTexture::~VirtualTexture()
+{
+  Workers.WaitIdle();
+
+  DestroyBuffers();
+
+  vkDestroyPipeline(Context->Device, Pipeline, nullptr);
+  vkDestroyPipelineLayout(Context->Device, Layout, nullptr);
+  vkDestroyDescriptorPool(Context->Device, DescriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(Context->Device, SetLayout, nullptr);
+
+  vkDestroySampler(Context->Device, PoolSampler, nullptr);
+  DestroyImage(Pool);
+}
+
+void VirtualTexture::CreateBuffers(uint32_t ImageCount)
+{
+  VkPhysicalDeviceProperties DevProps;
+  vkGetPhysicalDeviceProperties(Context->PhysicalDevice, &DevProps);
+
+  VkDeviceSize Alignment = DevProps.limits.minStorageBufferOffsetAlignment;
+  VkDeviceSize TableSize = sizeof(TableHeader) + Entries.size() * sizeof(uint32_t);
+  VkDeviceSize FeedbackSize = Entries.size() * sizeof(uint32_t);
+
+  TableStride = AlignUp(TableSize, Alignment);
+  FeedbackStride = AlignUp(FeedbackSize, Alignment);
+
+  Table = CreateHostBuffer(TableStride * ImageCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  Feedback = CreateReadbackBuffer(FeedbackStride * ImageCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+  memset(Feedback.Memory.Mapped, 0, FeedbackStride * ImageCount);
+  Context->Allocator->Flush(Feedback.Memory, 0, FeedbackStride * ImageCount);
+
+  ImageVersions.assign(ImageCount, 0);
+
+  for(uint32_t i = 0; i < ImageCount; i++)
+  {
+    WriteTable(i, glm::vec4(0.f, 0.f, 1.f, 1.f));
+  }
+
+  // the offsets are dynamic, one descriptor covers whichever image's region is bound
+  VkDescriptorImageInfo PoolInfo{};
+  PoolInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  PoolInfo.imageView = Pool.ImageView;
+  PoolInfo.sampler = PoolSampler;
+
+  VkDescriptorBufferInfo TableInfo{};
+  TableInfo.buffer = Table.Buffer;
+  TableInfo.offset = 0;
+  TableInfo.range = TableSize;
+
+  VkDescriptorBufferInfo FeedbackInfo{};
+  FeedbackInfo.buffer = Feedback.Buffer;
+  FeedbackInfo.offset = 0;
+  FeedbackInfo.range = FeedbackSize;
+
+  VkWriteDescriptorSet Writes[3]{};
+
+  for(uint32_t w = 0; w < 3; w++)
+  {
+    Writes[w].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    Writes[w].dstSet = Set;
+    Writes[w].dstBinding = w;
+    Writes[w].descriptorCount = 1;
+    Writes[w].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  }
+
+  Writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  Writes[0].pImageInfo = &PoolInfo;
+  Writes[1].pBufferInfo = &TableInfo;
+  Writes[2].pBufferInfo = &FeedbackInfo;
+
+  vkUpdateDescriptorSets(Context->Device, 3, Writes, 0, nullptr);
+}
+
+void VirtualTexture::DestroyBuffers()
+{
+  DestroyBuffer(Table);
+  DestroyBuffer(Feedback);
+}
+
+void VirtualTexture::Resize(uint32_t ImageCount)
+{
+  DestroyBuffers();
+  CreateBuffers(ImageCount);
+}
+
+void VirtualTexture::Touch(uint32_t Tile)
+{
+  // ancestors are what the lookup falls back to, they stay as long as anything below them is wanted
+  while(Tile != NoTile && LastUsed[Tile] != Frame)
+  {
+    LastUsed[Tile] = Frame;
+    Tile = Parents[Tile];
+  }
+}
+
+void VirtualTexture::Load(uint32_t Tile)
+{
+  Pending[Tile] = 1;
+  InFlight++;
+
+  // the render thread copies straight out of the mapping, the workers only fault the pages in so that copy never waits on the disk
+  Workers.Submit([this, Tile]
+  {
+    Cache.Prefetch(Tile);
+
+    const volatile uint8_t* Bytes = Cache.Tile(Tile);
+    for(uint64_t Offset = 0; Offset < Cache.TileBytes(); Offset += 4096)
+    {
+      (void)Bytes[Offset];
+    }
+
+    uint32_t Done = Tile;
+    Loaded.Push(std::move(Done));
+  });
+}
+
+bool VirtualTexture::Upload(uint32_t Tile)
+{
+  uint32_t Slot = NoTile;
+
+  if(Resident < Slots.size())
+  {
+    Slot = std::find(Slots.begin(), Slots.end(), NoTile) - Slots.begin();
+  }
+  else
+  {
+    // least recently used, never the top tile
+    uint64_t Oldest = Frame;
+
+    for(uint32_t s = 0; s < Slots.size(); s++)
+    {
+      if(Slots[s] != Entries.size() - 1 && LastUsed[Slots[s]] < Oldest)
+      {
+        Oldest = LastUsed[Slots[s]];
+        Slot = s;
+      }
+    }
+
+    // everything resident was used this frame, swapping would only trade one visible tile for another
+    if(Slot == NoTile)
+    {
+      return false;
+    }
+
+    SlotOf[Slots[Slot]] = NoTile;
+    Resident--;
+  }
+
+  uint32_t TileSize = Cache.Header().TileSize;
+
+  // ordered on the graphics queue after every frame already submitted, its barrier waits for them to stop sampling the old tile
+  Context->Uploads->UploadRegion(Pool, Cache.Tile(Tile), (Slot % PoolSize) * TileSize, (Slot / PoolSize) * TileSize, TileSize, TileSize, 4);
+
+  Slots[Slot] = Tile;
+  SlotOf[Tile] = Slot;
+  Resident++;
+
+  // not a candidate for the next upload of the same frame
+  LastUsed[Tile] = Frame;
+
+  return true;
+}
+
+void VirtualTexture::RebuildEntries()
+{
+  const std::vector<TileLevel>& Levels = Cache.Levels();
+
+  // coarse to fine, so a missing tile copies its parent's already final entry
+  for(uint32_t l = Levels.size(); l-- > 0;)
+  {
+    uint32_t First = Levels[l].First;
+    uint32_t Last = First + Levels[l].TilesX * Levels[l].TilesY;
+
+    for(uint32_t t = First; t < Last; t++)
+    {
+      uint32_t Slot = SlotOf[t];
+
+      if(Slot != NoTile)
+      {
+        Entries[t] = (Slot % PoolSize) | ((Slot / PoolSize) << 12) | (l << 24);
+      }
+      else
+      {
+        Entries[t] = Entries[Parents[t]];
+      }
+    }
+  }
+
+  Version++;
+}
+
+void VirtualTexture::WriteTable(uint32_t ImageIndex, const glm::vec4& View)
+{
+  const TileCacheHeader& Info = Cache.Header();
+  const std::vector<TileLevel>& Levels = Cache.Levels();
+
+  TableHeader Header{};
+  Header.Info = glm::uvec4(Info.Width, Info.Height, Info.LevelCount, Entries.size());
+  Header.Tile = glm::uvec4(Info.TileSize, Info.Border, PoolSize, 0);
+  Header.View = View;
+
+  for(size_t l = 0; l < Levels.size(); l++)
+  {
+    Header.Levels[l] = glm::uvec4(Levels[l].Width, Levels[l].Height, Levels[l].TilesX, Levels[l].First);
+  }
+
+  VkDeviceSize Offset = ImageIndex * TableStride;
+  VkDeviceSize Size = sizeof(Header);
+
+  memcpy(static_cast<uint8_t*>(Table.Memory.Mapped) + Offset, &Header, sizeof(Header));
+
+  // the view changes every frame, the entries only when tiles came or went since this image last saw them
+  if(ImageVersions[ImageIndex] != Version)
+  {
+    memcpy(static_cast<uint8_t*>(Table.Memory.Mapped) + Offset + sizeof(Header), Entries.data(), Entries.size() * sizeof(uint32_t));
+    Size += Entries.size() * sizeof(uint32_t);
+
+    ImageVersions[ImageIndex] = Version;
+  }
+
+  Context->Allocator->Flush(Table.Memory, Offset, Size);
+}
+
+void VirtualTexture::Update(uint32_t ImageIndex, const glm::vec4& View)
+{
+  Frame++;
+
+  // Feedback
+    // BeginFrame waited for this image's last frame, and its barrier made the shader writes visible to the host
+    VkDeviceSize Offset = ImageIndex * FeedbackStride;
+    VkDeviceSize Size = Entries.size() * sizeof(uint32_t);
+
+    Context->Allocator->Invalidate(Feedback.Memory, Offset, Size);
+
+    uint32_t* Requested = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(Feedback.Memory.Mapped) + Offset);
+    Requests.clear();
+
+    for(uint32_t t = 0; t < Entries.size(); t++)
+    {
+      if(Requested[t])
+      {
+        Touch(t);
+
+        if(SlotOf[t] == NoTile && !Pending[t])
+        {
+          Requests.push_back(t);
+        }
+      }
+    }
+
+    memset(Requested, 0, Size);
+    Context->Allocator->Flush(Feedback.Memory, Offset, Size);
+  // Feedback
+
+  // Streaming
+    // coarse levels first, they sit later in the cache and each one sharpens everything below it
+    std::sort(Requests.begin(), Requests.end(), std::greater<uint32_t>());
+
+    for(uint32_t Tile : Requests)
+    {
+      if(InFlight == MaxLoadsInFlight)
+      {
+        break;
+      }
+
+      Load(Tile);
+    }
+
+    bool Changed = false;
+    uint32_t Uploads = 0;
+    uint32_t Tile;
+
+    while(Uploads < MaxUploadsPerFrame && Loaded.Pop(Tile))
+    {
+      Pending[Tile] = 0;
+      InFlight--;
+
+      // a dropped tile is asked for again by the next frame that still sees it
+      if(SlotOf[Tile] == NoTile && Upload(Tile))
+      {
+        Changed = true;
+        Uploads++;
+      }
+    }
+
+    if(Changed)
+    {
+      Context->Uploads->Flush();
+      RebuildEntries();
+    }
+  // Streaming
+
+  WriteTable(ImageIndex, View);
+}
+
+void VirtualTexture::Record(VkCommandBuffer Cmd, uint32_t ImageIndex)
+{
+  uint32_t Offsets[2] = { uint32_t(ImageIndex * TableStride), uint32_t(ImageIndex * FeedbackStride) };
+
+  vkCmdBindPipeline(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+  vkCmdBindDescriptorSets(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, Layout, 0, 1, &Set, 2, Offsets);
+
+  vkCmdDraw(Cmd, 3, 1, 0, 0);
+}
+
+void VirtualTexture::CreatePipeline()
+{
+  // Descriptors
+    VkDescriptorSetLayoutBinding Bindings[3]{};
+    Bindings[0] = { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    Bindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    Bindings[2] = { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+
+    VkDescriptorSetLayoutCreateInfo SetLayoutCI{};
+    SetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    SetLayoutCI.bindingCount = 3;
+    SetLayoutCI.pBindings = Bindings;
+
+    if(vkCreateDescriptorSetLayout(Context->Device, &SetLayoutCI, nullptr, &SetLayout) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create virtual texture set layout");
+    }
+
+    VkDescriptorPoolSize PoolSizes[2]{};
+    PoolSizes[0] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 };
+    PoolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2 };
+
+    VkDescriptorPoolCreateInfo PoolCI{};
+    PoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    PoolCI.maxSets = 1;
+    PoolCI.poolSizeCount = 2;
+    PoolCI.pPoolSizes = PoolSizes;
+
+    if(vkCreateDescriptorPool(Context->Device, &PoolCI, nullptr, &DescriptorPool) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create virtual texture descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo SetAllocInfo{};
+    SetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    SetAllocInfo.descriptorPool = DescriptorPool;
+    SetAllocInfo.descriptorSetCount = 1;
+    SetAllocInfo.pSetLayouts = &SetLayout;
+
+    if(vkAllocateDescriptorSets(Context->Device, &SetAllocInfo, &Set) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to allocate virtual texture descriptor set");
+    }
+  // Descriptors
+
+  // Shaders
+    VkShaderModule Vert = CreateShaderModule(VtVertSpirv, sizeof(VtVertSpirv));
+    VkShaderModule Frag = CreateShaderModule(VtFragSpirv, sizeof(VtFragSpirv));
+
+    VkPipelineShaderStageCreateInfo Stages[2]{};
+    Stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    Stages[0].pName = "main";
+    Stages[0].module = Vert;
+    Stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+
+    Stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    Stages[1].pName = "main";
+    Stages[1].module = Frag;
+    Stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  // Shaders
+
+  // Layout
+    VkPipelineLayoutCreateInfo PipeLayoutInfo{};
+    PipeLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    PipeLayoutInfo.setLayoutCount = 1;
+    PipeLayoutInfo.pSetLayouts = &SetLayout;
+
+    if(vkCreatePipelineLayout(Context->Device, &PipeLayoutInfo, nullptr, &Layout) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create virtual texture pipeline layout");
+    }
+  // Layout
+
+  // Input state
+    // the triangle's corners come from gl_VertexIndex
+    VkPipelineVertexInputStateCreateInfo VertInput{};
+    VertInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo InputState{};
+    InputState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    InputState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    InputState.primitiveRestartEnable = VK_FALSE;
+  // Input state
+
+  // Viewport
+    VkPipelineViewportStateCreateInfo ViewPortInfo{};
+    ViewPortInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    ViewPortInfo.scissorCount = 1;
+    ViewPortInfo.viewportCount = 1;
+
+    VkDynamicState DynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo DynamicInfo{};
+    DynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    DynamicInfo.dynamicStateCount = 2;
+    DynamicInfo.pDynamicStates = DynamicStates;
+  // Viewport
+
+  // Color
+    VkPipelineColorBlendAttachmentState ColorBlendAttachment{};
+    ColorBlendAttachment.blendEnable = VK_FALSE;
+    ColorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo ColorBlendInfo{};
+    ColorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    ColorBlendInfo.logicOpEnable = VK_FALSE;
+    ColorBlendInfo.attachmentCount = 1;
+    ColorBlendInfo.pAttachments = &ColorBlendAttachment;
+  // Color
+
+  // Rasterizer
+    VkPipelineRasterizationStateCreateInfo Rasterizer{};
+    Rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    Rasterizer.cullMode = VK_CULL_MODE_NONE;
+    Rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    Rasterizer.lineWidth = 1.f;
+    Rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  // Rasterizer
+
+  VkPipelineDepthStencilStateCreateInfo DepthStencilState{};
+  DepthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  DepthStencilState.depthTestEnable = VK_FALSE;
+  DepthStencilState.depthWriteEnable = VK_FALSE;
+
+  VkPipelineMultisampleStateCreateInfo MultisampleState{};
+  MultisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  MultisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkGraphicsPipelineCreateInfo GraphicsPipe{};
+  GraphicsPipe.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  GraphicsPipe.layout = Layout;
+  GraphicsPipe.stageCount = 2;
+  GraphicsPipe.pStages = Stages;
+  GraphicsPipe.renderPass = Context->Renderpass;
+  GraphicsPipe.subpass = 0;
+  GraphicsPipe.pVertexInputState = &VertInput;
+  GraphicsPipe.pInputAssemblyState = &InputState;
+  GraphicsPipe.pViewportState = &ViewPortInfo;
+  GraphicsPipe.pDynamicState = &DynamicInfo;
+  GraphicsPipe.pColorBlendState = &ColorBlendInfo;
+  GraphicsPipe.pRasterizationState = &Rasterizer;
+  GraphicsPipe.pMultisampleState = &MultisampleState;
+  GraphicsPipe.pDepthStencilState = &DepthStencilState;
+
+  if(vkCreateGraphicsPipelines(Context->Device, Context->Pipelines->Get(), 1, &GraphicsPipe, nullptr, &Pipeline) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create virtual texture pipeline");
+  }
+
+  vkDestroyShaderModule(Context->Device, Vert, nullptr);
+  vkDestroyShaderModule(Context->Device, Frag, nullptr);
+}
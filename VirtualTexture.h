@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vulkan.h"
+#include "TileCache.h"
+#include "ThreadPool.h"
+
+// Draws one image of any size out of a tile cache, through a fixed pool of resident tiles.
+// The pool is a single texture holding PoolTiles x PoolTiles tiles of any level, and a page table maps every tile of
+// every level to the pool slot of its closest resident ancestor. The fragment shader writes which tiles it wanted into
+// a feedback buffer, those are read back once the frame retires, loaded off the render thread and uploaded into free
+// or least recently used slots. GPU memory is the pool plus the tables, however big the source is.
+// Each swap image has its own region of the page table and feedback buffers, picked with a dynamic offset, so the
+// recorded command buffers never change and a region is only touched after its image's last frame has finished.
+class VirtualTexture
+{
+  public:
+  static const uint32_t DefaultPoolTiles = 32;
+
+  // CachePath is a tile cache from PrepareTileCache. PoolTiles is clamped to what one texture can hold.
+  VirtualTexture(const std::string& CachePath, uint32_t PoolTiles = DefaultPoolTiles);
+  // Destroy with the device idle.
+  ~VirtualTexture();
+
+  // Swap image count changes on recreation, there are table and feedback regions per image. Call with the device idle.
+  void Resize(uint32_t ImageCount);
+
+  // Reads the feedback ImageIndex's last frame left, streams tiles in and writes ImageIndex's page table.
+  // View is the visible part of the image as u0, v0, u1, v1. Call after BeginFrame returned ImageIndex.
+  void Update(uint32_t ImageIndex, const glm::vec4& View);
+
+  // Records the full screen draw for ImageIndex, inside the render pass.
+  void Record(VkCommandBuffer Cmd, uint32_t ImageIndex);
+
+  uint32_t Width() const { return Cache.Header().Width; }
+  uint32_t Height() const { return Cache.Header().Height; }
+  uint32_t LevelCount() const { return Cache.Header().LevelCount; }
+  uint32_t ResidentCount() const { return Resident; }
+
+  private:
+  static const uint32_t MaxLevels = 16;
+  static const uint32_t NoTile = ~0u;
+  // loads queued on the workers at once, and uploads out of them per frame
+  static const uint32_t MaxLoadsInFlight = 64;
+  static const uint32_t MaxUploadsPerFrame = 16;
+
+  // laid out as the shader's PageTable block, the entries follow it
+  struct TableHeader
+  {
+    glm::uvec4 Info;                // width, height, level count, tile count
+    glm::uvec4 Tile;                // tile size, border, pool size in tiles, 0
+    glm::vec4 View;
+    glm::uvec4 Levels[MaxLevels];   // width, height, tiles across, first tile
+  };
+
+  void CreatePipeline();
+  void CreateBuffers(uint32_t ImageCount);
+  void DestroyBuffers();
+
+  void Touch(uint32_t Tile);
+  void Load(uint32_t Tile);
+  // Returns false if every slot holds a tile this frame needs.
+  bool Upload(uint32_t Tile);
+  void RebuildEntries();
+  void WriteTable(uint32_t ImageIndex, const glm::vec4& View);
+
+  TileCache Cache;
+  uint32_t PoolSize;            // in tiles per side
+
+  Image Pool;
+  VkSampler PoolSampler;
+
+  VkDescriptorSetLayout SetLayout;
+  VkDescriptorPool DescriptorPool;
+  VkDescriptorSet Set;
+  VkPipelineLayout Layout;
+  VkPipeline Pipeline;
+
+  Buffer Table;                 // host written, one region per swap image
+  Buffer Feedback;              // GPU written, one region per swap image
+  VkDeviceSize TableStride;
+  VkDeviceSize FeedbackStride;
+
+  // master copy of the entries, each image's region is rewritten when its version falls behind
+  std::vector<uint32_t> Entries;
+  std::vector<uint64_t> ImageVersions;
+  uint64_t Version = 1;
+
+  std::vector<uint32_t> Parents;     // per tile, the tile one level up covering it
+  std::vector<uint32_t> SlotOf;      // per tile, NoTile unless resident
+  std::vector<uint64_t> LastUsed;    // per tile, the last frame it or a descendant was asked for
+  std::vector<uint8_t> Pending;      // per tile, queued on the workers
+  std::vector<uint32_t> Slots;       // per pool slot, the tile in it or NoTile
+  std::vector<uint32_t> Requests;
+
+  uint64_t Frame = 0;
+  uint32_t Resident = 0;
+  uint32_t InFlight = 0;
+
+  CompletionQueue<uint32_t> Loaded;
+
+  // declared last so workers are joined before the cache they read from is unmapped
+  ThreadPool Workers;
+};
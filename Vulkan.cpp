@@ -0,0 +1,1119 @@
+#include <cstdlib>
+#include <ios>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <bitset>
+#include <algorithm>
+#include <string>
+#include <chrono>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include <vulkan/vk_enum_string_helper.h>
+#include <vulkan/vulkan_core.h>
+
+#include <glm/glm.hpp>
+
+#include "Vulkan.h"
+#include "Allocator.h"
+#include "Upload.h"
+#include "PipelineCache.h"
+#include "Profiler.h"
+#include "QuadBatch.h"
+#include "VirtualTexture.h"
+#include "PostProcess.h"
+#include "RenderGraph.h"
+#include "Timeline.h"
+#include "EmbeddedShaders.h"
+
+std::vector<const char*> Layers = {"VK_LAYER_KHRONOS_validation"};
+std::vector<const char*> InstExt = {"VK_KHR_external_memory_capabilities", "VK_KHR_surface"};
+std::vector<const char*> DevExt = {"VK_KHR_external_memory", "VK_KHR_external_memory_fd", "VK_KHR_swapchain"};
+
+Vulkan* Context;
+
+int GetMemIndex(uint32_t TypeBits, VkMemoryPropertyFlags Required, VkMemoryPropertyFlags Preferred)
+{
+  VkPhysicalDeviceMemoryProperties MemProps;
+  vkGetPhysicalDeviceMemoryProperties(Context->PhysicalDevice, &MemProps);
+
+  // first pass wants everything, second settles for what's required
+  VkMemoryPropertyFlags Wanted[2] = { Required | Preferred, Required };
+
+  for(VkMemoryPropertyFlags Flags : Wanted)
+  {
+    for(uint32_t i = 0; i < MemProps.memoryTypeCount; i++)
+    {
+      // std::cout << std::bitset<8>{MemProps.memoryTypes[i].propertyFlags} << '\n';
+      if((TypeBits & (1u << i)) && (MemProps.memoryTypes[i].propertyFlags & Flags) == Flags)
+      {
+        return i;
+      }
+    }
+  }
+
+  throw std::runtime_error("Failed to find valid memory type");
+}
+
+// The distinct families among graphics, transfer and compute, for CONCURRENT sharing. Returns how many there are.
+static uint32_t SharedFamilies(uint32_t (&Families)[3])
+{
+  uint32_t Count = 0;
+
+  for(uint32_t Family : { Context->GraphicsFamily, Context->TransferFamily, Context->ComputeFamily })
+  {
+    if(std::find(Families, Families + Count, Family) == Families + Count)
+    {
+      Families[Count++] = Family;
+    }
+  }
+
+  return Count;
+}
+
+Image CreateImage(VkFormat Format, VkExtent3D Extent, VkImageUsageFlags Usage, uint32_t MipLevels, bool AllQueues, VkImageCreateFlags Flags)
+{
+  Image Ret;
+
+  uint32_t Families[3];
+  uint32_t FamilyCount = SharedFamilies(Families);
+
+  VkImageCreateInfo ImageCI{};
+  ImageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  ImageCI.flags = Flags;
+  ImageCI.extent = Extent;
+  ImageCI.arrayLayers = 1;
+  ImageCI.format = Format;
+  ImageCI.imageType = VK_IMAGE_TYPE_2D;
+  ImageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  ImageCI.mipLevels = MipLevels;
+  ImageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+  ImageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  ImageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+  ImageCI.usage = Usage;
+
+  if(AllQueues && FamilyCount > 1)
+  {
+    ImageCI.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    ImageCI.queueFamilyIndexCount = FamilyCount;
+    ImageCI.pQueueFamilyIndices = Families;
+  }
+
+  if(vkCreateImage(Context->Device, &ImageCI, nullptr, &Ret.Image) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create Image");
+  }
+
+  VkMemoryRequirements MemReq;
+  vkGetImageMemoryRequirements(Context->Device, Ret.Image, &MemReq);
+
+  Ret.Memory = Context->Allocator->Allocate(MemReq, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, false);
+
+  vkBindImageMemory(Context->Device, Ret.Image, Ret.Memory.Memory, Ret.Memory.Offset);
+
+  Ret.ImageFormat = Format;
+  Ret.CurrentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  Ret.MipLevels = MipLevels;
+  Ret.Extent = Extent;
+
+  return Ret;
+}
+
+static Buffer CreateMappedBuffer(VkDeviceSize Size, VkBufferUsageFlags Usage, bool AllQueues, VkMemoryPropertyFlags Preferred)
+{
+  Buffer Ret;
+
+  uint32_t Families[3];
+  uint32_t FamilyCount = SharedFamilies(Families);
+
+  VkBufferCreateInfo BufferInf{};
+  BufferInf.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  BufferInf.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  BufferInf.size = Size;
+  BufferInf.usage = Usage;
+
+  if(AllQueues && FamilyCount > 1)
+  {
+    BufferInf.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    BufferInf.queueFamilyIndexCount = FamilyCount;
+    BufferInf.pQueueFamilyIndices = Families;
+  }
+
+  if(vkCreateBuffer(Context->Device, &BufferInf, nullptr, &Ret.Buffer) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create host buffer");
+  }
+
+  VkMemoryRequirements MemReq;
+  vkGetBufferMemoryRequirements(Context->Device, Ret.Buffer, &MemReq);
+
+  Ret.Memory = Context->Allocator->Allocate(MemReq, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, Preferred, true);
+
+  vkBindBufferMemory(Context->Device, Ret.Buffer, Ret.Memory.Memory, Ret.Memory.Offset);
+
+  return Ret;
+}
+
+Buffer CreateHostBuffer(VkDeviceSize Size, VkBufferUsageFlags Usage, bool AllQueues)
+{
+  // CPU writes it once front to back, so uncached coherent memory is the best fit when there is one
+  return CreateMappedBuffer(Size, Usage, AllQueues, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+Buffer CreateReadbackBuffer(VkDeviceSize Size, VkBufferUsageFlags Usage)
+{
+  // reads from uncached memory go across the bus one at a time, cached memory only needs an invalidate
+  return CreateMappedBuffer(Size, Usage, false, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+}
+
+Buffer CreateStagingBuffer(VkDeviceSize Size)
+{
+  // region uploads copy out of it on the graphics queue, everything else on the transfer queue
+  return CreateHostBuffer(Size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true);
+}
+
+void DestroyBuffer(Buffer& Target)
+{
+  vkDestroyBuffer(Context->Device, Target.Buffer, nullptr);
+  Context->Allocator->Free(Target.Memory);
+
+  Target.Buffer = VK_NULL_HANDLE;
+}
+
+Image CreateSampledImage(VkFormat Format, uint32_t Width, uint32_t Height, uint32_t MipLevels, VkImageUsageFlags Usage, bool AllQueues,
+                         VkImageCreateFlags Flags)
+{
+  Image Texture = CreateImage(Format, VkExtent3D{Width, Height, 1}, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | Usage, MipLevels,
+                              AllQueues, Flags);
+
+  // views inherit the image's usage, an sRGB one can't claim the storage usage its levels are written through
+  VkImageViewUsageCreateInfo ViewUsage{};
+  ViewUsage.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+  ViewUsage.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+  VkImageViewCreateInfo TextureViewCI{};
+  TextureViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  TextureViewCI.pNext = (Flags & VK_IMAGE_CREATE_EXTENDED_USAGE_BIT) ? &ViewUsage : nullptr;
+  TextureViewCI.image = Texture.Image;
+  TextureViewCI.format = Texture.ImageFormat;
+  TextureViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+
+  TextureViewCI.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+  TextureViewCI.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+  TextureViewCI.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+  TextureViewCI.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+  TextureViewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  TextureViewCI.subresourceRange.layerCount = 1;
+  TextureViewCI.subresourceRange.baseMipLevel = 0;
+  TextureViewCI.subresourceRange.levelCount = Texture.MipLevels;
+  TextureViewCI.subresourceRange.baseArrayLayer = 0;
+
+  if(vkCreateImageView(Context->Device, &TextureViewCI, nullptr, &Texture.ImageView) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create image view");
+  }
+
+  return Texture;
+}
+
+Image CreateTexture(const void* Pixels, uint32_t Width, uint32_t Height, const PixelConversion& Source)
+{
+  // full chain down to 1x1, TRANSFER_SRC because the levels are blitted from each other
+  uint32_t MipLevels = 1;
+  while((std::max(Width, Height) >> MipLevels) > 0)
+  {
+    MipLevels++;
+  }
+
+  VkImageUsageFlags Usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  VkImageCreateFlags Flags = 0;
+
+  // the mip kernel writes the levels through UNORM storage views
+  if(MipLevels > 1 && Context->Uploads->ComputesMips(VK_FORMAT_R8G8B8A8_SRGB))
+  {
+    Usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    Flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+  }
+
+  Image Texture = CreateSampledImage(VK_FORMAT_R8G8B8A8_SRGB, Width, Height, MipLevels, Usage, false, Flags);
+
+  // only recorded here, the caller decides when the batch goes to the GPU with Uploads->Flush()
+  Context->Uploads->UploadImage(Texture, Pixels, Width, Height, Source);
+
+  return Texture;
+}
+
+Image CreateCompressedTexture(const CompressedImage& Source)
+{
+  // TRANSFER_SRC so the residency manager can copy its smaller levels out when it drops the top ones
+  Image Texture = CreateSampledImage(Source.Format, Source.Width, Source.Height, Source.Levels.size(), VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+  Context->Uploads->UploadCompressed(Texture, Source);
+
+  return Texture;
+}
+
+void DestroyImage(Image& Target)
+{
+  vkDestroyImageView(Context->Device, Target.ImageView, nullptr);
+  vkDestroyImage(Context->Device, Target.Image, nullptr);
+  Context->Allocator->Free(Target.Memory);
+
+  Target.ImageView = VK_NULL_HANDLE;
+  Target.Image = VK_NULL_HANDLE;
+}
+
+std::vector<char> ReadFile(const char* FilePath)
+{
+  std::ifstream File(FilePath, std::ios::ate | std::ios::binary);
+
+  if(File.is_open())
+  {
+    size_t FileSize = File.tellg();
+
+    std::vector<char> Characters(FileSize);
+    File.seekg(0);
+    File.read(Characters.data(), FileSize);
+
+    File.close();
+
+    return Characters;
+  }
+
+  throw std::runtime_error("Failed to read a file");
+}
+
+// Views for each color image, swapchain owned or offscreen. What the frame draws into them is up to the frame graph.
+void CreateRenderTargets(const std::vector<VkImage>& ColorImages, VkFormat ColorFormat, VkImageLayout PresentLayout)
+{
+  Context->PresentLayout = PresentLayout;
+
+  for(uint32_t i = 0; i < ColorImages.size(); i++)
+  {
+    Context->SwapImages[i].Image = ColorImages[i];
+    Context->SwapImages[i].ImageFormat = ColorFormat;
+    Context->SwapImages[i].CurrentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    Context->SwapImages[i].MipLevels = 1;
+    Context->SwapImages[i].Extent = Context->Extent;
+
+    VkImageViewCreateInfo ImageView{};
+    ImageView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    ImageView.format = Context->SwapImages[i].ImageFormat;
+    ImageView.image = Context->SwapImages[i].Image;
+    ImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+
+    ImageView.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    ImageView.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    ImageView.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    ImageView.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+    ImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    ImageView.subresourceRange.baseMipLevel = 0;
+    ImageView.subresourceRange.levelCount = 1;
+    ImageView.subresourceRange.baseArrayLayer = 0;
+    ImageView.subresourceRange.layerCount = 1;
+
+    if(vkCreateImageView(Context->Device, &ImageView, nullptr, &Context->SwapImages[i].ImageView) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create swap image view");
+    }
+  }
+}
+
+void CreateSwapchain(VkSwapchainKHR OldSwapchain)
+{
+  VkSurfaceCapabilitiesKHR SurfaceCap;
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Context->PhysicalDevice, Context->RenderSurface, &SurfaceCap);
+
+  // 0xFFFFFFFF means the surface takes whatever size we pick
+  if(SurfaceCap.currentExtent.width != UINT32_MAX)
+  {
+    Context->Extent.width = SurfaceCap.currentExtent.width;
+    Context->Extent.height = SurfaceCap.currentExtent.height;
+  }
+
+  uint32_t PresentModeCount;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(Context->PhysicalDevice, Context->RenderSurface, &PresentModeCount, nullptr);
+  std::vector<VkPresentModeKHR> PresentModes(PresentModeCount);
+  vkGetPhysicalDeviceSurfacePresentModesKHR(Context->PhysicalDevice, Context->RenderSurface, &PresentModeCount, PresentModes.data());
+
+  uint32_t SurfaceFrmCount;
+  vkGetPhysicalDeviceSurfaceFormatsKHR(Context->PhysicalDevice, Context->RenderSurface, &SurfaceFrmCount, nullptr);
+  std::vector<VkSurfaceFormatKHR> SurfaceFormats(SurfaceFrmCount);
+  vkGetPhysicalDeviceSurfaceFormatsKHR(Context->PhysicalDevice, Context->RenderSurface, &SurfaceFrmCount, SurfaceFormats.data());
+  
+  // Swapchain
+    VkSwapchainCreateInfoKHR SwapCI{};
+    SwapCI.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    SwapCI.clipped = VK_TRUE;
+    SwapCI.surface = Context->RenderSurface;
+
+    SwapCI.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // post processing copies its output in instead of rendering to it, capture copies frames out
+    SwapCI.imageUsage |= SurfaceCap.supportedUsageFlags & (VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    SwapCI.imageExtent = VkExtent2D{Context->Extent.width, Context->Extent.height};
+    if(SurfaceFrmCount > 0)
+    {
+      SwapCI.imageFormat = SurfaceFormats[0].format;
+      SwapCI.imageColorSpace = SurfaceFormats[0].colorSpace;
+    }
+    else
+    {
+      throw std::runtime_error("no supported surface formats available");
+    }
+    SwapCI.imageArrayLayers = 1; SwapCI.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    // one more than the minimum so acquire doesn't block while the presentation engine holds the rest
+    SwapCI.minImageCount = SurfaceCap.minImageCount + 1;
+    if(SurfaceCap.maxImageCount != 0 && SwapCI.minImageCount > SurfaceCap.maxImageCount)
+    {
+      SwapCI.minImageCount = SurfaceCap.maxImageCount;
+    }
+
+    // FIFO is the only mode every implementation has to support
+    SwapCI.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    for(VkPresentModeKHR Mode : PresentModes)
+    {
+      if(Mode == VK_PRESENT_MODE_MAILBOX_KHR)
+      {
+        SwapCI.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+      }
+    }
+    SwapCI.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    SwapCI.preTransform = SurfaceCap.currentTransform;
+    SwapCI.oldSwapchain = OldSwapchain;
+
+    if(vkCreateSwapchainKHR(Context->Device, &SwapCI, nullptr, &Context->Swapchain) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create swapchain");
+    }
+  // Swapchain
+
+  // Framebuffer
+    uint32_t FbCount;
+    vkGetSwapchainImagesKHR(Context->Device, Context->Swapchain, &FbCount, nullptr);
+    std::vector<VkImage> VkSwapImages(FbCount);
+    vkGetSwapchainImagesKHR(Context->Device, Context->Swapchain, &FbCount, VkSwapImages.data());
+    Context->SwapImages.resize(FbCount);
+
+    CreateRenderTargets(VkSwapImages, SwapCI.imageFormat, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+  //Framebuffer
+}
+
+void CreateOffscreenTargets(uint32_t Count)
+{
+  // stands in for the swapchain, the render pass and framebuffers don't know the difference
+  VkFormat ColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+  Context->SwapImages.resize(Count);
+  std::vector<VkImage> ColorImages(Count);
+
+  for(uint32_t i = 0; i < Count; i++)
+  {
+    Context->SwapImages[i] = CreateImage(ColorFormat, Context->Extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                                                     VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    ColorImages[i] = Context->SwapImages[i].Image;
+  }
+
+  CreateRenderTargets(ColorImages, ColorFormat, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+}
+
+void DestroySwapchainResources()
+{
+  for(uint32_t i = 0; i < Context->SwapImages.size(); i++)
+  {
+    vkDestroyImageView(Context->Device, Context->SwapImages[i].ImageView, nullptr);
+  }
+
+  Context->Graph->DestroyTargets();
+}
+
+void AllocateRenderBuffers()
+{
+  if(!Context->RenderBuffers.empty())
+  {
+    vkFreeCommandBuffers(Context->Device, Context->CommandPool, Context->RenderBuffers.size(), Context->RenderBuffers.data());
+  }
+
+  VkCommandBufferAllocateInfo CmdAllocInfo{};
+  CmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  CmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  CmdAllocInfo.commandPool = Context->CommandPool;
+  CmdAllocInfo.commandBufferCount = Context->SwapImages.size();
+
+  Context->RenderBuffers.resize(Context->SwapImages.size());
+
+  if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, Context->RenderBuffers.data()) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create command buffers");
+  }
+}
+
+void InitVulkan(uint32_t OffscreenCount)
+{
+  // headless runs never touch GLFW, there may be no display server at all
+  if(!Context->Headless)
+  {
+    glfwInit();
+
+    uint32_t glfwCount = 0;
+
+    const char** glfwExt = glfwGetRequiredInstanceExtensions(&glfwCount);
+
+    for(uint32_t i = 0; i < glfwCount; i++)
+    {
+      InstExt.push_back(glfwExt[i]);
+    }
+
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+    Context->Window = glfwCreateWindow(Context->Extent.width, Context->Extent.height, "Texture render", NULL, NULL);
+  }
+  else
+  {
+    InstExt.erase(std::remove(InstExt.begin(), InstExt.end(), std::string("VK_KHR_surface")), InstExt.end());
+    DevExt.erase(std::remove(DevExt.begin(), DevExt.end(), std::string("VK_KHR_swapchain")), DevExt.end());
+  }
+
+  VkApplicationInfo AppInfo{};
+  AppInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+  AppInfo.apiVersion = VK_API_VERSION_1_2;
+  AppInfo.pEngineName = "Texture Renderer";
+  AppInfo.engineVersion = 1;
+  AppInfo.pApplicationName = "TexRender";
+  AppInfo.applicationVersion = 1;
+
+  VkInstanceCreateInfo Info{};
+  Info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  Info.pApplicationInfo = &AppInfo;
+  Info.enabledLayerCount = Context->Validation ? Layers.size() : 0;
+  Info.ppEnabledLayerNames = Layers.data();
+  Info.enabledExtensionCount = InstExt.size();
+  Info.ppEnabledExtensionNames = InstExt.data();
+
+  if(vkCreateInstance(&Info, nullptr, &Context->Instance) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create instance");
+  }
+
+  uint32_t PDevCount;
+  vkEnumeratePhysicalDevices(Context->Instance, &PDevCount, nullptr);
+  std::vector<VkPhysicalDevice> PDevices(PDevCount);
+  vkEnumeratePhysicalDevices(Context->Instance, &PDevCount, PDevices.data());
+
+  if(PDevCount == 0)
+  {
+    throw std::runtime_error("No Vulkan devices available");
+  }
+
+  // prefer a discrete GPU, but take whatever there is, render nodes and CI may only have an integrated or CPU device
+  Context->PhysicalDevice = PDevices[0];
+
+  for(uint32_t i = 0; i < PDevCount; i++)
+  {
+    VkPhysicalDeviceProperties DevProps;
+    vkGetPhysicalDeviceProperties(PDevices[i], &DevProps);
+    if(DevProps.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+    {
+      Context->PhysicalDevice = PDevices[i];
+      break;
+    }
+  }
+
+  // Device
+    uint32_t QueueFamilyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties2(Context->PhysicalDevice, &QueueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> QueueProps(QueueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(Context->PhysicalDevice, &QueueFamilyCount, QueueProps.data());
+
+    for(uint32_t i = 0; i < QueueFamilyCount; i++)
+    {
+      if(QueueProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+      {
+        Context->GraphicsFamily = i;
+        break;
+      }
+    }
+
+    // a family with transfer but no graphics/compute is usually a DMA engine, uploads can run there alongside rendering
+    Context->TransferFamily = Context->GraphicsFamily;
+
+    for(uint32_t i = 0; i < QueueFamilyCount; i++)
+    {
+      VkQueueFlags Flags = QueueProps[i].queueFlags;
+      if((Flags & VK_QUEUE_TRANSFER_BIT) && !(Flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+      {
+        Context->TransferFamily = i;
+        break;
+      }
+    }
+
+    // likewise compute without graphics is an async compute engine, post processing overlaps the next frame's rendering there
+    Context->ComputeFamily = Context->GraphicsFamily;
+
+    for(uint32_t i = 0; i < QueueFamilyCount; i++)
+    {
+      VkQueueFlags Flags = QueueProps[i].queueFlags;
+      if((Flags & VK_QUEUE_COMPUTE_BIT) && !(Flags & VK_QUEUE_GRAPHICS_BIT))
+      {
+        Context->ComputeFamily = i;
+        break;
+      }
+    }
+
+    float QueuePriority = 1.f;
+
+    std::vector<VkDeviceQueueCreateInfo> QueueCIs;
+
+    VkDeviceQueueCreateInfo QueueCI{};
+    QueueCI.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    QueueCI.queueCount = 1;
+    QueueCI.queueFamilyIndex = Context->GraphicsFamily;
+    QueueCI.pQueuePriorities = &QueuePriority;
+    QueueCIs.push_back(QueueCI);
+
+    if(Context->TransferFamily != Context->GraphicsFamily)
+    {
+      QueueCI.queueFamilyIndex = Context->TransferFamily;
+      QueueCIs.push_back(QueueCI);
+    }
+
+    if(Context->ComputeFamily != Context->GraphicsFamily && Context->ComputeFamily != Context->TransferFamily)
+    {
+      QueueCI.queueFamilyIndex = Context->ComputeFamily;
+      QueueCIs.push_back(QueueCI);
+    }
+
+    // only turn on what something here uses
+    VkPhysicalDeviceFeatures Supported;
+    vkGetPhysicalDeviceFeatures(Context->PhysicalDevice, &Supported);
+
+    Context->Features = VkPhysicalDeviceFeatures{};
+    Context->Features.pipelineStatisticsQuery = Supported.pipelineStatisticsQuery;
+    // for the statistics query to stay active while a pass of secondaries executes
+    Context->Features.inheritedQueries = Supported.inheritedQueries;
+    Context->Features.samplerAnisotropy = Supported.samplerAnisotropy;
+    // virtual textures write their tile feedback from the fragment shader
+    Context->Features.fragmentStoresAndAtomics = Supported.fragmentStoresAndAtomics;
+
+    // the texture table is one big partially bound array, there's no fallback to per-texture sets
+    VkPhysicalDeviceDescriptorIndexingFeatures SupportedIndexing{};
+    SupportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+    // every submission signals its queue's timeline, there are no fences to fall back to either
+    VkPhysicalDeviceTimelineSemaphoreFeatures SupportedTimeline{};
+    SupportedTimeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    SupportedIndexing.pNext = &SupportedTimeline;
+
+    VkPhysicalDeviceFeatures2 SupportedFeatures{};
+    SupportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    SupportedFeatures.pNext = &SupportedIndexing;
+    vkGetPhysicalDeviceFeatures2(Context->PhysicalDevice, &SupportedFeatures);
+
+    if(!SupportedIndexing.runtimeDescriptorArray || !SupportedIndexing.descriptorBindingPartiallyBound ||
+       !SupportedIndexing.descriptorBindingVariableDescriptorCount || !SupportedIndexing.descriptorBindingSampledImageUpdateAfterBind ||
+       !SupportedIndexing.descriptorBindingUpdateUnusedWhilePending || !SupportedIndexing.shaderSampledImageArrayNonUniformIndexing)
+    {
+      throw std::runtime_error("Device doesn't support descriptor indexing");
+    }
+
+    if(!SupportedTimeline.timelineSemaphore)
+    {
+      throw std::runtime_error("Device doesn't support timeline semaphores");
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures Timeline{};
+    Timeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    Timeline.timelineSemaphore = VK_TRUE;
+
+    VkPhysicalDeviceDescriptorIndexingFeatures Indexing{};
+    Indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    Indexing.runtimeDescriptorArray = VK_TRUE;
+    Indexing.descriptorBindingPartiallyBound = VK_TRUE;
+    Indexing.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    Indexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    Indexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    Indexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    Indexing.pNext = &Timeline;
+
+    // the driver's own budget and usage numbers per heap, only a hint so it's fine to go without
+    uint32_t ExtCount = 0;
+    vkEnumerateDeviceExtensionProperties(Context->PhysicalDevice, nullptr, &ExtCount, nullptr);
+    std::vector<VkExtensionProperties> Extensions(ExtCount);
+    vkEnumerateDeviceExtensionProperties(Context->PhysicalDevice, nullptr, &ExtCount, Extensions.data());
+
+    Context->MemoryBudget = false;
+
+    for(const VkExtensionProperties& Extension : Extensions)
+    {
+      if(strcmp(Extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+      {
+        DevExt.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        Context->MemoryBudget = true;
+      }
+    }
+
+    // core from 1.2, older devices only have it as an extension
+    VkPhysicalDeviceProperties DevProps;
+    vkGetPhysicalDeviceProperties(Context->PhysicalDevice, &DevProps);
+    if(DevProps.apiVersion < VK_API_VERSION_1_2)
+    {
+      DevExt.push_back("VK_EXT_descriptor_indexing");
+      DevExt.push_back("VK_KHR_timeline_semaphore");
+    }
+
+    VkDeviceCreateInfo DevCI{};
+    DevCI.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    DevCI.pNext = &Indexing;
+    DevCI.queueCreateInfoCount = QueueCIs.size();
+    DevCI.pQueueCreateInfos = QueueCIs.data();
+    DevCI.enabledExtensionCount= DevExt.size();
+    DevCI.ppEnabledExtensionNames = DevExt.data();
+    DevCI.pEnabledFeatures = &Context->Features;
+
+    if(vkCreateDevice(Context->PhysicalDevice, &DevCI, nullptr, &Context->Device) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create device");
+    }
+  // Device
+
+  Context->Allocator = new MemoryAllocator();
+
+  vkGetDeviceQueue(Context->Device, Context->GraphicsFamily, 0, &Context->GraphicsQueue);
+  vkGetDeviceQueue(Context->Device, Context->TransferFamily, 0, &Context->TransferQueue);
+  vkGetDeviceQueue(Context->Device, Context->ComputeFamily, 0, &Context->ComputeQueue);
+
+  if(Context->Headless)
+  {
+    CreateOffscreenTargets(OffscreenCount);
+  }
+  else
+  {
+    VkResult SurfaceError = glfwCreateWindowSurface(Context->Instance, Context->Window, nullptr, &Context->RenderSurface);
+    std::cout << SurfaceError << '\n';
+
+    CreateSwapchain(VK_NULL_HANDLE);
+  }
+
+  // Command Pool
+    VkCommandPoolCreateInfo CommandPoolCI{};
+    CommandPoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    CommandPoolCI.queueFamilyIndex = Context->GraphicsFamily;
+    CommandPoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if(vkCreateCommandPool(Context->Device, &CommandPoolCI, nullptr, &Context->CommandPool) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create a command pool");
+    }
+
+    AllocateRenderBuffers();
+  // Command Pool
+
+  Context->Sync = new TimelineSync();
+  Context->Uploads = new Uploader(64 * 1024 * 1024);
+
+  std::cout << "Finished Initiating vulkan\n";
+}
+
+void InitRendering(Image* Texture)
+{
+  Context->Graph = new RenderGraph();
+  RenderGraph& Graph = *Context->Graph;
+
+  // Resources
+    // the post processor's kernel reads the scene on the compute queue and writes the swap image itself
+    uint32_t Color;
+
+    if(Context->Post)
+    {
+      Color = Graph.Import("Scene", [](uint32_t i) -> Image& { return Context->Post->Scene(i); });
+      Graph.Export(Color, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+    else
+    {
+      Color = Graph.Import("Swap image", [](uint32_t i) -> Image& { return Context->SwapImages[i]; });
+      Graph.Export(Color, Context->PresentLayout);
+    }
+
+    // uploads leave it readable, there's nothing to do for it unless that changes
+    uint32_t Sampled = Graph.Import("Texture", [Texture](uint32_t) -> Image& { return *Texture; });
+
+    // no pipeline turns depth testing on, so nothing reads it and the graph drops it
+    uint32_t Depth = Graph.Create("Depth", VK_FORMAT_D16_UNORM);
+  // Resources
+
+  Context->MainPass = Graph.AddPass("Main", PassType::Graphics);
+  Graph.WriteColor(Context->MainPass, Color);
+  Graph.WriteDepth(Context->MainPass, Depth);
+  Graph.ReadTexture(Context->MainPass, Sampled);
+
+  Graph.Compile();
+
+  Context->Renderpass = Graph.Renderpass(Context->MainPass);
+
+  CreateFramebuffers();
+}
+
+void CreateFramebuffers()
+{
+  Context->Graph->CreateTargets();
+}
+
+VkShaderModule CreateShaderModule(const uint32_t* Code, size_t Size)
+{
+  VkShaderModuleCreateInfo ShaderInfo{};
+  ShaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  ShaderInfo.codeSize = Size;
+  ShaderInfo.pCode = Code;
+
+  VkShaderModule Module;
+  if(vkCreateShaderModule(Context->Device, &ShaderInfo, nullptr, &Module) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create shader module");
+  }
+
+  return Module;
+}
+
+VkPipeline InitPipeline(Image* Texture, VkDescriptorSetLayout TextureLayout)
+{
+  VkShaderModule Vert;
+  VkShaderModule Frag;
+
+  VkPipeline Pipeline;
+
+  // Shaders
+    // compiled into the binary at build time, no shader files to find at startup
+    Vert = CreateShaderModule(VertSpirv, sizeof(VertSpirv));
+    Frag = CreateShaderModule(FragSpirv, sizeof(FragSpirv));
+
+    VkPipelineShaderStageCreateInfo VertStage{};
+    VertStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    VertStage.pName = "main";
+    VertStage.module = Vert;
+    VertStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkPipelineShaderStageCreateInfo FragStage{};
+    FragStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    FragStage.pName = "main";
+    FragStage.module = Frag;
+    FragStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    std::vector<VkPipelineShaderStageCreateInfo> ShaderStages = { VertStage, FragStage };
+  // Shaders
+
+  VkPipelineLayoutCreateInfo PipeLayoutInfo{};
+  PipeLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  PipeLayoutInfo.setLayoutCount = 1;
+  PipeLayoutInfo.pSetLayouts = &TextureLayout;
+
+  // which texture table slot the draw samples
+  VkPushConstantRange TextureIndexRange{};
+  TextureIndexRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  TextureIndexRange.offset = 0;
+  TextureIndexRange.size = sizeof(uint32_t);
+
+  PipeLayoutInfo.pushConstantRangeCount = 1;
+  PipeLayoutInfo.pPushConstantRanges = &TextureIndexRange;
+
+  if(vkCreatePipelineLayout(Context->Device, &PipeLayoutInfo, nullptr, &Context->PipeLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create pipeline layout");
+  }
+
+
+
+  // Viewport
+    // viewport and scissor are set at record time so the pipeline survives swapchain resizes
+    VkPipelineViewportStateCreateInfo ViewPortInfo{};
+    ViewPortInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    ViewPortInfo.scissorCount = 1;
+    ViewPortInfo.viewportCount = 1;
+
+    VkDynamicState DynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo DynamicInfo{};
+    DynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    DynamicInfo.dynamicStateCount = 2;
+    DynamicInfo.pDynamicStates = DynamicStates;
+  // ViewPort
+
+  // Color 
+    VkPipelineColorBlendAttachmentState ColorBlendAttachment{};
+    ColorBlendAttachment.blendEnable = VK_FALSE;
+    ColorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo ColorBlendInfo{};
+    ColorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    ColorBlendInfo.logicOpEnable = VK_FALSE;
+    ColorBlendInfo.logicOp = VK_LOGIC_OP_COPY;
+    ColorBlendInfo.attachmentCount = 1;
+    ColorBlendInfo.pAttachments = &ColorBlendAttachment;
+  // Color
+
+  // Rasterizer
+    VkPipelineRasterizationStateCreateInfo Rasterizer{};
+    Rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    Rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    Rasterizer.depthClampEnable = VK_FALSE;
+    Rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    Rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    Rasterizer.lineWidth = 1.f;
+    Rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    Rasterizer.depthBiasEnable = VK_FALSE;
+  // Rasterizer
+
+  // Depth Stencil
+    VkPipelineDepthStencilStateCreateInfo DepthStencilState{};
+    DepthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    DepthStencilState.depthTestEnable = VK_FALSE;
+    DepthStencilState.depthWriteEnable = VK_FALSE;
+    DepthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    DepthStencilState.depthBoundsTestEnable = VK_FALSE;
+    DepthStencilState.minDepthBounds = 0.f;
+    DepthStencilState.maxDepthBounds = 1.f;
+    DepthStencilState.stencilTestEnable = VK_FALSE;
+  // Depth stencil
+
+  // Input state
+    VkPipelineVertexInputStateCreateInfo VertInput{};
+    VertInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VertInput.vertexAttributeDescriptionCount = 0;
+    VertInput.vertexBindingDescriptionCount = 0;
+  // Input state
+
+  // Input assembly
+    VkPipelineInputAssemblyStateCreateInfo InputState{};
+    InputState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    InputState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    InputState.primitiveRestartEnable = VK_FALSE;
+  // Input assembly
+
+  // MSAA
+    VkPipelineMultisampleStateCreateInfo MultisampleState{};
+    MultisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    MultisampleState.sampleShadingEnable = VK_FALSE;
+    MultisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  // MSAA
+
+  VkGraphicsPipelineCreateInfo GraphicsPipe{};
+  GraphicsPipe.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  GraphicsPipe.pVertexInputState = &VertInput;
+  GraphicsPipe.layout = Context->PipeLayout;
+  GraphicsPipe.stageCount = ShaderStages.size();
+  GraphicsPipe.pStages = ShaderStages.data();
+  GraphicsPipe.subpass = 0;
+  GraphicsPipe.renderPass = Context->Renderpass;
+  GraphicsPipe.pViewportState = &ViewPortInfo;
+  GraphicsPipe.pDynamicState = &DynamicInfo;
+  GraphicsPipe.pColorBlendState = &ColorBlendInfo;
+  GraphicsPipe.pInputAssemblyState = &InputState;
+  GraphicsPipe.pRasterizationState = &Rasterizer;
+  GraphicsPipe.pMultisampleState = &MultisampleState;
+  GraphicsPipe.pDepthStencilState = &DepthStencilState;
+
+  auto CompileStart = std::chrono::steady_clock::now();
+
+  if(vkCreateGraphicsPipelines(Context->Device, Context->Pipelines->Get(), 1, &GraphicsPipe, nullptr, &Pipeline) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create graphics pipeline\n");
+  }
+
+  double CompileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - CompileStart).count();
+  std::cout << "Graphics pipeline created in " << CompileMs << "ms (" << (Context->Pipelines->Warm() ? "warm" : "cold") << " cache)\n";
+
+  vkDestroyShaderModule(Context->Device, Vert, nullptr);
+  vkDestroyShaderModule(Context->Device, Frag, nullptr);
+
+  return Pipeline;
+}
+
+VkSampler CreateSampler(uint32_t MipLevels, float Anisotropy)
+{
+  VkPhysicalDeviceProperties DevProps;
+  vkGetPhysicalDeviceProperties(Context->PhysicalDevice, &DevProps);
+  float MaxAnisotropy = DevProps.limits.maxSamplerAnisotropy;
+
+  VkSampler TextureSampler;
+
+  VkSamplerCreateInfo SamplerCI{};
+  SamplerCI.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  SamplerCI.minFilter = VK_FILTER_LINEAR;
+  SamplerCI.magFilter = VK_FILTER_LINEAR;
+
+  SamplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  SamplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  SamplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+
+  // only if it was asked for and the device feature is on
+  SamplerCI.anisotropyEnable = Anisotropy > 1.f && Context->Features.samplerAnisotropy ? VK_TRUE : VK_FALSE;
+  SamplerCI.maxAnisotropy = SamplerCI.anisotropyEnable ? std::min(Anisotropy, MaxAnisotropy) : 1.f;
+
+  SamplerCI.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+  SamplerCI.unnormalizedCoordinates = VK_FALSE;
+
+  SamplerCI.compareEnable = VK_FALSE;
+  SamplerCI.compareOp = VK_COMPARE_OP_ALWAYS;
+
+  SamplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  SamplerCI.mipLodBias = 0.0f;
+  SamplerCI.minLod = 0.f;
+  SamplerCI.maxLod = MipLevels - 1;
+
+  if(vkCreateSampler(Context->Device, &SamplerCI, nullptr, &TextureSampler) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create sampler");
+  }
+
+  return TextureSampler;
+}
+
+void SetRenderArea(VkCommandBuffer Cmd)
+{
+  VkViewport ViewPort{};
+  ViewPort.width = Context->Extent.width;
+  ViewPort.height = Context->Extent.height;
+  ViewPort.x = 0;
+  ViewPort.y = 0;
+  ViewPort.minDepth = 0.f;
+  ViewPort.maxDepth = 1.f;
+
+  VkRect2D RenderArea{};
+  RenderArea.extent.width = Context->Extent.width;
+  RenderArea.extent.height = Context->Extent.height;
+
+  vkCmdSetViewport(Cmd, 0, 1, &ViewPort);
+  vkCmdSetScissor(Cmd, 0, 1, &RenderArea);
+}
+
+void RecordFrame(VkCommandBuffer Cmd, uint32_t ImageIndex, VkSubpassContents Contents, const std::function<void(VkCommandBuffer)>& Pass)
+{
+  RenderGraph* Graph = Context->Graph;
+  uint32_t MainPass = Context->MainPass;
+
+  GpuProfiler* Profiler = Context->Profiler;
+  uint32_t FrameScope, BarrierScope, PassScope, DrawScope;
+
+  if(Profiler)
+  {
+    FrameScope = Profiler->Scope("Frame");
+    BarrierScope = Profiler->Scope("Barriers");
+    PassScope = Profiler->Scope("Render pass");
+    DrawScope = Profiler->Scope("Draw");
+  }
+
+  VkCommandBufferBeginInfo BeginInf{};
+  BeginInf.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+  uint32_t i = ImageIndex;
+
+  vkBeginCommandBuffer(Cmd, &BeginInf);
+    if(Profiler)
+    {
+      Profiler->Reset(Cmd, i);
+      Profiler->BeginScope(Cmd, i, FrameScope);
+      Profiler->BeginScope(Cmd, i, BarrierScope);
+    }
+
+    // usually nothing, the sampled texture is already readable and the color target is handled by the render pass
+    Graph->RecordBarriers(Cmd, i, MainPass);
+
+    if(Profiler)
+    {
+      Profiler->EndScope(Cmd, i, BarrierScope);
+      Profiler->BeginScope(Cmd, i, PassScope);
+    }
+
+    // a pass of secondaries can only execute them, queries move out around the whole pass
+    bool Inline = Contents == VK_SUBPASS_CONTENTS_INLINE;
+
+    if(Profiler && !Inline)
+    {
+      Profiler->BeginScope(Cmd, i, DrawScope);
+      Profiler->BeginStatistics(Cmd, i, true);
+    }
+
+    Graph->BeginPass(Cmd, i, MainPass, Contents);
+
+      if(Profiler && Inline)
+      {
+        Profiler->BeginScope(Cmd, i, DrawScope);
+        Profiler->BeginStatistics(Cmd, i);
+      }
+
+      Pass(Cmd);
+
+      if(Profiler && Inline)
+      {
+        Profiler->EndStatistics(Cmd, i);
+        Profiler->EndScope(Cmd, i, DrawScope);
+      }
+
+    Graph->EndPass(Cmd, i, MainPass);
+
+    if(Profiler && !Inline)
+    {
+      Profiler->EndStatistics(Cmd, i, true);
+      Profiler->EndScope(Cmd, i, DrawScope);
+    }
+
+    Graph->Finish(Cmd, i);
+
+    // the fence alone doesn't make shader writes visible to the host, the feedback is read back once it signals
+    if(Context->Virtual)
+    {
+      VkMemoryBarrier FeedbackBarrier{};
+      FeedbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      FeedbackBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+      FeedbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+      vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &FeedbackBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    if(Profiler)
+    {
+      Profiler->EndScope(Cmd, i, PassScope);
+      Profiler->EndScope(Cmd, i, FrameScope);
+    }
+  vkEndCommandBuffer(Cmd);
+}
+
+void RecordRenderBuffers(VkPipeline Pipeline, VkDescriptorSet TextureSet, uint32_t TextureIndex)
+{
+  for(uint32_t i = 0; i < Context->RenderBuffers.size(); i ++)
+  {
+    RecordFrame(Context->RenderBuffers[i], i, VK_SUBPASS_CONTENTS_INLINE, [&](VkCommandBuffer Cmd)
+    {
+      SetRenderArea(Cmd);
+
+      if(Context->Virtual)
+      {
+        // the page table and view are read from the image's buffers at execution time, nothing to re-record
+        Context->Virtual->Record(Cmd, i);
+      }
+      else if(Context->Quads)
+      {
+        // the batch replaces the single quad, its instance count comes from the buffer at execution time
+        Context->Quads->Record(Cmd, i, TextureSet);
+      }
+      else
+      {
+        RecordFullscreenQuad(Cmd, Pipeline, TextureSet, TextureIndex);
+      }
+    });
+  }
+}
+
+void RecordFullscreenQuad(VkCommandBuffer Cmd, VkPipeline Pipeline, VkDescriptorSet TextureSet, uint32_t TextureIndex)
+{
+  vkCmdBindDescriptorSets(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, Context->PipeLayout, 0, 1, &TextureSet, 0, nullptr);
+  vkCmdBindPipeline(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+  vkCmdPushConstants(Cmd, Context->PipeLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &TextureIndex);
+
+  vkCmdDraw(Cmd, 6, 1, 0, 0);
+}
+
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Allocator.h"
+#include "PixelConvert.h"
+
+class Uploader;
+class PipelineCache;
+class GpuProfiler;
+class TextureTable;
+class QuadBatch;
+class VirtualTexture;
+class PostProcessor;
+class RenderGraph;
+class TimelineSync;
+struct CompressedImage;
+
+struct Image
+{
+  VkImage Image;
+  VkImageView ImageView;
+  Allocation Memory;
+
+  VkFormat ImageFormat;
+  VkImageLayout CurrentLayout;
+  uint32_t MipLevels;
+  VkExtent3D Extent;     // of level 0
+};
+
+struct Buffer
+{
+  public:
+  Allocation Memory;
+  VkBuffer Buffer;
+};
+
+struct Vulkan
+{
+  public:
+  VkInstance Instance;
+  VkPhysicalDevice PhysicalDevice;
+  VkDevice Device;
+  VkPhysicalDeviceFeatures Features;   // what was enabled on Device, not everything the hardware has
+  bool MemoryBudget;                   // VK_EXT_memory_budget is enabled, the allocator reports the driver's numbers
+  VkRenderPass Renderpass;
+
+  GLFWwindow* Window;
+
+  VkCommandPool CommandPool;
+  std::vector<VkCommandBuffer> RenderBuffers;
+
+  VkPipelineLayout PipeLayout;
+
+  VkSurfaceKHR RenderSurface;
+  VkSwapchainKHR Swapchain;
+
+  uint32_t GraphicsFamily;
+  VkQueue GraphicsQueue;
+
+  // same as GraphicsFamily/GraphicsQueue when the device has no dedicated transfer family
+  uint32_t TransferFamily;
+  VkQueue TransferQueue;
+
+  // a compute family without graphics runs post processing alongside rendering, same as GraphicsFamily/GraphicsQueue otherwise
+  uint32_t ComputeFamily;
+  VkQueue ComputeQueue;
+
+  MemoryAllocator* Allocator;
+  TimelineSync* Sync;        // every queue submission goes through it
+  Uploader* Uploads;
+  PipelineCache* Pipelines;
+  GpuProfiler* Profiler;     // null unless profiling was asked for
+  TextureTable* Textures;
+  QuadBatch* Quads;          // null draws the single full screen quad
+  VirtualTexture* Virtual;   // replaces both when set, draws a tiled image streamed from a tile cache
+  PostProcessor* Post;       // null renders straight into the swap images
+
+  std::vector<Image> SwapImages;
+  VkImageLayout PresentLayout;   // what frames leave swap images in, PRESENT_SRC or COLOR_ATTACHMENT_OPTIMAL headless
+
+  // passes, attachments and barriers of a frame. Renderpass is its main pass's, the one every pipeline is made against
+  RenderGraph* Graph;
+  uint32_t MainPass;
+
+  VkExtent3D Extent{1280, 720, 1};
+
+  // no window, surface or swapchain. SwapImages are plain offscreen images and frames are never presented
+  bool Headless = false;
+
+  bool Validation = true;
+};
+
+extern Vulkan* Context;
+
+// Index of a memory type allowed by TypeBits with all of Required, and all of Preferred if one exists.
+int GetMemIndex(uint32_t TypeBits, VkMemoryPropertyFlags Required, VkMemoryPropertyFlags Preferred = 0);
+// AllQueues shares it between the graphics, transfer and compute families instead of transferring ownership.
+Image CreateImage(VkFormat Format, VkExtent3D Extent, VkImageUsageFlags Usage, uint32_t MipLevels = 1, bool AllQueues = false,
+                  VkImageCreateFlags Flags = 0);
+// Image plus a view over all of its levels, ready to be filled by the uploader. The view is only ever sampled, even if
+// Flags let Usage hold more than its format supports.
+Image CreateSampledImage(VkFormat Format, uint32_t Width, uint32_t Height, uint32_t MipLevels, VkImageUsageFlags Usage, bool AllQueues = false,
+                         VkImageCreateFlags Flags = 0);
+// Persistently mapped, Memory.Mapped is written directly and flushed with the allocator.
+// AllQueues shares it like CreateImage does.
+Buffer CreateHostBuffer(VkDeviceSize Size, VkBufferUsageFlags Usage, bool AllQueues = false);
+// Mapped like a host buffer but for the GPU to write and the CPU to read, invalidate before reading.
+Buffer CreateReadbackBuffer(VkDeviceSize Size, VkBufferUsageFlags Usage);
+Buffer CreateStagingBuffer(VkDeviceSize Size);
+void DestroyBuffer(Buffer& Target);
+// Size in bytes, Code is one of the SPIR-V arrays from EmbeddedShaders.h.
+VkShaderModule CreateShaderModule(const uint32_t* Code, size_t Size);
+std::vector<char> ReadFile(const char* FilePath);
+
+// Creates a sampled RGBA8 texture from tightly packed pixels laid out as Source describes. The copy is recorded into the
+// current upload batch, the texture is SHADER_READ_ONLY_OPTIMAL once that batch is flushed.
+Image CreateTexture(const void* Pixels, uint32_t Width, uint32_t Height, const PixelConversion& Source = PixelConversion{});
+
+// Same for a pre-baked KTX2/DDS image, every level is copied as is.
+Image CreateCompressedTexture(const CompressedImage& Source);
+void DestroyImage(Image& Target);
+
+// Setup, in order: InitVulkan, InitRendering, InitPipeline, then RecordRenderBuffers once the descriptors are written.
+// OffscreenCount is only used headless, it's how many targets stand in for the swapchain. A post processor has to exist
+// before InitRendering, the frame graph renders into its scene images instead of the swap images.
+void InitVulkan(uint32_t OffscreenCount);
+// Builds the frame graph, Texture is what the main pass samples.
+void InitRendering(Image* Texture);
+VkPipeline InitPipeline(Image* Texture, VkDescriptorSetLayout TextureLayout);
+// TextureSet is the texture table's set, TextureIndex the slot the quad samples.
+void RecordRenderBuffers(VkPipeline Pipeline, VkDescriptorSet TextureSet, uint32_t TextureIndex);
+
+// Records a whole frame for ImageIndex into Cmd: profiler scopes, the frame graph's barriers and its main pass, with Pass
+// recording what goes inside it. With SECONDARY_COMMAND_BUFFERS contents Pass may only execute secondaries.
+void RecordFrame(VkCommandBuffer Cmd, uint32_t ImageIndex, VkSubpassContents Contents, const std::function<void(VkCommandBuffer)>& Pass);
+// The single full screen quad sampling TextureIndex, inside the render pass.
+void RecordFullscreenQuad(VkCommandBuffer Cmd, VkPipeline Pipeline, VkDescriptorSet TextureSet, uint32_t TextureIndex);
+// Viewport and scissor over the whole render area. Dynamic state doesn't carry into secondaries, each one sets it.
+void SetRenderArea(VkCommandBuffer Cmd);
+
+// Swapchain recreation, with the device idle: DestroySwapchainResources, CreateSwapchain, CreateFramebuffers, AllocateRenderBuffers.
+// A post processor resizes before CreateFramebuffers.
+void CreateSwapchain(VkSwapchainKHR OldSwapchain);
+void CreateOffscreenTargets(uint32_t Count);
+void CreateRenderTargets(const std::vector<VkImage>& ColorImages, VkFormat ColorFormat, VkImageLayout PresentLayout);
+void DestroySwapchainResources();
+void CreateFramebuffers();
+void AllocateRenderBuffers();
+
+VkSampler CreateSampler(uint32_t MipLevels, float Anisotropy);
@@ -0,0 +1,41 @@
+# Writes SPIR-V binaries into a header as constexpr uint32_t arrays, run with cmake -P.
+#   HEADER   the header to write
+#   SPIRV    the .spv files, separated by ':' since ';' doesn't survive the command line
+# shader_name.spv becomes ShaderNameSpirv.
+
+string(REPLACE ":" ";" SPIRV "${SPIRV}")
+
+set(Content "// Generated from the GLSL sources at build time, do not edit.\n#pragma once\n\n#include <cstdint>\n")
+
+foreach(Path IN LISTS SPIRV)
+  get_filename_component(Name "${Path}" NAME_WE)
+
+  string(REPLACE "_" ";" Parts "${Name}")
+  set(Symbol "")
+
+  foreach(Part IN LISTS Parts)
+    string(SUBSTRING "${Part}" 0 1 First)
+    string(SUBSTRING "${Part}" 1 -1 Rest)
+    string(TOUPPER "${First}" First)
+    string(APPEND Symbol "${First}${Rest}")
+  endforeach()
+
+  file(READ "${Path}" Hex HEX)
+
+  # SPIR-V words are little endian, swap each group of four bytes into a literal
+  string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " Words "${Hex}")
+  string(REGEX REPLACE "((0x........, ){8})" "\\1\n  " Words "${Words}")
+  string(REGEX REPLACE ", \n  $" "" Words "${Words}")
+  string(REGEX REPLACE ", $" "" Words "${Words}")
+
+  string(APPEND Content "\nconstexpr uint32_t ${Symbol}Spirv[] =\n{\n  ${Words}\n};\n")
+endforeach()
+
+# only touch the header when it changed, so a rebuild doesn't recompile its includers for nothing
+if(EXISTS "${HEADER}")
+  file(READ "${HEADER}" Existing)
+endif()
+
+if(NOT "${Existing}" STREQUAL "${Content}")
+  file(WRITE "${HEADER}" "${Content}")
+endif()
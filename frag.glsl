@@ -1,8 +1,15 @@
 #version 450
 #pragma shader_stage(fragment)
 
+#extension GL_EXT_nonuniform_qualifier : require
+
 // Uniforms
-layout(set = 0, binding=0) uniform sampler2D InTexture;
+layout(set = 0, binding=0) uniform sampler2D Textures[];
+
+layout(push_constant) uniform DrawConstants
+{
+  uint TextureIndex;
+} Draw;
 
 // Input
 layout(location=0) in vec2 inCoord;
@@ -12,7 +19,7 @@ layout(location=0) out vec4 OutColor;
 
 void main()
 {
-  vec4 Alb = texture(InTexture, inCoord);
+  vec4 Alb = texture(Textures[Draw.TextureIndex], inCoord);
   OutColor = vec4(Alb.rgb, 1.0);
 }
 
@@ -1,976 +1,512 @@
 #include <cstdlib>
-#include <ios>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <fstream>
 #include <cstring>
-#include <bitset>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb/stb_image.h>
-
-#include <vulkan/vk_enum_string_helper.h>
-#include <vulkan/vulkan_core.h>
-
-#define GLFW_INCLUDE_VULKAN
-#include <GLFW/glfw3.h>
-
-#include <glm/glm.hpp>
-
-std::vector<const char*> Layers = {"VK_LAYER_KHRONOS_validation"};
-std::vector<const char*> InstExt = {"VK_KHR_external_memory_capabilities", "VK_KHR_surface"};
-std::vector<const char*> DevExt = {"VK_KHR_external_memory", "VK_KHR_external_memory_fd", "VK_KHR_swapchain"};
-
-struct Image
-{
-  VkImage Image;
-  VkImageView ImageView;
-  VkDeviceMemory Memory;
-  VkAttachmentDescription AttachmentDescription;
-  VkAttachmentReference AttachmentReference;
-
-  VkFormat ImageFormat;
-  VkImageLayout CurrentLayout;
-};
-
-struct Buffer
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "Vulkan.h"
+#include "TextureLoader.h"
+#include "Frames.h"
+#include "PipelineCache.h"
+#include "Profiler.h"
+#include "TextureTable.h"
+#include "QuadBatch.h"
+#include "Recorder.h"
+#include "VirtualTexture.h"
+#include "Residency.h"
+#include "PostProcess.h"
+#include "RenderGraph.h"
+#include "Capture.h"
+#include "Sequence.h"
+#include "Pacer.h"
+
+int main(int argc, char** argv)
 {
-  public:
-  VkDeviceMemory Memory;
-  VkBuffer Buffer;
-};
-
-struct Vulkan
-{
-  public:
-  VkInstance Instance;
-  VkPhysicalDevice PhysicalDevice;
-  VkDevice Device;
-  VkRenderPass Renderpass;
-
-  GLFWwindow* Window;
-
-  VkCommandPool CommandPool;
-  std::vector<VkCommandBuffer> RenderBuffers;
-
-  VkPipelineLayout PipeLayout;
-
-  VkSurfaceKHR RenderSurface;
-  VkSwapchainKHR Swapchain;
-
-  uint32_t GraphicsFamily;
-  VkQueue GraphicsQueue;
-
-  std::vector<Image> SwapImages;
-  std::vector<Image> DepthStencils;
-  std::vector<VkFramebuffer> FrameBuffers;
-  std::vector<VkFence> Fences;
-  std::vector<VkSemaphore> Semaphores;
-
-  VkExtent3D Extent{1280, 720, 1};
-};
-
-Vulkan* Context;
-
-int GetMemIndex(uint32_t MemFlags)
-{
-  VkPhysicalDeviceMemoryProperties MemProps;
-  vkGetPhysicalDeviceMemoryProperties(Context->PhysicalDevice, &MemProps);
-
-  for(int i = 0; i < MemProps.memoryTypeCount; i++)
+  uint32_t FramesInFlight = 2;
+  const char* PipelineCachePath = "pipeline.cache";
+  bool Headless = false;
+  bool Validation = true;
+  bool Profile = false;
+  float Anisotropy = 0.f;
+  const char* ProfilePath = nullptr;
+  uint64_t HeadlessFrames = 1000;
+  uint32_t QuadCount = 0;
+  bool ParallelRecord = false;
+  uint32_t RecordThreads = 0;
+  const char* TexturePath = "/home/ethanw/Repos/TextureRender/Texture.jpg";
+  const char* VirtualPath = nullptr;
+  std::vector<const char*> QuadTextures;
+  uint64_t TextureBudget = 0;
+  bool Post = false;
+  PostSettings PostOptions;
+  const char* CapturePath = nullptr;
+  CaptureFormat CaptureFmt = CaptureFormat::Png;
+  const char* SequencePath = nullptr;
+  float SequenceFps = 24.f;
+  uint32_t SequencePrefetch = 8;
+  bool OnDemand = false;
+  float MaxFps = 0.f;
+
+  for(int i = 1; i < argc; i++)
   {
-    // std::cout << std::bitset<8>{MemProps.memoryTypes[i].propertyFlags} << '\n';
-    if(MemProps.memoryTypes[i].propertyFlags & MemFlags)
+    if(strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
     {
-      return i;
+      FramesInFlight = std::max(1, atoi(argv[++i]));
     }
-  }
-
-  throw std::runtime_error("Failed to find valid memory type");
-}
-
-Image CreateImage(VkFormat Format, VkExtent3D Extent, VkImageUsageFlags Usage)
-{
-  Image Ret;
-
-  VkImageCreateInfo ImageCI{};
-  ImageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-  ImageCI.extent = Extent;
-  ImageCI.arrayLayers = 1;
-  ImageCI.format = Format;
-  ImageCI.imageType = VK_IMAGE_TYPE_2D;
-  ImageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  ImageCI.mipLevels = 1;
-  ImageCI.samples = VK_SAMPLE_COUNT_1_BIT;
-  ImageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  ImageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-  ImageCI.usage = Usage;
-
-  if(vkCreateImage(Context->Device, &ImageCI, nullptr, &Ret.Image) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to create Image");
-  }
-
-  VkMemoryRequirements MemReq;
-  vkGetImageMemoryRequirements(Context->Device, Ret.Image, &MemReq);
-
-  VkMemoryAllocateInfo AllocInfo{};
-  AllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  AllocInfo.allocationSize = MemReq.size;
-  AllocInfo.memoryTypeIndex = GetMemIndex(MemReq.memoryTypeBits);
-
-  if(vkAllocateMemory(Context->Device, &AllocInfo, nullptr, &Ret.Memory) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to Allocate memory");
-  }
-
-  // No offset because every Image will have dedicated allocations
-  vkBindImageMemory(Context->Device, Ret.Image, Ret.Memory, 0);
-
-  return Ret;
-}
-
-Buffer CreateStagingBuffer(VkDeviceSize Size)
-{
-  Buffer Ret;
-
-  VkBufferCreateInfo BufferInf{};
-  BufferInf.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  BufferInf.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  BufferInf.size = Size;
-  BufferInf.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-
-  if(vkCreateBuffer(Context->Device, &BufferInf, nullptr, &Ret.Buffer) != VK_SUCCESS)
-  {
-    throw std::runtime_error("failed to create staging buffer");
-  }
-
-  VkMemoryRequirements MemReq;
-  vkGetBufferMemoryRequirements(Context->Device, Ret.Buffer, &MemReq);
-
-  VkMemoryAllocateInfo AllocInf{};
-  AllocInf.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  AllocInf.allocationSize = MemReq.size;
-  AllocInf.memoryTypeIndex = GetMemIndex(MemReq.memoryTypeBits);
-
-  if(vkAllocateMemory(Context->Device, &AllocInf, nullptr, &Ret.Memory) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to allocate staging memory");
-  }
-
-  vkBindBufferMemory(Context->Device, Ret.Buffer, Ret.Memory, 0);
-}
-
-std::vector<char> ReadFile(const char* FilePath)
-{
-  std::ifstream File(FilePath, std::ios::ate | std::ios::binary);
-
-  if(File.is_open())
-  {
-    size_t FileSize = File.tellg();
-
-    std::vector<char> Characters(FileSize);
-    File.seekg(0);
-    File.read(Characters.data(), FileSize);
-
-    File.close();
-
-    return Characters;
-  }
-
-  throw std::runtime_error("Failed to read a file");
-}
-
-void InitVulkan()
-{
-  glfwInit();
-
-  uint32_t glfwCount = 0;
-
-  const char** glfwExt = glfwGetRequiredInstanceExtensions(&glfwCount);
-
-  for(uint32_t i = 0; i < glfwCount; i++)
-  {
-    InstExt.push_back(glfwExt[i]);
-  }
-
-
-
-
-
-
-  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-  Context->Window = glfwCreateWindow(Context->Extent.width, Context->Extent.height, "Texture render", NULL, NULL);
-
-  VkApplicationInfo AppInfo{};
-  AppInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-  AppInfo.apiVersion = VK_API_VERSION_1_2;
-  AppInfo.pEngineName = "Texture Renderer";
-  AppInfo.engineVersion = 1;
-  AppInfo.pApplicationName = "TexRender";
-  AppInfo.applicationVersion = 1;
-
-  VkInstanceCreateInfo Info{};
-  Info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-  Info.pApplicationInfo = &AppInfo;
-  Info.enabledLayerCount = Layers.size();
-  Info.ppEnabledLayerNames = Layers.data();
-  Info.enabledExtensionCount = InstExt.size();
-  Info.ppEnabledExtensionNames = InstExt.data();
-
-  if(vkCreateInstance(&Info, nullptr, &Context->Instance) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to create instance");
-  }
-
-  uint32_t PDevCount;
-  vkEnumeratePhysicalDevices(Context->Instance, &PDevCount, nullptr);
-  std::vector<VkPhysicalDevice> PDevices(PDevCount);
-  vkEnumeratePhysicalDevices(Context->Instance, &PDevCount, PDevices.data());
-
-  for(uint32_t i = 0; i < PDevCount; i++)
-  {
-    VkPhysicalDeviceProperties DevProps;
-    vkGetPhysicalDeviceProperties(PDevices[i], &DevProps);
-    if(DevProps.deviceType & VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+    else if(strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc)
     {
-      Context->PhysicalDevice = PDevices[i];
-      break;
+      PipelineCachePath = argv[++i];
     }
-  }
-
-  // Device
-    uint32_t QueueFamilyCount;
-    vkGetPhysicalDeviceQueueFamilyProperties2(Context->PhysicalDevice, &QueueFamilyCount, nullptr);
-    std::vector<VkQueueFamilyProperties> QueueProps(QueueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(Context->PhysicalDevice, &QueueFamilyCount, QueueProps.data());
-
-    for(uint32_t i = 0; i < QueueFamilyCount; i++)
+    else if(strcmp(argv[i], "--anisotropy") == 0 && i + 1 < argc)
     {
-      if(QueueProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
-      {
-        Context->GraphicsFamily = i;
-        break;
-      }
+      Anisotropy = atof(argv[++i]);
     }
-
-    VkDeviceQueueCreateInfo QueueCI{};
-    QueueCI.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    QueueCI.queueCount = 1;
-    QueueCI.queueFamilyIndex = Context->GraphicsFamily;
-
-    VkDeviceCreateInfo DevCI{};
-    DevCI.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    DevCI.queueCreateInfoCount = 1;
-    DevCI.pQueueCreateInfos = &QueueCI;
-    DevCI.enabledExtensionCount= DevExt.size();
-    DevCI.ppEnabledExtensionNames = DevExt.data();
-
-    if(vkCreateDevice(Context->PhysicalDevice, &DevCI, nullptr, &Context->Device) != VK_SUCCESS)
+    else if(strcmp(argv[i], "--profile") == 0)
     {
-      throw std::runtime_error("Failed to create device");
+      Profile = true;
     }
-  // Device
-
-  vkGetDeviceQueue(Context->Device, Context->GraphicsFamily, 0, &Context->GraphicsQueue);
-
-  VkResult SurfaceError = glfwCreateWindowSurface(Context->Instance, Context->Window, nullptr, &Context->RenderSurface);
-  std::cout << SurfaceError << '\n';
-
-  VkSurfaceCapabilitiesKHR SurfaceCap;
-  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Context->PhysicalDevice, Context->RenderSurface, &SurfaceCap);
-
-  uint32_t SurfaceFrmCount;
-  vkGetPhysicalDeviceSurfaceFormatsKHR(Context->PhysicalDevice, Context->RenderSurface, &SurfaceFrmCount, nullptr);
-  std::vector<VkSurfaceFormatKHR> SurfaceFormats(SurfaceFrmCount);
-  vkGetPhysicalDeviceSurfaceFormatsKHR(Context->PhysicalDevice, Context->RenderSurface, &SurfaceFrmCount, SurfaceFormats.data());
-  
-  // Swapchain
-    VkSwapchainCreateInfoKHR SwapCI{};
-    SwapCI.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    SwapCI.clipped = VK_TRUE;
-    SwapCI.surface = Context->RenderSurface;
-
-    SwapCI.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    SwapCI.imageExtent = VkExtent2D{Context->Extent.width, Context->Extent.height};
-    if(SurfaceFrmCount > 0)
+    else if(strcmp(argv[i], "--profile-out") == 0 && i + 1 < argc)
     {
-      SwapCI.imageFormat = SurfaceFormats[0].format;
-      SwapCI.imageColorSpace = SurfaceFormats[0].colorSpace;
+      Profile = true;
+      ProfilePath = argv[++i];
     }
-    else
+    else if(strcmp(argv[i], "--texture") == 0 && i + 1 < argc)
     {
-      throw std::runtime_error("no supported surface formats available");
+      TexturePath = argv[++i];
     }
-    SwapCI.imageArrayLayers = 1; SwapCI.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    SwapCI.minImageCount = SurfaceCap.minImageCount;
-
-    SwapCI.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
-    SwapCI.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    SwapCI.preTransform = SurfaceCap.currentTransform;
-
-    if(vkCreateSwapchainKHR(Context->Device, &SwapCI, nullptr, &Context->Swapchain) != VK_SUCCESS)
+    else if(strcmp(argv[i], "--quad-texture") == 0 && i + 1 < argc)
     {
-      throw std::runtime_error("Failed to create swapchain");
+      // repeatable, the quads cycle through every one given
+      QuadTextures.push_back(argv[++i]);
     }
-  // Swapchain
-
-  // Framebuffer
-    uint32_t FbCount;
-    vkGetSwapchainImagesKHR(Context->Device, Context->Swapchain, &FbCount, nullptr);
-    std::vector<VkImage> VkSwapImages(FbCount);
-    vkGetSwapchainImagesKHR(Context->Device, Context->Swapchain, &FbCount, VkSwapImages.data());
-    Context->SwapImages.resize(FbCount);
-
-    Context->DepthStencils.resize(FbCount);
-
-    Context->Fences.resize(FbCount);
-
-    for(uint32_t i = 0; i < FbCount; i++)
+    else if(strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
     {
-      Context->DepthStencils[i] = CreateImage(VK_FORMAT_D16_UNORM, Context->Extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
-      VkImageViewCreateInfo DepthView{};
-      DepthView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-      DepthView.format = VK_FORMAT_D16_UNORM;
-      DepthView.image = Context->DepthStencils[i].Image;
-      DepthView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-
-      DepthView.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-      DepthView.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-      DepthView.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-      DepthView.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-
-      DepthView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-      DepthView.subresourceRange.baseMipLevel = 0;
-      DepthView.subresourceRange.levelCount = 1;
-      DepthView.subresourceRange.baseArrayLayer = 0;
-      DepthView.subresourceRange.layerCount = 1;
-
-      if(vkCreateImageView(Context->Device, &DepthView, nullptr, &Context->DepthStencils[i].ImageView) != VK_SUCCESS)
-      {
-        throw std::runtime_error("failed to create depth image view");
-      }
-
-      Context->DepthStencils[i].AttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-      Context->DepthStencils[i].AttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-      Context->DepthStencils[i].AttachmentDescription.format = VK_FORMAT_D16_UNORM;
-      Context->DepthStencils[i].AttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-      Context->DepthStencils[i].AttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-      Context->DepthStencils[i].AttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-      Context->DepthStencils[i].AttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-      Context->DepthStencils[i].AttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-
-      Context->DepthStencils[i].AttachmentDescription.flags = 0;
-
-      Context->DepthStencils[i].AttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-      Context->DepthStencils[i].AttachmentReference.attachment = 1;
-
-
-      Context->SwapImages[i].Image = VkSwapImages[i];
-      Context->SwapImages[i].ImageFormat = SurfaceFormats[0].format;
-      Context->SwapImages[i].CurrentLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-      Context->SwapImages[i].AttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-      Context->SwapImages[i].AttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-      Context->SwapImages[i].AttachmentDescription.format = Context->SwapImages[i].ImageFormat;
-      Context->SwapImages[i].AttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-      Context->SwapImages[i].AttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-      Context->SwapImages[i].AttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-      Context->SwapImages[i].AttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-      Context->SwapImages[i].AttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-
-      Context->SwapImages[i].AttachmentDescription.flags = 0;
-
-      Context->SwapImages[i].AttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-      Context->SwapImages[i].AttachmentReference.attachment = 0;
-
-      VkImageViewCreateInfo ImageView{};
-      ImageView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-      ImageView.format = Context->SwapImages[i].ImageFormat;
-      ImageView.image = Context->SwapImages[i].Image;
-      ImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-
-      ImageView.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-      ImageView.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-      ImageView.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-      ImageView.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-
-      ImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-      ImageView.subresourceRange.baseMipLevel = 0;
-      ImageView.subresourceRange.levelCount = 1;
-      ImageView.subresourceRange.baseArrayLayer = 0;
-      ImageView.subresourceRange.layerCount = 1;
-
-      if(vkCreateImageView(Context->Device, &ImageView, nullptr, &Context->SwapImages[i].ImageView) != VK_SUCCESS)
+      // in MB, on top of what the device reports
+      TextureBudget = strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+    }
+    else if(strcmp(argv[i], "--virtual") == 0 && i + 1 < argc)
+    {
+      VirtualPath = argv[++i];
+    }
+    else if(strcmp(argv[i], "--post") == 0)
+    {
+      Post = true;
+    }
+    else if(strcmp(argv[i], "--exposure") == 0 && i + 1 < argc)
+    {
+      Post = true;
+      PostOptions.Exposure = atof(argv[++i]);
+    }
+    else if(strcmp(argv[i], "--sharpen") == 0 && i + 1 < argc)
+    {
+      Post = true;
+      PostOptions.Sharpen = atof(argv[++i]);
+    }
+    else if(strcmp(argv[i], "--lut") == 0 && i + 1 < argc)
+    {
+      Post = true;
+      PostOptions.LutPath = argv[++i];
+    }
+    else if(strcmp(argv[i], "--no-tonemap") == 0)
+    {
+      PostOptions.ToneMap = false;
+    }
+    else if(strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+    {
+      // every frame is written to this directory
+      CapturePath = argv[++i];
+    }
+    else if(strcmp(argv[i], "--capture-format") == 0 && i + 1 < argc)
+    {
+      if(!FrameCapture::ParseFormat(argv[++i], CaptureFmt))
       {
-        throw std::runtime_error("Failed to create swap image view");
+        throw std::runtime_error(std::string("Unknown capture format ") + argv[i] + ", expected png, jpg or raw");
       }
     }
-  //Framebuffer
-
-  // Command Pool
-    VkCommandPoolCreateInfo CommandPoolCI{};
-    CommandPoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    CommandPoolCI.queueFamilyIndex = Context->GraphicsFamily;
-    CommandPoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-
-    if(vkCreateCommandPool(Context->Device, &CommandPoolCI, nullptr, &Context->CommandPool) != VK_SUCCESS)
+    else if(strcmp(argv[i], "--sequence") == 0 && i + 1 < argc)
     {
-      throw std::runtime_error("Failed to create a command pool");
+      // a printf pattern like frames/%05d.png or a directory
+      SequencePath = argv[++i];
     }
-
-    VkCommandBufferAllocateInfo CmdAllocInfo{};
-    CmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    CmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    CmdAllocInfo.commandPool = Context->CommandPool;
-    CmdAllocInfo.commandBufferCount = Context->SwapImages.size();
-
-    Context->RenderBuffers.resize(Context->SwapImages.size());
-
-    if(vkAllocateCommandBuffers(Context->Device, &CmdAllocInfo, Context->RenderBuffers.data()) != VK_SUCCESS)
+    else if(strcmp(argv[i], "--sequence-fps") == 0 && i + 1 < argc)
     {
-      throw std::runtime_error("failed to create command buffers");
+      // 0 shows the next image every frame
+      SequenceFps = std::max(0.f, (float)atof(argv[++i]));
     }
-  // Command Pool
-
-  std::cout << "Finished Initiating vulkan\n";
-}
-
-void InitRendering(Image* Texture)
-{
-  VkSubpassDescription PrimarySubpass{};
-  // we will only be passing one frame buffer per frame. So we didn't need to give every framebuffer image a description and reference.
-
-  PrimarySubpass.colorAttachmentCount = 1;
-  PrimarySubpass.pColorAttachments = &Context->SwapImages[0].AttachmentReference;
-  PrimarySubpass.pDepthStencilAttachment = &Context->DepthStencils[0].AttachmentReference;
-  PrimarySubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-
-  VkSubpassDependency BarrierDependencies{};
-  BarrierDependencies.srcSubpass = 0;
-  BarrierDependencies.dstSubpass = 0;
-  BarrierDependencies.srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-  BarrierDependencies.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-  BarrierDependencies.srcAccessMask = 0; // From Undefined
-  BarrierDependencies.dstAccessMask = VK_ACCESS_SHADER_READ_BIT; // To Readable
-
-  VkRenderPassCreateInfo RenderpassInfo{};
-  RenderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-
-  std::vector<VkAttachmentDescription> Attachments = { Context->SwapImages[0].AttachmentDescription, Context->DepthStencils[0].AttachmentDescription };
-
-  // 1. Swapchain Image Attachment 2. Swapchain Depth stencil
-  // These attachments tell the renderpass what buffers are in the VkFramebuffers we will be using, in this case a color buffer for present, and a depth stencil for occlusion
-  RenderpassInfo.attachmentCount = Attachments.size();
-  RenderpassInfo.pAttachments = Attachments.data();
-  RenderpassInfo.subpassCount = 1;
-  RenderpassInfo.pSubpasses = &PrimarySubpass;
-  RenderpassInfo.dependencyCount = 1;
-  RenderpassInfo.pDependencies = &BarrierDependencies;
-
-  if(vkCreateRenderPass(Context->Device, &RenderpassInfo, nullptr, &Context->Renderpass) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to create renderpass");
-  }
-
-  Context->FrameBuffers.resize(Context->SwapImages.size());
-  Context->Semaphores.resize(Context->SwapImages.size());
-
-  for(uint32_t i = 0; i < Context->SwapImages.size(); i++)
-  {
-    VkFramebufferCreateInfo FBInfo{};
-    FBInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    FBInfo.renderPass = Context->Renderpass;
-
-    FBInfo.attachmentCount = 2;
-
-    VkImageView FrameBufferAttachments[] = { Context->SwapImages[i].ImageView, Context->DepthStencils[i].ImageView };
-
-    FBInfo.pAttachments = FrameBufferAttachments;
-    FBInfo.width = 1280;
-    FBInfo.height = 720;
-    FBInfo.layers = 1;
-
-    if(vkCreateFramebuffer(Context->Device, &FBInfo, nullptr, &Context->FrameBuffers[i]) != VK_SUCCESS)
+    else if(strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc)
     {
-      throw std::runtime_error("Failed to create a framebuffer");
+      SequencePrefetch = std::max(1, atoi(argv[++i]));
     }
-
-    VkFenceCreateInfo FenceInf{};
-    FenceInf.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-
-    if(vkCreateFence(Context->Device, &FenceInf, nullptr, &Context->Fences[i]) != VK_SUCCESS)
+    else if(strcmp(argv[i], "--on-demand") == 0)
     {
-      throw std::runtime_error("Failed to create fence");
+      OnDemand = true;
     }
-
-    VkSemaphoreCreateInfo SemaphoreInfo{};
-    SemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-    if(vkCreateSemaphore(Context->Device, &SemaphoreInfo, nullptr, &Context->Semaphores[i]) != VK_SUCCESS)
+    else if(strcmp(argv[i], "--max-fps") == 0 && i + 1 < argc)
     {
-      throw std::runtime_error("Failed to create semaphore");
+      // 0 doesn't cap
+      MaxFps = std::max(0.f, (float)atof(argv[++i]));
     }
-  }
-
-  vkResetFences(Context->Device, Context->SwapImages.size(), Context->Fences.data());
-}
-
-VkPipeline InitPipeline(Image* Texture, VkDescriptorSetLayout TextureLayout) {
-  VkShaderModule Vert;
-  VkShaderModule Frag;
-
-  VkPipeline Pipeline;
-
-  // Shaders
-    std::vector<char> VertCode, FragCode;
-    VertCode = ReadFile("/home/ethanw/Repos/TextureRender/Shaders/vert.spv");
-    FragCode = ReadFile("/home/ethanw/Repos/TextureRender/Shaders/frag.spv");
-
-    VkShaderModuleCreateInfo VertInfo{};
-    VertInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    VertInfo.pCode = reinterpret_cast<const uint32_t*>(VertCode.data());
-    VertInfo.codeSize = VertCode.size();
-
-    if(vkCreateShaderModule(Context->Device, &VertInfo, nullptr, &Vert) != VK_SUCCESS)
+    else if(strcmp(argv[i], "--headless") == 0)
     {
-      throw std::runtime_error("Failed to create Vertex shader");
+      Headless = true;
     }
-
-    VkShaderModuleCreateInfo FragInfo{};
-    FragInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    FragInfo.codeSize = FragCode.size();
-    FragInfo.pCode = reinterpret_cast<const uint32_t*>(FragCode.data());
-
-    if(vkCreateShaderModule(Context->Device, &FragInfo, nullptr, &Frag) != VK_SUCCESS)
+    else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
     {
-      throw std::runtime_error("Failed to create fragment Shader");
+      HeadlessFrames = strtoull(argv[++i], nullptr, 10);
     }
+    else if(strcmp(argv[i], "--quads") == 0 && i + 1 < argc)
+    {
+      QuadCount = std::max(0, atoi(argv[++i]));
+    }
+    else if(strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc)
+    {
+      // 0 is one thread per core
+      ParallelRecord = true;
+      RecordThreads = std::max(0, atoi(argv[++i]));
+    }
+    else if(strcmp(argv[i], "--no-validation") == 0)
+    {
+      Validation = false;
+    }
+  }
 
-    VkPipelineShaderStageCreateInfo VertStage{};
-    VertStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    VertStage.pName = "main";
-    VertStage.module = Vert;
-    VertStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  Context = new Vulkan();
+  Context->Headless = Headless;
+  Context->Validation = Validation;
 
-    VkPipelineShaderStageCreateInfo FragStage{};
-    FragStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    FragStage.pName = "main";
-    FragStage.module = Frag;
-    FragStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  // one offscreen target per frame slot, so a slot never waits on another slot's target
+  InitVulkan(FramesInFlight);
 
-    std::vector<VkPipelineShaderStageCreateInfo> ShaderStages = { VertStage, FragStage };
-  // Shaders
+  Context->Pipelines = new PipelineCache(PipelineCachePath);
+  Context->Profiler = Profile ? new GpuProfiler(Context->RenderBuffers.size()) : nullptr;
 
-  VkPipelineLayoutCreateInfo PipeLayoutInfo{};
-  PipeLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  PipeLayoutInfo.setLayoutCount = 1;
-  PipeLayoutInfo.pSetLayouts = &TextureLayout;
-  PipeLayoutInfo.pushConstantRangeCount = 0;
+  // Image
+    // decoding happens on the loader's workers, the placeholder is bound until the real texture is resident
+    TextureLoader Loader;
+    uint32_t TextureHandle = Loader.Load(TexturePath);
 
-  if(vkCreatePipelineLayout(Context->Device, &PipeLayoutInfo, nullptr, &Context->PipeLayout) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to create pipeline layout");
-  }
+    Image Texture = Loader.Get(TextureHandle);
+  // Image
 
+  VkSampler TextureSampler = CreateSampler(Texture.MipLevels, Anisotropy);
 
+  // Descriptor
+    // every texture goes into the one table, draws pick theirs with a push constant
+    Context->Textures = new TextureTable();
+    VkDescriptorSet TextureSet = Context->Textures->Set();
+
+    uint32_t TextureIndex = Context->Textures->Register(Texture, TextureSampler);
+  // Descriptor
 
-  // Viewport
-    VkViewport ViewPort{};
-    ViewPort.width = Context->Extent.width;
-    ViewPort.height = Context->Extent.height;
-    ViewPort.x = 0;
-    ViewPort.y = 0;
-    ViewPort.minDepth = 0.f;
-    ViewPort.maxDepth = 1.f;
-
-    VkRect2D RenderArea;
-    RenderArea.extent.width = Context->Extent.width;
-    RenderArea.extent.height = Context->Extent.height;
-    RenderArea.offset.x = 0;
-    RenderArea.offset.y = 0;
-
-    VkPipelineViewportStateCreateInfo ViewPortInfo{};
-    ViewPortInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    ViewPortInfo.scissorCount = 1;
-    ViewPortInfo.pScissors = &RenderArea;
-    ViewPortInfo.viewportCount = 1;
-    ViewPortInfo.pViewports = &ViewPort;
-  // ViewPort
-
-  // Color 
-    VkPipelineColorBlendAttachmentState ColorBlendAttachment{};
-    ColorBlendAttachment.blendEnable = VK_FALSE;
-    ColorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-    VkPipelineColorBlendStateCreateInfo ColorBlendInfo{};
-    ColorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    ColorBlendInfo.logicOpEnable = VK_FALSE;
-    ColorBlendInfo.logicOp = VK_LOGIC_OP_COPY;
-    ColorBlendInfo.attachmentCount = 1;
-    ColorBlendInfo.pAttachments = &ColorBlendAttachment;
-  // Color
-
-  // Rasterizer
-    VkPipelineRasterizationStateCreateInfo Rasterizer{};
-    Rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    Rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    Rasterizer.depthClampEnable = VK_FALSE;
-    Rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    Rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    Rasterizer.lineWidth = 1.f;
-    Rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    Rasterizer.depthBiasEnable = VK_FALSE;
-  // Rasterizer
-
-  // Depth Stencil
-    VkPipelineDepthStencilStateCreateInfo DepthStencilState{};
-    DepthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    DepthStencilState.depthTestEnable = VK_FALSE;
-    DepthStencilState.depthWriteEnable = VK_FALSE;
-    DepthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-    DepthStencilState.depthBoundsTestEnable = VK_FALSE;
-    DepthStencilState.minDepthBounds = 0.f;
-    DepthStencilState.maxDepthBounds = 1.f;
-    DepthStencilState.stencilTestEnable = VK_FALSE;
-  // Depth stencil
-
-  // Input state
-    VkPipelineVertexInputStateCreateInfo VertInput{};
-    VertInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    VertInput.vertexAttributeDescriptionCount = 0;
-    VertInput.vertexBindingDescriptionCount = 0;
-  // Input state
-
-  // Input assembly
-    VkPipelineInputAssemblyStateCreateInfo InputState{};
-    InputState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    InputState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    InputState.primitiveRestartEnable = VK_FALSE;
-  // Input assembly
-
-  // MSAA
-    VkPipelineMultisampleStateCreateInfo MultisampleState{};
-    MultisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    MultisampleState.sampleShadingEnable = VK_FALSE;
-    MultisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-  // MSAA
-
-  VkGraphicsPipelineCreateInfo GraphicsPipe{};
-  GraphicsPipe.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  GraphicsPipe.pVertexInputState = &VertInput;
-  GraphicsPipe.layout = Context->PipeLayout;
-  GraphicsPipe.stageCount = ShaderStages.size();
-  GraphicsPipe.pStages = ShaderStages.data();
-  GraphicsPipe.subpass = 0;
-  GraphicsPipe.renderPass = Context->Renderpass;
-  GraphicsPipe.pViewportState = &ViewPortInfo;
-  GraphicsPipe.pColorBlendState = &ColorBlendInfo;
-  GraphicsPipe.pInputAssemblyState = &InputState;
-  GraphicsPipe.pRasterizationState = &Rasterizer;
-  GraphicsPipe.pMultisampleState = &MultisampleState;
-  GraphicsPipe.pDepthStencilState = &DepthStencilState;
-
-  if(vkCreateGraphicsPipelines(Context->Device, nullptr, 1, &GraphicsPipe, nullptr, &Pipeline) != VK_SUCCESS)
+  // tone mapping, sharpening and grading in a compute pass after the render pass, on the async compute queue if there is one.
+  // The frame graph renders into its scene images, so it goes first
+  if(Post)
   {
-    throw std::runtime_error("Failed to create graphics pipeline\n");
+    Context->Post = new PostProcessor(PostOptions);
   }
 
-  return Pipeline;
-}
-
-int main()
-{
-  Context = new Vulkan();
-
-  InitVulkan();
-
-  // Image
-    int Width, Height, Channels;
-    stbi_uc* Pixels = stbi_load("/home/ethanw/Repos/TextureRender/Texture.jpg", &Width, &Height, &Channels, STBI_rgb_alpha);
+  InitRendering(&Texture);
 
-    Image Texture;
+  VkPipeline OurPipe = InitPipeline(&Texture, Context->Textures->Layout());
 
-    VkImageCreateInfo ImageCI{};
-    ImageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    ImageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-    ImageCI.extent = VkExtent3D{(uint32_t)Width, (uint32_t)Height, 1};
-    ImageCI.format = VK_FORMAT_R8G8B8A8_SRGB;
-    ImageCI.tiling = VK_IMAGE_TILING_LINEAR;
-    ImageCI.samples = VK_SAMPLE_COUNT_1_BIT;
-    ImageCI.imageType = VK_IMAGE_TYPE_2D;
-    ImageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    ImageCI.mipLevels = 1;
-    ImageCI.arrayLayers = 1;
-    ImageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  // a grid of tiles through the batch renderer instead of the one full screen quad
+  if(QuadCount > 0)
+  {
+    Context->Quads = new QuadBatch(QuadCount, Context->Textures->Layout());
+  }
 
-    Texture.ImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
-    Texture.CurrentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  // the quads' own textures are trimmed and evicted to stay in budget, and come back when they're drawn again
+  ResidencyManager* Residency = nullptr;
+  std::vector<uint32_t> QuadTextureIds;
 
+  if(Context->Quads && !QuadTextures.empty())
+  {
+    Residency = new ResidencyManager(Loader, FramesInFlight, Anisotropy, TextureBudget);
 
-    if(vkCreateImage(Context->Device, &ImageCI, nullptr, &Texture.Image) != VK_SUCCESS)
+    for(const char* Path : QuadTextures)
     {
-      throw std::runtime_error("Failed to create load texture");
+      QuadTextureIds.push_back(Residency->Add(Loader.Load(Path)));
     }
+  }
 
-    VkMemoryRequirements MemReqs;
-    vkGetImageMemoryRequirements(Context->Device, Texture.Image, &MemReqs);
-
-    VkMemoryAllocateInfo AllocInfo{};
-    AllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    AllocInfo.allocationSize = MemReqs.size;
-
-    AllocInfo.memoryTypeIndex = GetMemIndex(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+  // an image of any size streamed through a tile pool, cut into a cache next to it on the first run
+  if(VirtualPath)
+  {
+    std::string CachePath = std::string(VirtualPath) + ".vtc";
+    std::string Error;
 
-    if(vkAllocateMemory(Context->Device, &AllocInfo, nullptr, &Texture.Memory) != VK_SUCCESS)
+    if(!PrepareTileCache(VirtualPath, CachePath, Error))
     {
-      throw std::runtime_error("Failed to allocate memory");
+      throw std::runtime_error(Error);
     }
 
-    vkBindImageMemory(Context->Device, Texture.Image, Texture.Memory, 0);
-
-    void* Memory;
-
-    vkMapMemory(Context->Device, Texture.Memory, 0, MemReqs.size, 0, &Memory);
-      memcpy(Memory, Pixels, Height*Width*4);
-    vkUnmapMemory(Context->Device, Texture.Memory);
+    Context->Virtual = new VirtualTexture(CachePath);
+  }
 
-    VkImageViewCreateInfo TextureViewCI{};
-    TextureViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    TextureViewCI.image = Texture.Image;
-    TextureViewCI.format = Texture.ImageFormat;
-    TextureViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  // an image sequence played as the texture, decoded ahead on workers and uploaded into a ring of textures
+  SequencePlayer* Sequence = SequencePath ? new SequencePlayer(SequencePath, SequenceFps, SequencePrefetch, FramesInFlight, Anisotropy) : nullptr;
 
-    TextureViewCI.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-    TextureViewCI.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-    TextureViewCI.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-    TextureViewCI.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+  // recorded every frame on several threads, otherwise once per swap image up front.
+  // A sequence samples a different texture from one frame to the next, which buffers recorded once can't follow
+  CommandRecorder* Recorder = ParallelRecord || Sequence ? new CommandRecorder(FramesInFlight, RecordThreads) : nullptr;
 
-    TextureViewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    TextureViewCI.subresourceRange.layerCount = 1;
-    TextureViewCI.subresourceRange.baseMipLevel = 0;
-    TextureViewCI.subresourceRange.levelCount = 1;
-    TextureViewCI.subresourceRange.baseArrayLayer = 0;
+  if(!Recorder)
+  {
+    RecordRenderBuffers(OurPipe, TextureSet, TextureIndex);
+  }
 
-    if(vkCreateImageView(Context->Device, &TextureViewCI, nullptr, &Texture.ImageView) != VK_SUCCESS)
+  // Rendering
+    auto RecreateSwapchain = [&]()
     {
-      throw std::runtime_error("Failed to create image view");
-    }
-  // Image
-
-  VkSampler TextureSampler;
+      // a minimized window has a zero sized surface, nothing can be created until it comes back
+      int Width = 0, Height = 0;
+      glfwGetFramebufferSize(Context->Window, &Width, &Height);
+      while((Width == 0 || Height == 0) && !glfwWindowShouldClose(Context->Window))
+      {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(Context->Window, &Width, &Height);
+      }
 
-  VkSamplerCreateInfo SamplerCI{};
-  SamplerCI.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-  SamplerCI.minFilter = VK_FILTER_LINEAR;
-  SamplerCI.magFilter = VK_FILTER_LINEAR;
+      Context->Extent.width = Width;
+      Context->Extent.height = Height;
 
-  SamplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  SamplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  SamplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+      VkSwapchainKHR OldSwapchain = Context->Swapchain;
 
-  SamplerCI.anisotropyEnable = VK_FALSE;
+      DestroySwapchainResources();
+      CreateSwapchain(OldSwapchain);
+      vkDestroySwapchainKHR(Context->Device, OldSwapchain, nullptr);
 
-  SamplerCI.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-  SamplerCI.unnormalizedCoordinates = VK_FALSE;
+      if(Context->Post)
+      {
+        Context->Post->Resize();
+      }
 
-  SamplerCI.compareEnable = VK_FALSE;
-  SamplerCI.compareOp = VK_COMPARE_OP_ALWAYS;
+      CreateFramebuffers();
+      AllocateRenderBuffers();
 
-  SamplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-  SamplerCI.mipLodBias = 0.0f;
-  SamplerCI.minLod = 0.f;
-  SamplerCI.maxLod = 0.f;
+      if(Context->Profiler)
+      {
+        Context->Profiler->Resize(Context->RenderBuffers.size());
+      }
 
-  if(vkCreateSampler(Context->Device, &SamplerCI, nullptr, &TextureSampler) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to create sampler");
-  }
+      if(Context->Quads)
+      {
+        Context->Quads->Resize(Context->SwapImages.size());
+      }
 
-  // Descriptor
-    VkDescriptorPool FragShaderPool;
-    VkDescriptorSet TextureSet;
-    VkDescriptorSetLayout TextureSetLayout;
+      if(Context->Virtual)
+      {
+        Context->Virtual->Resize(Context->SwapImages.size());
+      }
 
-    VkDescriptorPoolSize ImageSize{};
-    ImageSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    ImageSize.descriptorCount = 1;
+      if(!Recorder)
+      {
+        RecordRenderBuffers(OurPipe, TextureSet, TextureIndex);
+      }
+    };
 
-    VkDescriptorPoolCreateInfo PoolInfo{};
-    PoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    PoolInfo.maxSets = 1;
-    PoolInfo.poolSizeCount = 1;
-    PoolInfo.pPoolSizes = &ImageSize;
+    FrameScheduler Frames(FramesInFlight, RecreateSwapchain);
 
-    if(vkCreateDescriptorPool(Context->Device, &PoolInfo, nullptr, &FragShaderPool) != VK_SUCCESS)
-    {
-      throw std::runtime_error("Failed descriptor Pool");
-    }
+    // copies run behind the frames and encoding on workers, the loop only waits if every slot is still busy
+    FrameCapture* Capture = CapturePath ? new FrameCapture(CapturePath, CaptureFmt) : nullptr;
 
-    VkDescriptorSetLayoutBinding SetBinding;
-    SetBinding.binding = 0;
-    SetBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    SetBinding.descriptorCount = 1;
-    SetBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    SetBinding.pImmutableSamplers = nullptr;
+    // on demand, a static image is rendered once and the loop sleeps in the event queue until something changes it.
+    // Quads spin, the virtual texture zooms and sequences play, any of them keeps frames coming at the cap.
+    // Headless runs have no events to wait on and go as fast as they can
+    FramePacer Pacer(OnDemand && !Context->Headless, Context->Headless ? 0.f : MaxFps);
+    Pacer.SetAnimating(Context->Quads || Context->Virtual || Sequence);
 
-    VkDescriptorSetLayoutCreateInfo TextureLayoutCI{};
-    TextureLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    TextureLayoutCI.pBindings = &SetBinding;
-    TextureLayoutCI.bindingCount = 1;
+    uint32_t ImageIndex = 0;
+    bool TextureBound = false;
 
-    if(vkCreateDescriptorSetLayout(Context->Device, &TextureLayoutCI, nullptr, &TextureSetLayout) != VK_SUCCESS)
+    // batch runs want the real texture in every frame, not the placeholder
+    if(Context->Headless)
     {
-      throw std::runtime_error("Failed to create descriptor");
+      Loader.WaitAll();
     }
 
-    VkDescriptorSetAllocateInfo DescriptorAllocInfo{};
-    DescriptorAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    DescriptorAllocInfo.descriptorPool = FragShaderPool;
-    DescriptorAllocInfo.descriptorSetCount = 1;
-    DescriptorAllocInfo.pSetLayouts = &TextureSetLayout;
-
-    if(vkAllocateDescriptorSets(Context->Device, &DescriptorAllocInfo, &TextureSet) != VK_SUCCESS)
+    while(Context->Headless ? Frames.FrameCount() < HeadlessFrames : !glfwWindowShouldClose(Context->Window))
     {
-      throw std::runtime_error("Failed to allocate descriptor");
-    }
-
-    VkImageMemoryBarrier TextureBarrier{};
-    TextureBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    TextureBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    TextureBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    TextureBarrier.image = Texture.Image;
-    TextureBarrier.oldLayout = Texture.CurrentLayout;
-    TextureBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    TextureBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    TextureBarrier.subresourceRange.layerCount = 1;
-    TextureBarrier.subresourceRange.levelCount = 1;
-    TextureBarrier.subresourceRange.baseMipLevel = 0;
-    TextureBarrier.subresourceRange.baseArrayLayer = 0;
-    TextureBarrier.srcAccessMask = 0;
-    TextureBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  // Descriptor
-
-  InitRendering(&Texture);
-
-  VkPipeline OurPipe = InitPipeline(&Texture, TextureSetLayout);
-
-  VkDescriptorImageInfo DescImgInf{};
-  DescImgInf.sampler = TextureSampler;
-  DescImgInf.imageView = Texture.ImageView;
-  DescImgInf.imageLayout = Texture.CurrentLayout;
+      if(!Context->Headless)
+      {
+        Pacer.Wait(Loader.PendingCount() > 0);
+      }
 
-  VkWriteDescriptorSet TextureWrite{};
-  TextureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      Loader.Poll();
 
-  TextureWrite.descriptorCount = 1;
-  TextureWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  TextureWrite.dstSet = TextureSet;
+      if(!TextureBound && Loader.IsResident(TextureHandle))
+      {
+        // the recorded buffers sample this slot, update-after-bind only covers slots no pending frame reads.
+        // This happens once per texture, not per frame.
+        vkDeviceWaitIdle(Context->Device);
 
-  TextureWrite.dstBinding = 0;
-  TextureWrite.dstArrayElement = 0;
-  TextureWrite.pImageInfo = &DescImgInf;
+        Texture = Loader.Get(TextureHandle);
 
-  vkUpdateDescriptorSets(Context->Device, 1, &TextureWrite, 0, nullptr);
+        // the placeholder's sampler only covers one level
+        vkDestroySampler(Context->Device, TextureSampler, nullptr);
+        TextureSampler = CreateSampler(Texture.MipLevels, Anisotropy);
 
-  // Commands
-    std::cout << "Filling command buffers\n";
-    VkClearDepthStencilValue DepthValue{};
-    DepthValue.stencil = 0;
-    DepthValue.depth = 0.1f;
+        Context->Textures->Update(TextureIndex, Texture, TextureSampler);
+        TextureBound = true;
 
-    VkClearValue DepthClear;
-    DepthClear.depthStencil = DepthValue;
+        Pacer.Invalidate();
+      }
 
-    VkClearColorValue ColorValue;
-    ColorValue.int32[0] = 0; ColorValue.int32[1] = 0; ColorValue.int32[2] = 0; ColorValue.int32[3] = 0;
-    ColorValue.uint32[0] = 0; ColorValue.uint32[1] = 0; ColorValue.uint32[2] = 0; ColorValue.uint32[3] = 0;
-    ColorValue.float32[0] = 0.f; ColorValue.float32[1] = 0.f; ColorValue.float32[2] = 0.f; ColorValue.float32[3] = 0.f;
+      if(!Pacer.Due())
+      {
+        continue;
+      }
 
-    VkClearValue ClearValue;
-    ClearValue.color = ColorValue;
+      // the recreated swapchain has nothing in it yet
+      if(!Frames.BeginFrame(ImageIndex))
+      {
+        Pacer.Invalidate();
+        continue;
+      }
 
-    VkClearValue Clears[2] = { DepthClear, ColorValue };
+      Pacer.Started();
 
-    for(int i = 0; i < Context->RenderBuffers.size(); i ++)
-    {
-      VkCommandBufferBeginInfo BeginInf{};
-      BeginInf.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      if(Residency)
+      {
+        Residency->Update();
+      }
 
-      VkRect2D RenderArea{(int32_t)Context->Extent.width, (int32_t)Context->Extent.height};
+      // the due image is copied on the transfer queue and the free staging buffers start on the next ones
+      if(Sequence)
+      {
+        Sequence->Update(Frames.FrameCount());
+        Frames.WaitFor(Sequence->Uploaded(), VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+      }
 
-      VkRenderPassBeginInfo RenderBegin{};
-      RenderBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-      RenderBegin.renderPass = Context->Renderpass;
-      RenderBegin.renderArea = RenderArea;
-      RenderBegin.clearValueCount = 2;
-      RenderBegin.pClearValues = Clears;
-      RenderBegin.framebuffer = Context->FrameBuffers[i];
+      // what the full screen quad and the quads sample this frame
+      uint32_t FrameTexture = Sequence && Sequence->Showing() ? Sequence->Current() : TextureIndex;
 
-      vkBeginCommandBuffer(Context->RenderBuffers[i], &BeginInf);
-        vkCmdPipelineBarrier(Context->RenderBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &TextureBarrier);
+      // BeginFrame waited for this image's last submission, its instance buffer is free to rewrite
+      if(Context->Quads)
+      {
+        uint32_t Columns = std::ceil(std::sqrt(float(QuadCount)));
+        glm::vec2 Tile = glm::vec2(Context->Extent.width, Context->Extent.height) / float(Columns);
+        float Spin = Frames.FrameCount() * 0.01f;
+
+        Context->Quads->Begin(ImageIndex);
+
+        for(uint32_t q = 0; q < QuadCount; q++)
+        {
+          Quad Instance{};
+          Instance.Position = Tile * (glm::vec2(q % Columns, q / Columns) + 0.5f);
+          Instance.Size = Tile * 0.9f;
+          Instance.UVRect = glm::vec4(0.f, 0.f, 1.f, 1.f);
+          Instance.Rotation = Spin + q * 0.1f;
+          Instance.TextureIndex = Residency ? Residency->Use(QuadTextureIds[q % QuadTextureIds.size()]) : FrameTexture;
+          Instance.Tint = QuadBatch::PackColor(1.f, 1.f, 1.f);
+
+          Context->Quads->Add(Instance);
+        }
+
+        Context->Quads->End();
+      }
 
-        vkCmdBeginRenderPass(Context->RenderBuffers[i], &RenderBegin, VK_SUBPASS_CONTENTS_INLINE);
+      // and its page table and feedback
+      if(Context->Virtual)
+      {
+        // zooms from the whole image fitting the screen down to one texel per pixel at the center and back
+        VirtualTexture* Virtual = Context->Virtual;
+        glm::vec2 Screen(Context->Extent.width, Context->Extent.height);
+        glm::vec2 Size(Virtual->Width(), Virtual->Height());
 
-          vkCmdBindDescriptorSets(Context->RenderBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, Context->PipeLayout, 0, 1, &TextureSet, 0, nullptr);
-          vkCmdBindPipeline(Context->RenderBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, OurPipe);
-          vkCmdDraw(Context->RenderBuffers[i], 4, 0, 0, 0);
+        float Fit = std::max(Size.x / Screen.x, Size.y / Screen.y);
+        float Zoom = 0.5f - 0.5f * std::cos(Frames.FrameCount() * 0.005f);
+        glm::vec2 Half = Screen * std::pow(Fit, 1.f - Zoom) * 0.5f / Size;
 
-        vkCmdEndRenderPass(Context->RenderBuffers[i]);
-      vkEndCommandBuffer(Context->RenderBuffers[i]);
-      std::cout << "filled command buffer\n";
-    }
-  // Commands
+        Virtual->Update(ImageIndex, glm::vec4(0.5f - Half, 0.5f + Half));
+      }
 
-  // Rendering
-    uint32_t FrameIndex = 0;
-    uint32_t ImageIndex = 0;
+      // same for its queries
+      if(Context->Profiler)
+      {
+        Context->Profiler->Collect(ImageIndex);
+      }
 
-    while(!glfwWindowShouldClose(Context->Window))
-    {
-      VkResult Err = vkAcquireNextImageKHR(Context->Device, Context->Swapchain, UINT64_MAX, Context->Semaphores[FrameIndex], nullptr, &ImageIndex);
+      VkCommandBuffer Commands = Context->RenderBuffers[ImageIndex];
 
-      if(Err != VK_SUCCESS)
+      if(Recorder)
       {
-        std::cout << "\n\n Failed to acquire next image "<< Err << "\n\n";
-        throw std::runtime_error("Failed to acquire next image");
+        // quads are split across the threads, the single full screen quad or virtual texture is one range
+        uint32_t Items = Context->Quads && !Context->Virtual ? Context->Quads->Count() : 1;
+
+        Commands = Recorder->Record(Frames.FrameSlot(), ImageIndex, Items, [&](VkCommandBuffer Cmd, uint32_t First, uint32_t Count)
+        {
+          if(Context->Virtual)
+          {
+            if(Count > 0)
+            {
+              Context->Virtual->Record(Cmd, ImageIndex);
+            }
+          }
+          else if(Context->Quads)
+          {
+            Context->Quads->RecordRange(Cmd, ImageIndex, TextureSet, First, Count);
+          }
+          else if(Count > 0)
+          {
+            RecordFullscreenQuad(Cmd, OurPipe, TextureSet, FrameTexture);
+          }
+        });
       }
 
-      VkPipelineStageFlags WaitStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-      VkSubmitInfo SubmitInf{};
-      SubmitInf.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-      SubmitInf.commandBufferCount = 1;
-      SubmitInf.pCommandBuffers = &Context->RenderBuffers[ImageIndex];
-      SubmitInf.waitSemaphoreCount = 1;
-      SubmitInf.pWaitSemaphores = &Context->Semaphores[FrameIndex]; // Wait for next image to be acquired.
-      SubmitInf.pWaitDstStageMask = &WaitStages;                    // At this stage
+      Frames.EndFrame(Commands, Capture);
+    }
 
-      VkPresentInfoKHR PresentInf{};
-      PresentInf.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-      PresentInf.swapchainCount = 1;
-      PresentInf.pSwapchains = &Context->Swapchain;
-      PresentInf.pImageIndices = &ImageIndex;
+    vkDeviceWaitIdle(Context->Device);
 
-      vkQueueSubmit(Context->GraphicsQueue, 1, &SubmitInf, Context->Fences[FrameIndex]);
+    if(Capture)
+    {
+      Capture->Flush();
+      Capture->PrintStats();
+      delete Capture;
+    }
 
-      vkWaitForFences(Context->Device, 1, &Context->Fences[FrameIndex], VK_TRUE, UINT64_MAX);
-      vkResetFences(Context->Device, 1, &Context->Fences[FrameIndex]);
+    if(Sequence)
+    {
+      Sequence->PrintStats();
+      delete Sequence;
+    }
 
-      vkQueuePresentKHR(Context->GraphicsQueue, &PresentInf);
+    delete Recorder;
+    delete Context->Quads;
+    delete Context->Virtual;
+    delete Context->Post;
 
-      FrameIndex++;
-      FrameIndex = FrameIndex % Context->RenderBuffers.size();
+    Context->Graph->PrintStats();
+    delete Context->Graph;
 
-      glfwPollEvents();
+    if(Residency)
+    {
+      Residency->PrintStats();
+      delete Residency;
+    }
+    Frames.PrintStats();
+    Pacer.PrintStats();
+  // Rendering
 
-      glfwSwapBuffers(Context->Window);
+  Context->Pipelines->Save();
 
-      vkDeviceWaitIdle(Context->Device);
+  if(Context->Profiler)
+  {
+    if(ProfilePath)
+    {
+      std::ofstream ProfileFile(ProfilePath);
+      Context->Profiler->Print(ProfileFile);
     }
-  // Rendering
+    else
+    {
+      Context->Profiler->Print(std::cout);
+    }
+  }
 
   std::cout << "Run Success\n";
   return 0;
@@ -0,0 +1,61 @@
+#version 450
+#pragma shader_stage(compute)
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// Uniforms
+layout(set = 0, binding = 0, rgba8) uniform readonly image2D Source;
+layout(set = 0, binding = 1, rgba8) uniform writeonly image2D Target;
+
+layout(push_constant) uniform MipConstants
+{
+  uint Srgb;   // the views are UNORM, sRGB texels are decoded and encoded here
+} Mip;
+
+vec3 DecodeSrgb(vec3 Color)
+{
+  return mix(Color / 12.92f, pow((Color + 0.055f) / 1.055f, vec3(2.4f)), greaterThan(Color, vec3(0.04045f)));
+}
+
+vec3 EncodeSrgb(vec3 Color)
+{
+  Color = clamp(Color, 0.f, 1.f);
+  return mix(Color * 12.92f, 1.055f * pow(Color, vec3(1.f / 2.4f)) - 0.055f, greaterThan(Color, vec3(0.0031308f)));
+}
+
+vec4 Load(ivec2 Pixel)
+{
+  vec4 Texel = imageLoad(Source, Pixel);
+
+  // averaged in linear light like a blit, gamma encoded values come out too dark
+  if(Mip.Srgb != 0)
+  {
+    Texel.rgb = DecodeSrgb(Texel.rgb);
+  }
+
+  return Texel;
+}
+
+void main()
+{
+  ivec2 Pixel = ivec2(gl_GlobalInvocationID.xy);
+
+  if(any(greaterThanEqual(Pixel, imageSize(Target))))
+  {
+    return;
+  }
+
+  // 2x2 box, an odd edge repeats its last texel
+  ivec2 Last = imageSize(Source) - 1;
+  ivec2 First = min(Pixel * 2, Last);
+  ivec2 Second = min(Pixel * 2 + 1, Last);
+
+  vec4 Color = (Load(First) + Load(ivec2(Second.x, First.y)) + Load(ivec2(First.x, Second.y)) + Load(Second)) * 0.25f;
+
+  if(Mip.Srgb != 0)
+  {
+    Color.rgb = EncodeSrgb(Color.rgb);
+  }
+
+  imageStore(Target, Pixel, Color);
+}
@@ -0,0 +1,96 @@
+#version 450
+#pragma shader_stage(compute)
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// has to match PostProcessor::Flags
+const uint ToneMapBit = 1;
+const uint LutBit = 2;
+const uint EncodeSrgbBit = 4;
+const uint SwapRedBlueBit = 8;
+
+// Uniforms
+layout(set = 0, binding = 0) uniform sampler2D Scene;
+layout(set = 0, binding = 1) uniform sampler3D Lut;
+layout(set = 0, binding = 2, rgba8) uniform writeonly image2D Output;
+
+layout(push_constant) uniform PostConstants
+{
+  float Exposure;
+  float Sharpen;
+  uint Flags;
+} Post;
+
+// Narkowicz's fit of the ACES filmic curve
+vec3 ToneMap(vec3 Color)
+{
+  return clamp((Color * (2.51f * Color + 0.03f)) / (Color * (2.43f * Color + 0.59f) + 0.14f), 0.f, 1.f);
+}
+
+vec3 Grade(vec3 Color)
+{
+  // entry centers, so 0 and 1 land exactly on the first and last entries
+  float Size = float(textureSize(Lut, 0).x);
+  vec3 Coord = (clamp(Color, 0.f, 1.f) * (Size - 1.f) + 0.5f) / Size;
+
+  return textureLod(Lut, Coord, 0.f).rgb;
+}
+
+vec3 EncodeSrgb(vec3 Color)
+{
+  Color = clamp(Color, 0.f, 1.f);
+  return mix(Color * 12.92f, 1.055f * pow(Color, vec3(1.f / 2.4f)) - 0.055f, greaterThan(Color, vec3(0.0031308f)));
+}
+
+void main()
+{
+  ivec2 Pixel = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 Size = imageSize(Output);
+
+  if(any(greaterThanEqual(Pixel, Size)))
+  {
+    return;
+  }
+
+  // linear and unclamped, the scene is half float
+  vec3 Color = texelFetch(Scene, Pixel, 0).rgb;
+
+  if(Post.Sharpen > 0.f)
+  {
+    ivec2 Last = Size - 1;
+    vec3 Left = texelFetch(Scene, clamp(Pixel + ivec2(-1, 0), ivec2(0), Last), 0).rgb;
+    vec3 Right = texelFetch(Scene, clamp(Pixel + ivec2(1, 0), ivec2(0), Last), 0).rgb;
+    vec3 Up = texelFetch(Scene, clamp(Pixel + ivec2(0, -1), ivec2(0), Last), 0).rgb;
+    vec3 Down = texelFetch(Scene, clamp(Pixel + ivec2(0, 1), ivec2(0), Last), 0).rgb;
+
+    // adds back the difference from the blurred neighbourhood
+    Color = max(Color + Post.Sharpen * (4.f * Color - Left - Right - Up - Down), 0.f);
+  }
+
+  Color *= Post.Exposure;
+
+  if((Post.Flags & ToneMapBit) != 0)
+  {
+    Color = ToneMap(Color);
+  }
+
+  if((Post.Flags & LutBit) != 0)
+  {
+    Color = Grade(Color);
+  }
+
+  // the copy moves bytes as they are, so they're written the way the swap format stores them
+  if((Post.Flags & EncodeSrgbBit) != 0)
+  {
+    Color = EncodeSrgb(Color);
+  }
+
+  vec4 Texel = vec4(Color, 1.f);
+
+  if((Post.Flags & SwapRedBlueBit) != 0)
+  {
+    Texel = Texel.bgra;
+  }
+
+  imageStore(Output, Pixel, Texel);
+}
@@ -0,0 +1,22 @@
+#version 450
+#pragma shader_stage(fragment)
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Uniforms
+layout(set = 0, binding=0) uniform sampler2D Textures[];
+
+// Input
+layout(location=0) in vec2 inCoord;
+layout(location=1) flat in uint inTextureIndex;
+layout(location=2) in vec4 inTint;
+
+// Output
+layout(location=0) out vec4 OutColor;
+
+void main()
+{
+  // neighbouring quads in one draw can sample different textures
+  OutColor = texture(Textures[nonuniformEXT(inTextureIndex)], inCoord) * inTint;
+}
+
@@ -0,0 +1,39 @@
+#version 450
+#pragma shader_stage(vertex)
+
+// corners of a unit quad around the origin, picked by the index buffer
+vec2 Corners[] = { {-0.5f, -0.5f}, {0.5f, -0.5f}, {0.5f, 0.5f}, {-0.5f, 0.5f} };
+
+layout(push_constant) uniform ScreenConstants
+{
+  vec2 ScreenSize;
+} Screen;
+
+// Per instance
+layout(location=0) in vec2 inPosition;
+layout(location=1) in vec2 inSize;
+layout(location=2) in vec4 inUVRect;
+layout(location=3) in float inRotation;
+layout(location=4) in uint inTextureIndex;
+layout(location=5) in vec4 inTint;
+
+// Output
+layout(location=0) out vec2 OutCoord;
+layout(location=1) flat out uint OutTextureIndex;
+layout(location=2) out vec4 OutTint;
+
+void main()
+{
+    vec2 Corner = Corners[gl_VertexIndex];
+
+    float s = sin(inRotation);
+    float c = cos(inRotation);
+    vec2 Pixel = inPosition + mat2(c, s, -s, c) * (Corner * inSize);
+
+    gl_Position = vec4(Pixel / Screen.ScreenSize * 2.f - 1.f, 0.f, 1.f);
+
+    OutCoord = mix(inUVRect.xy, inUVRect.zw, Corner + 0.5f);
+    OutTextureIndex = inTextureIndex;
+    OutTint = inTint;
+}
+
@@ -0,0 +1,83 @@
+#version 450
+#pragma shader_stage(fragment)
+
+// Uniforms
+layout(set = 0, binding=0) uniform sampler2D Pool;
+
+// Mirrors VirtualTexture::TableHeader, one entry per virtual tile after it
+layout(std430, set = 0, binding=1) readonly buffer PageTable
+{
+  uvec4 Info;         // width, height, level count, tile count
+  uvec4 Tile;         // tile size, border, pool size in tiles, 0
+  vec4 View;          // visible part of the image, u0 v0 u1 v1
+  uvec4 Levels[16];   // width, height, tiles across, first tile
+  uint Entries[];     // pool x | pool y << 12 | resident level << 24
+} Table;
+
+layout(std430, set = 0, binding=2) writeonly buffer Feedback
+{
+  uint Requested[];
+} Used;
+
+// Input
+layout(location=0) in vec2 inCoord;
+
+// Output
+layout(location=0) out vec4 OutColor;
+
+// Tile of Level under Texel, a position in level 0 texels, and where it falls inside the tile's payload.
+// Level texels are whole blocks of level 0 texels, so this always lands in the ancestor the page table points at.
+uint TileAt(vec2 Texel, uint Level, out vec2 InTile)
+{
+  uvec4 Lvl = Table.Levels[Level];
+  uint Payload = Table.Tile.x - 2 * Table.Tile.y;
+
+  vec2 LevelTexel = clamp(Texel / exp2(float(Level)), vec2(0.f), vec2(Lvl.xy) - 0.001f);
+  uvec2 TileXY = uvec2(LevelTexel) / Payload;
+
+  InTile = LevelTexel - vec2(TileXY * Payload);
+
+  return Lvl.w + TileXY.y * Lvl.z + TileXY.x;
+}
+
+void main()
+{
+  vec2 UV = mix(Table.View.xy, Table.View.zw, inCoord);
+
+  // the level the hardware would pick from a full mip chain, derivatives taken before any fragment leaves
+  vec2 Texel = UV * vec2(Table.Info.xy);
+  vec2 dX = dFdx(Texel);
+  vec2 dY = dFdy(Texel);
+  float Lod = 0.5f * log2(max(dot(dX, dX), dot(dY, dY)));
+
+  if(any(lessThan(UV, vec2(0.f))) || any(greaterThan(UV, vec2(1.f))))
+  {
+    OutColor = vec4(0.f, 0.f, 0.f, 1.f);
+    return;
+  }
+
+  uint Level = uint(clamp(floor(Lod), 0.f, float(Table.Info.z - 1)));
+
+  vec2 InTile;
+  uint Wanted = TileAt(Texel, Level, InTile);
+
+  // a sparse sample is enough to find every visible tile, and keeps the writes down
+  if((uint(gl_FragCoord.x) & 3u) == 0u && (uint(gl_FragCoord.y) & 3u) == 0u)
+  {
+    Used.Requested[Wanted] = 1u;
+  }
+
+  // falls back to the closest resident ancestor until the tile itself streams in
+  uint Entry = Table.Entries[Wanted];
+  uint Resident = Entry >> 24;
+
+  if(Resident != Level)
+  {
+    TileAt(Texel, Resident, InTile);
+  }
+
+  vec2 Slot = vec2(Entry & 0xfffu, (Entry >> 12) & 0xfffu);
+  vec2 PoolTexel = Slot * float(Table.Tile.x) + float(Table.Tile.y) + InTile;
+
+  OutColor = vec4(textureLod(Pool, PoolTexel / float(Table.Tile.x * Table.Tile.z), 0.f).rgb, 1.f);
+}
@@ -0,0 +1,15 @@
+#version 450
+#pragma shader_stage(vertex)
+
+// Output
+layout(location=0) out vec2 OutCoord;
+
+void main()
+{
+    // one triangle covering the screen, the parts outside it are clipped
+    vec2 Corner = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+
+    gl_Position = vec4(Corner * 2.f - 1.f, 0.f, 1.f);
+
+    OutCoord = Corner;
+}